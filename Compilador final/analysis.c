@@ -0,0 +1,1550 @@
+#include "analysis.h"
+#include "y.tab.h"
+#include "symbol_table.h"
+#include "codegen.h"
+
+/*
+ * ANÁLISES SOBRE A AST
+ *
+ * Roda depois do parser e antes do codegen. Coleta as funções do programa
+ * e decide otimizações que dependem do programa inteiro (ex: memoização).
+ */
+FuncInfo *func_list = NULL;
+UnitInfo *unit_list = NULL;
+GlobalInfo *global_list = NULL;
+ASTNode *main_body = NULL;   /* Lista de comandos do programa principal */
+
+FuncInfo* find_func(char *name) {
+    for (FuncInfo *fn = func_list; fn != NULL; fn = fn->next) {
+        if (strcmp(fn->name, name) == 0) return fn;
+    }
+    return NULL;
+}
+
+/*
+ * A lista de parâmetros é montada "ao contrário" pelo parser:
+ * o nó da cabeça guarda o ÚLTIMO parâmetro e 'right' aponta para os anteriores.
+ * Aqui devolvemos os parâmetros na ordem da declaração.
+ */
+int collect_params(ASTNode *list, ASTNode **out, int max) {
+    if (!list) return 0;
+    int n = collect_params(list->right, out, max);
+    if (list->left && n < max) out[n++] = list->left;
+    return n;
+}
+
+/*
+ * Achata uma cadeia de NODE_SEQ na lista de comandos em ordem do fonte.
+ * Devolve a quantidade; o vetor é alocado aqui e liberado por quem chamou.
+ */
+static void flatten_into(ASTNode *node, ASTNode ***out, int *n, int *cap) {
+    if (!node) return;
+    if (node->type == NODE_SEQ) {
+        flatten_into(node->left, out, n, cap);
+        flatten_into(node->right, out, n, cap);
+        return;
+    }
+    if (*n == *cap) {
+        *cap = *cap ? *cap * 2 : 16;
+        *out = (ASTNode**) realloc(*out, *cap * sizeof(ASTNode*));
+    }
+    (*out)[(*n)++] = node;
+}
+
+int flatten_seq(ASTNode *node, ASTNode ***out) {
+    int n = 0, cap = 0;
+    *out = NULL;
+    flatten_into(node, out, &n, &cap);
+    return n;
+}
+
+/* Procura uma declaração local (NODE_DECL) com o nome dado no corpo da função */
+static int declared_in(ASTNode *node, char *name) {
+    if (!node) return 0;
+    if (node->type == NODE_DECL) return strcmp(node->strValue, name) == 0;
+    if (node->type != NODE_SEQ) return 0; /* Declarações só aparecem no início do corpo */
+    return declared_in(node->left, name) || declared_in(node->right, name);
+}
+
+ASTNode* find_param(FuncInfo *fn, char *name) {
+    if (!fn) return NULL;
+    for (int i = 0; i < fn->nparams; i++) {
+        if (strcmp(fn->params[i]->strValue, name) == 0) return fn->params[i];
+    }
+    return NULL;
+}
+
+/* Parâmetro 'int[] v' / 'float[][] m': ponteiro e tamanhos no C gerado */
+int is_array_param(ASTNode *p) {
+    return p && p->type == NODE_VAR && (p->kind == KIND_ARRAY || p->kind == KIND_MATRIX);
+}
+
+/* sum, min, max, argmin, argmax, dot ou count: lê os elementos dos arrays do argumento */
+int is_reduction(ASTNode *node) {
+    static const char *names[] = { "sum", "min", "max", "argmin", "argmax", "dot", "count" };
+    if (!node || node->type != NODE_BUILTIN) return 0;
+    for (int i = 0; i < 7; i++) {
+        if (strcmp(node->strValue, names[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+static const MatrixOp MATRIX_OPS[] = {
+    /* R[n][p] = A[n][m] * B[m][p] */
+    { "matmul", 3, 0, 3, { { { 1, 0 }, { 0, 0 } }, { { 1, 1 }, { 2, 0 } }, { { 2, 1 }, { 0, 1 } } } },
+    /* T[m][n] = A[n][m] transposta */
+    { "transpose", 2, 0, 2, { { { 1, 0 }, { 0, 1 } }, { { 1, 1 }, { 0, 0 } } } },
+    { "fill", 1, 1, 2, { { { 0, 0 }, { -1, 0 } }, { { 0, 1 }, { -1, 0 } } } },
+    /* D[n][m] = S[n][m] */
+    { "copy", 2, 0, 2, { { { 1, 0 }, { 0, 0 } }, { { 1, 1 }, { 0, 1 } } } },
+};
+
+const MatrixOp* find_matrix_op(const char *name) {
+    for (int i = 0; i < (int) (sizeof MATRIX_OPS / sizeof MATRIX_OPS[0]); i++) {
+        if (strcmp(MATRIX_OPS[i].name, name) == 0) return &MATRIX_OPS[i];
+    }
+    return NULL;
+}
+
+static ASTNode* find_decl(ASTNode *node, char *name) {
+    if (!node) return NULL;
+    if (node->type == NODE_DECL) return strcmp(node->strValue, name) == 0 ? node : NULL;
+    if (node->type != NODE_SEQ) return NULL;
+    ASTNode *d = find_decl(node->left, name);
+    return d ? d : find_decl(node->right, name);
+}
+
+/*
+ * Resolve um nome no contexto de 'fn' (NULL = main), com as mesmas regras de
+ * sombreamento do parser: parâmetro, depois local, depois global.
+ * Devolve o nó do parâmetro ou o NODE_DECL da variável.
+ */
+ASTNode* resolve_var(FuncInfo *fn, char *name) {
+    if (fn) {
+        ASTNode *p = find_param(fn, name);
+        if (p) return p;
+        ASTNode *d = find_decl(fn->def->right, name);
+        if (d) return d;
+    }
+    for (GlobalInfo *g = global_list; g != NULL; g = g->next) {
+        if (strcmp(g->decl->strValue, name) == 0) return g->decl;
+    }
+    /* Arrays de tamanho calculado declarados entre os comandos do main */
+    if (fn || !main_body) return NULL;
+    return find_decl(main_body->type == NODE_BLOCK ? main_body->left : main_body, name);
+}
+
+/* Nome da unit de uma variável (NULL se não for unit) */
+char* unit_of(FuncInfo *fn, char *name) {
+    ASTNode *d = resolve_var(fn, name);
+    return (d && d->dataType == 1000) ? d->unitName : NULL;
+}
+
+UnitInfo* find_unit(char *name) {
+    for (UnitInfo *u = unit_list; u != NULL; u = u->next) {
+        if (strcmp(u->name, name) == 0) return u;
+    }
+    return NULL;
+}
+
+/* p.campo := v (o valor de 'x := p.campo' também é um NODE_ACCESS em left) */
+int is_field_assign(ASTNode *node) {
+    return node->type == NODE_ASSIGN && node->strValue && strcmp(node->strValue, "ASSIGN_ACCESS") == 0;
+}
+
+int contains_call(ASTNode *node) {
+    if (!node) return 0;
+    if (node->type == NODE_FUNC_CALL || node->type == NODE_PROC_CALL) return 1;
+    if (node->type == NODE_ACCESS) return 0;
+    return contains_call(node->left) || contains_call(node->right) || contains_call(node->extra);
+}
+
+/* Parâmetros e variáveis locais sombreiam as globais de mesmo nome */
+int is_local_name(FuncInfo *fn, char *name) {
+    if (!fn) return 0;
+    if (find_param(fn, name)) return 1;
+    return declared_in(fn->def->right, name);
+}
+
+/* --- MEMOIZAÇÃO --- */
+
+/*
+ * Assinatura aceita para 'memo': retorno escalar (int, float, char) e
+ * parâmetros escalares (int, float, char). Arrays, strings e units não
+ * servem de chave da cache.
+ */
+int memo_signature_ok(ASTNode *def) {
+    if (def->dataType != TYPE_INT && def->dataType != TYPE_FLOAT && def->dataType != TYPE_CHAR) return 0;
+
+    ASTNode *params[MAX_PARAMS];
+    int n = collect_params(def->left, params, MAX_PARAMS);
+    if (n == 0) return 0;
+    for (int i = 0; i < n; i++) {
+        int t = params[i]->dataType;
+        if (params[i]->passMode == PASS_REF || params[i]->kind != KIND_SCALAR) return 0;
+        if (t != TYPE_INT && t != TYPE_FLOAT && t != TYPE_CHAR) return 0;
+    }
+    return 1;
+}
+
+/* Conta as chamadas da função a ela mesma (recursão em árvore = 2 ou mais) */
+int count_self_calls(ASTNode *node, char *name) {
+    if (!node) return 0;
+    int n = 0;
+    if ((node->type == NODE_FUNC_CALL || node->type == NODE_PROC_CALL) && strcmp(node->strValue, name) == 0) n = 1;
+    if (node->type == NODE_ACCESS) return n; /* 'extra' guarda o nome do campo, não uma variável */
+    return n + count_self_calls(node->left, name) + count_self_calls(node->right, name) + count_self_calls(node->extra, name);
+}
+
+/*
+ * Memoização automática (--memo-auto):
+ * funções com parâmetros inteiros pequenos, que só dependem dos argumentos
+ * (classe const) e fazem recursão em árvore (ex: Fibonacci) ganham a cache
+ * sem anotação.
+ */
+static void detect_memo(FuncInfo *fn) {
+    if (fn->def->memo) {
+        if (fn->effect != EFFECT_CONST) {
+            printf("[AVISO] Funcao memo '%s' e %s: a cache pode mudar o comportamento do programa.\n",
+                   fn->name, effect_name(fn->effect));
+        }
+        return;
+    }
+    if (!memo_signature_ok(fn->def)) return;
+
+    for (int i = 0; i < fn->nparams; i++) {
+        if (fn->params[i]->dataType == TYPE_FLOAT) return;
+    }
+    if (count_self_calls(fn->def->right, fn->name) < 2) return;
+    if (fn->effect != EFFECT_CONST) return;
+
+    fn->def->memo = 2;
+    printf("[OTIM] Funcao '%s' memoizada automaticamente (recursao pura).\n", fn->name);
+}
+
+/* --- ANÁLISE DE EFEITOS (INTERPROCEDURAL) --- */
+
+const char* effect_name(int effect) {
+    switch (effect) {
+        case EFFECT_CONST: return "const";
+        case EFFECT_PURE:  return "pure";
+        default:           return "com efeitos";
+    }
+}
+
+static int max_effect(int a, int b) { return a > b ? a : b; }
+
+/* Array ou 'ref' recebido por parâmetro é um ponteiro para a memória do chamador */
+static int is_pointer_param(FuncInfo *fn, char *name) {
+    ASTNode *p = find_param(fn, name);
+    return p && (p->dataType == TYPE_ARRAY || p->dataType == TYPE_STRING || p->passMode == PASS_REF || is_array_param(p));
+}
+
+/* Efeito de ESCREVER na variável 'name' dentro de 'fn' */
+static int write_effect(FuncInfo *fn, char *name) {
+    if (!is_local_name(fn, name) || is_pointer_param(fn, name)) return EFFECT_WRITES;
+    return EFFECT_CONST;
+}
+
+/* Efeito de LER a variável 'name' dentro de 'fn' */
+static int read_effect(FuncInfo *fn, char *name) {
+    if (!is_local_name(fn, name) || is_pointer_param(fn, name)) return EFFECT_PURE;
+    return EFFECT_CONST;
+}
+
+static int node_effect(FuncInfo *fn, ASTNode *node);
+
+/* Arrays e vistas lidos elemento a elemento por uma redução */
+static int reduction_effect(FuncInfo *fn, ASTNode *node) {
+    if (!node) return EFFECT_CONST;
+    if ((node->type == NODE_VAR || node->type == NODE_SLICE) && node->kind != KIND_SCALAR) return read_effect(fn, node->strValue);
+    if (node->type == NODE_ARG_LIST || node->type == NODE_BIN_OP) {
+        return max_effect(reduction_effect(fn, node->left), reduction_effect(fn, node->right));
+    }
+    return EFFECT_CONST;
+}
+
+/* Lado direito de 'v := expr' com v array: os arrays inteiros são leituras */
+static int elementwise_effect(FuncInfo *fn, ASTNode *e) {
+    if (e->type == NODE_VAR && e->kind != KIND_SCALAR) return read_effect(fn, e->strValue);
+    if ((e->type == NODE_BIN_OP || e->type == NODE_CAST) && e->kind != KIND_SCALAR) {
+        return max_effect(elementwise_effect(fn, e->left), e->right ? elementwise_effect(fn, e->right) : EFFECT_CONST);
+    }
+    return node_effect(fn, e);
+}
+
+/*
+ * Efeito de um trecho da AST, considerando o efeito JÁ CONHECIDO das funções
+ * chamadas (a iteração em compute_effects leva isso ao ponto fixo).
+ */
+static int node_effect(FuncInfo *fn, ASTNode *node) {
+    if (!node) return EFFECT_CONST;
+    int e = EFFECT_CONST;
+
+    switch (node->type) {
+        case NODE_PRINT:
+        case NODE_READ:
+        case NODE_PRINT_ALL:
+        case NODE_READ_ALL:
+        case NODE_MAP_OPEN:
+        case NODE_MAP_CLOSE:
+        case NODE_LOAD:
+        case NODE_STORE:
+            return EFFECT_WRITES;
+        case NODE_FUNC_CALL:
+        case NODE_PROC_CALL: {
+            FuncInfo *callee = find_func(node->strValue);
+            e = callee ? callee->effect : EFFECT_WRITES;
+            break;
+        }
+        case NODE_VAR:
+            /* Passar um array adiante é passar o ponteiro: o efeito fica com o chamado */
+            if (!(node->kind == KIND_ARRAY || node->kind == KIND_MATRIX || node->dataType == TYPE_ARRAY)) e = read_effect(fn, node->strValue);
+            break;
+        case NODE_ARRAY_ACCESS:
+            e = read_effect(fn, node->strValue);
+            break;
+        case NODE_ACCESS:
+            return read_effect(fn, node->strValue); /* 'extra' é o nome do campo */
+        case NODE_ASSIGN:
+            if (is_field_assign(node)) {
+                e = write_effect(fn, node->left->strValue);
+                return max_effect(e, node_effect(fn, node->right));
+            }
+            if (node->kind != KIND_SCALAR) {
+                /* Array inteiro: os arrays do lado direito são lidos */
+                e = write_effect(fn, node->strValue);
+                return max_effect(e, elementwise_effect(fn, node->left));
+            }
+            e = write_effect(fn, node->strValue);
+            break;
+        case NODE_ASSIGN_IDX:
+        case NODE_FOR:
+            e = write_effect(fn, node->strValue);
+            break;
+        case NODE_BUILTIN:
+            if (is_reduction(node)) e = reduction_effect(fn, node->left);
+            break;
+        case NODE_MATRIX_OP: {
+            /* Escreve a primeira matriz e lê as outras */
+            ASTNode *args[MAX_MATRIX_DIMS];
+            int n = collect_params(node->left, args, find_matrix_op(node->strValue)->nmats);
+            e = write_effect(fn, args[0]->strValue);
+            for (int i = 1; i < n; i++) e = max_effect(e, read_effect(fn, args[i]->strValue));
+            break;
+        }
+        default:
+            break;
+    }
+    e = max_effect(e, node_effect(fn, node->left));
+    e = max_effect(e, node_effect(fn, node->right));
+    return max_effect(e, node_effect(fn, node->extra));
+}
+
+/*
+ * Ponto fixo sobre o grafo de chamadas: todas as funções começam como const
+ * e só sobem de classe, então a iteração termina (no máximo 2 subidas por função).
+ */
+static void compute_effects(void) {
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (FuncInfo *fn = func_list; fn != NULL; fn = fn->next) {
+            int e = node_effect(fn, fn->def->right);
+            if (e > fn->effect) {
+                fn->effect = e;
+                changed = 1;
+            }
+        }
+    }
+    for (FuncInfo *fn = func_list; fn != NULL; fn = fn->next) {
+        printf("[OTIM] Funcao '%s': %s.\n", fn->name, effect_name(fn->effect));
+    }
+}
+
+/* --- ESCAPE DE GLOBAIS (PROMOÇÃO PARA LOCAIS) --- */
+
+GlobalInfo* find_global(ASTNode *decl) {
+    for (GlobalInfo *g = global_list; g != NULL; g = g->next) {
+        if (g->decl == decl) return g;
+    }
+    return NULL;
+}
+
+/* Verifica se o trecho menciona a global 'name' (fn = NULL no main, onde nada a sombreia) */
+static int refs_global(FuncInfo *fn, ASTNode *node, char *name) {
+    if (!node) return 0;
+    if (fn && is_local_name(fn, name)) return 0;
+
+    switch (node->type) {
+        case NODE_VAR:
+        case NODE_ARRAY_ACCESS:
+        case NODE_SLICE:
+        case NODE_ASSIGN_IDX:
+        case NODE_READ:
+        case NODE_READ_ALL:
+        case NODE_PRINT_ALL:
+        case NODE_LOAD:
+        case NODE_STORE:
+        case NODE_FOR:
+            if (strcmp(node->strValue, name) == 0) return 1;
+            break;
+        case NODE_ASSIGN:
+            if (!is_field_assign(node) && strcmp(node->strValue, name) == 0) return 1;
+            break;
+        case NODE_ACCESS:
+            return strcmp(node->strValue, name) == 0; /* 'extra' é o nome do campo */
+        default:
+            break;
+    }
+    return refs_global(fn, node->left, name) ||
+           refs_global(fn, node->right, name) ||
+           refs_global(fn, node->extra, name);
+}
+
+static int contains_goto(ASTNode *node) {
+    if (!node) return 0;
+    if (node->type == NODE_GOTO) return 1;
+    return contains_goto(node->left) || contains_goto(node->right) || contains_goto(node->extra);
+}
+
+/*
+ * A variável está "morta na entrada" da função se o primeiro comando que a
+ * menciona é uma atribuição incondicional (x := expr sem x, ou for x := ...)
+ * e nenhum comando anterior tem goto (que poderia pular a atribuição).
+ * Nesse caso o valor deixado pela chamada anterior nunca é lido.
+ */
+static int dead_on_entry(FuncInfo *fn, char *name) {
+    ASTNode **stmts;
+    int n = flatten_seq(fn->def->right, &stmts);
+    int result = 0;
+
+    for (int i = 0; i < n; i++) {
+        ASTNode *st = stmts[i];
+        if (st->type == NODE_DECL) continue;
+        if (refs_global(fn, st, name)) {
+            if (st->type == NODE_ASSIGN && !is_field_assign(st)) {
+                result = strcmp(st->strValue, name) == 0 && !refs_global(fn, st->left, name);
+            } else if (st->type == NODE_FOR) {
+                result = strcmp(st->strValue, name) == 0 && !refs_global(fn, st->left, name);
+            }
+            break;
+        }
+        if (contains_goto(st)) break;
+    }
+    free(stmts);
+    return result;
+}
+
+/* O trecho chama 'target', direta ou indiretamente? ('visited' evita ciclos) */
+static int calls_func(ASTNode *node, FuncInfo *target, int *visited);
+
+static int reaches(FuncInfo *from, FuncInfo *target, int *visited) {
+    int idx = 0;
+    for (FuncInfo *fn = func_list; fn != from; fn = fn->next) idx++;
+    if (visited[idx]) return 0;
+    visited[idx] = 1;
+    return calls_func(from->def->right, target, visited);
+}
+
+static int calls_func(ASTNode *node, FuncInfo *target, int *visited) {
+    if (!node) return 0;
+    if (node->type == NODE_FUNC_CALL || node->type == NODE_PROC_CALL) {
+        FuncInfo *callee = find_func(node->strValue);
+        if (callee == target) return 1;
+        if (callee && reaches(callee, target, visited)) return 1;
+    }
+    if (node->type == NODE_ACCESS) return 0;
+    return calls_func(node->left, target, visited) ||
+           calls_func(node->right, target, visited) ||
+           calls_func(node->extra, target, visited);
+}
+
+/* A função pode estar ativa duas vezes ao mesmo tempo (recursão direta ou indireta)? */
+static int is_recursive(FuncInfo *fn) {
+    int count = 0;
+    for (FuncInfo *g = func_list; g != NULL; g = g->next) count++;
+    int *visited = (int*) calloc(count + 1, sizeof(int));
+    int r = calls_func(fn->def->right, fn, visited);
+    free(visited);
+    return r;
+}
+
+/*
+ * Globais escalares (e units) viram locais quando só uma função as usa:
+ * - usadas só no main: local do main, inicializada com zero (como a global era);
+ * - usadas só em uma função não recursiva e mortas na entrada: local da função.
+ * Locais podem ficar em registrador; globais precisam ir para a memória a cada
+ * escrita e a cada chamada de função.
+ */
+static void promote_globals(void) {
+    for (GlobalInfo *g = global_list; g != NULL; g = g->next) {
+        ASTNode *d = g->decl;
+        char *name = d->strValue;
+        int promotable = (d->kind == KIND_SCALAR && d->dataType != TYPE_STRING) || d->kind == KIND_UNIT;
+        if (!promotable) continue;
+
+        int in_main = refs_global(NULL, main_body, name);
+        FuncInfo *user = NULL;
+        int users = 0;
+        for (FuncInfo *fn = func_list; fn != NULL; fn = fn->next) {
+            if (refs_global(fn, fn->def->right, name)) {
+                user = fn;
+                users++;
+            }
+        }
+
+        if (in_main && users == 0) {
+            g->home_main = 1;
+            printf("[OTIM] Global '%s' promovida a local do main.\n", name);
+        } else if (!in_main && users == 1 && !is_recursive(user) && dead_on_entry(user, name)) {
+            g->home = user;
+            printf("[OTIM] Global '%s' promovida a local de '%s'.\n", name, user->name);
+        }
+    }
+}
+
+/* --- SUBSTITUIÇÃO ESCALAR DE UNITS --- */
+
+/*
+ * Uma unit local (ou global promovida) cujo endereço nunca é tomado pode ter
+ * cada campo como uma variável escalar independente: r.num vira r__num.
+ * Onde a unit é usada inteira (return r, f(r)), o codegen remonta um valor
+ * struct com um literal composto.
+ */
+static void mark_scalarizable(ASTNode *decl, ASTNode *scope, char *where) {
+    UnitInfo *u = find_unit(decl->unitName);
+    if (!u || !u->scalar_only) return;
+    if (passed_by_ref(scope, decl->strValue)) return; /* O chamado precisa do endereço da struct */
+    decl->scalarized = 1;
+    printf("[OTIM] Unit '%s' (%s) substituida por escalares em %s.\n", decl->strValue, u->name, where);
+}
+
+static int refs_only_params(FuncInfo *fn, ASTNode *node) {
+    if (!node) return 1;
+    switch (node->type) {
+        case NODE_FUNC_CALL:
+        case NODE_PROC_CALL:
+        case NODE_ARRAY_ACCESS:
+        case NODE_SLICE:
+            return 0;
+        case NODE_VAR: {
+            ASTNode *p = find_param(fn, node->strValue);
+            return p && p->dataType != 1000 && p->dataType != TYPE_ARRAY && p->dataType != TYPE_STRING && p->passMode != PASS_REF && !is_array_param(p);
+        }
+        case NODE_ACCESS: {
+            ASTNode *p = find_param(fn, node->strValue);
+            return p && p->dataType == 1000 && p->passMode != PASS_REF;
+        }
+        default:
+            return refs_only_params(fn, node->left) &&
+                   refs_only_params(fn, node->right) &&
+                   refs_only_params(fn, node->extra);
+    }
+}
+
+/*
+ * Construtor: função que devolve unit e cujo corpo é só
+ *     unit U res;  res.campo := expr(parametros); ...  return res;
+ * com cada campo atribuído uma vez. Chamadas a ela que são consumidas na hora
+ * (x := f(a, b)) viram atribuições campo a campo, sem struct intermediária.
+ */
+static void detect_builder(FuncInfo *fn) {
+    ASTNode *def = fn->def;
+    if (def->dataType != 1000 || !def->unitName) return;
+    UnitInfo *u = find_unit(def->unitName);
+    if (!u || !u->scalar_only) return;
+
+    ASTNode **stmts;
+    int n = flatten_seq(def->right, &stmts);
+    ASTNode **exprs = (ASTNode**) calloc(u->nfields, sizeof(ASTNode*));
+    char *res = NULL;
+    int ok = 1, assigned = 0, returned = 0;
+
+    for (int i = 0; i < n && ok; i++) {
+        ASTNode *st = stmts[i];
+        if (returned) {
+            ok = 0;
+        } else if (st->type == NODE_DECL) {
+            if (res || st->kind != KIND_UNIT || strcmp(st->unitName, u->name) != 0) ok = 0;
+            else res = st->strValue;
+        } else if (is_field_assign(st)) {
+            if (!res || strcmp(st->left->strValue, res) != 0 || !refs_only_params(fn, st->right)) {
+                ok = 0;
+                break;
+            }
+            int k;
+            for (k = 0; k < u->nfields; k++) {
+                if (strcmp(u->fields[k]->strValue, st->left->extra->strValue) == 0) break;
+            }
+            if (k == u->nfields || exprs[k]) ok = 0;
+            else { exprs[k] = st->right; assigned++; }
+        } else if (st->type == NODE_RETURN && st->left && st->left->type == NODE_VAR) {
+            if (!res || strcmp(st->left->strValue, res) != 0) ok = 0;
+            returned = 1;
+        } else {
+            ok = 0;
+        }
+    }
+    free(stmts);
+
+    if (ok && returned && assigned == u->nfields) {
+        fn->build_exprs = exprs;
+        printf("[OTIM] Funcao '%s' e construtora de '%s': chamadas viram atribuicoes campo a campo.\n", fn->name, u->name);
+    } else {
+        free(exprs);
+    }
+}
+
+static void scalarize_units(void) {
+    for (FuncInfo *fn = func_list; fn != NULL; fn = fn->next) {
+        ASTNode **stmts;
+        int n = flatten_seq(fn->def->right, &stmts);
+        for (int i = 0; i < n; i++) {
+            if (stmts[i]->type == NODE_DECL && stmts[i]->kind == KIND_UNIT) mark_scalarizable(stmts[i], fn->def->right, fn->name);
+        }
+        free(stmts);
+        detect_builder(fn);
+    }
+    for (GlobalInfo *g = global_list; g != NULL; g = g->next) {
+        if (g->decl->kind != KIND_UNIT) continue;
+        if (g->home_main) mark_scalarizable(g->decl, main_body, "main");
+        else if (g->home) mark_scalarizable(g->decl, g->home->def->right, g->home->name);
+    }
+}
+
+/* --- PASSAGEM DE UNITS POR REFERÊNCIA --- */
+
+static int unit_param_modified(ASTNode *node, char *name) {
+    if (!node) return 0;
+    if (node->type == NODE_ASSIGN) {
+        if (is_field_assign(node)) {
+            if (strcmp(node->left->strValue, name) == 0) return 1;
+        } else if (strcmp(node->strValue, name) == 0) {
+            return 1;
+        }
+    }
+    if ((node->type == NODE_FUNC_CALL || node->type == NODE_PROC_CALL) && ref_arg_of(node, name)) return 1;
+    if (node->type == NODE_ACCESS) return 0;
+    return unit_param_modified(node->left, name) ||
+           unit_param_modified(node->right, name) ||
+           unit_param_modified(node->extra, name);
+}
+
+/* O nome é uma unit fora do quadro da função (global)? */
+static int outer_unit(FuncInfo *fn, char *name) {
+    if (is_local_name(fn, name)) return 0;
+    ASTNode *d = resolve_var(fn, name);
+    return d && d->dataType == 1000;
+}
+
+/*
+ * A função (ou algo que ela chama) escreve em alguma unit global? Um
+ * parâmetro 'const struct X *' que aponte para essa global veria a escrita,
+ * que na cópia da passagem por valor não aparece.
+ */
+static int writes_outer_units(FuncInfo *fn, ASTNode *node, int *visited) {
+    if (!node) return 0;
+    switch (node->type) {
+        case NODE_ASSIGN: {
+            int field = node->left && node->left->type == NODE_ACCESS;
+            if (outer_unit(fn, field ? node->left->strValue : node->strValue)) return 1;
+            break;
+        }
+        case NODE_FUNC_CALL:
+        case NODE_PROC_CALL: {
+            FuncInfo *callee = find_func(node->strValue);
+            if (!callee) break;
+            ASTNode *args[MAX_PARAMS];
+            int n = collect_params(node->left, args, MAX_PARAMS);
+            for (int i = 0; i < n && i < callee->nparams; i++) {
+                if (callee->params[i]->passMode != PASS_REF) continue;
+                if ((args[i]->type == NODE_VAR || args[i]->type == NODE_ACCESS) && outer_unit(fn, args[i]->strValue)) return 1;
+            }
+            int idx = 0;
+            for (FuncInfo *g = func_list; g != callee; g = g->next) idx++;
+            if (!visited[idx]) {
+                visited[idx] = 1;
+                if (writes_outer_units(callee, callee->def->right, visited)) return 1;
+            }
+            break;
+        }
+        case NODE_ACCESS:
+            return 0;
+        default:
+            break;
+    }
+    return writes_outer_units(fn, node->left, visited) ||
+           writes_outer_units(fn, node->right, visited) ||
+           writes_outer_units(fn, node->extra, visited);
+}
+
+/* Unit com campos string (cada variável é dona do texto deles) */
+static int unit_has_strings(char *unitName) {
+    UnitInfo *u = unitName ? find_unit(unitName) : NULL;
+    for (int i = 0; u && i < u->nfields; i++) {
+        if (u->fields[i]->dataType == TYPE_STRING) return 1;
+    }
+    return 0;
+}
+
+/*
+ * Parâmetro ref string ou unit: pode alcançar o texto de uma unit passada na
+ * mesma chamada, e alterar o texto o libera ou realoca.
+ */
+static int has_text_refs(FuncInfo *fn) {
+    for (int i = 0; i < fn->nparams; i++) {
+        ASTNode *p = fn->params[i];
+        if (p->passMode == PASS_REF && (p->dataType == TYPE_STRING || p->dataType == 1000)) return 1;
+    }
+    return 0;
+}
+
+/*
+ * Units passadas e devolvidas por valor custam duas cópias da struct por chamada.
+ * - Parâmetro unit que a função nunca modifica vira 'const struct X *'
+ *   (a semântica de cópia é preservada: ninguém escreve no original).
+ *   Não vale se a função escreve em units globais (o argumento pode ser uma
+ *   delas); um ref da mesma chamada que alcance o argumento é tratado no
+ *   chamador, que passa uma cópia (ver gen_call). Unit com campos string e
+ *   função com ref string ou unit: a cópia rasa do chamador não protegeria
+ *   o texto, então fica a passagem por valor (a função copia o texto na entrada).
+ * - Função que devolve unit recebe o destino do chamador (ret__) e escreve
+ *   o resultado no lugar. Só o 'return' escreve em ret__, depois de todas as
+ *   leituras dos parâmetros, então o destino pode ser um dos argumentos.
+ */
+static void lower_unit_passing(void) {
+    int count = 0;
+    for (FuncInfo *fn = func_list; fn != NULL; fn = fn->next) count++;
+
+    for (FuncInfo *fn = func_list; fn != NULL; fn = fn->next) {
+        int *visited = (int*) calloc(count + 1, sizeof(int));
+        int outer = writes_outer_units(fn, fn->def->right, visited);
+        free(visited);
+        for (int i = 0; i < fn->nparams; i++) {
+            ASTNode *p = fn->params[i];
+            if (p->dataType != 1000 || !p->unitName || p->passMode == PASS_REF) continue;
+            if (outer || unit_param_modified(fn->def->right, p->strValue)) continue;
+            if (unit_has_strings(p->unitName) && has_text_refs(fn)) continue;
+            p->passMode = PASS_CONST_PTR;
+            printf("[OTIM] Parametro unit '%s' de '%s' passado por referencia constante.\n", p->strValue, fn->name);
+        }
+        if (fn->def->dataType == 1000 && fn->def->unitName) {
+            fn->ret_slot = 1;
+            printf("[OTIM] Funcao '%s' devolve '%s' no espaco do chamador.\n", fn->name, fn->def->unitName);
+        }
+    }
+}
+
+/* --- PARÂMETROS REF --- */
+
+/*
+ * Argumento 'name' (variável inteira ou campo dela) passado a um parâmetro ref
+ * nesta chamada? Nesse caso o chamado recebe o endereço e pode escrever nele.
+ */
+int ref_arg_of(ASTNode *call, char *name) {
+    FuncInfo *callee = find_func(call->strValue);
+    if (!callee) return 0;
+    ASTNode *args[MAX_PARAMS];
+    int n = collect_params(call->left, args, MAX_PARAMS);
+    for (int i = 0; i < n && i < callee->nparams; i++) {
+        if (callee->params[i]->passMode != PASS_REF) continue;
+        if ((args[i]->type == NODE_VAR || args[i]->type == NODE_ACCESS) && strcmp(args[i]->strValue, name) == 0) return 1;
+    }
+    return 0;
+}
+
+/* Alguma chamada no trecho recebe 'name' inteira por ref? */
+int passed_by_ref(ASTNode *node, char *name) {
+    if (!node) return 0;
+    if (node->type == NODE_FUNC_CALL || node->type == NODE_PROC_CALL) {
+        FuncInfo *callee = find_func(node->strValue);
+        ASTNode *args[MAX_PARAMS];
+        int n = collect_params(node->left, args, MAX_PARAMS);
+        for (int i = 0; callee && i < n && i < callee->nparams; i++) {
+            if (callee->params[i]->passMode == PASS_REF && args[i]->type == NODE_VAR &&
+                strcmp(args[i]->strValue, name) == 0) return 1;
+        }
+    }
+    if (node->type == NODE_ACCESS) return 0;
+    return passed_by_ref(node->left, name) || passed_by_ref(node->right, name) || passed_by_ref(node->extra, name);
+}
+
+/*
+ * Tipo de um argumento que precisa de endereço (variável escalar ou unit,
+ * elemento de array/matriz ou campo de unit). Devolve -1 se não for lvalue.
+ */
+static int lvalue_type(FuncInfo *fn, ASTNode *arg, char **unitName) {
+    ASTNode *d;
+    *unitName = NULL;
+    switch (arg->type) {
+        case NODE_VAR:
+            d = resolve_var(fn, arg->strValue);
+            if (!d || d->kind == KIND_ARRAY || d->kind == KIND_MATRIX || d->dataType == TYPE_ARRAY) return -1;
+            *unitName = d->unitName;
+            return d->dataType;
+        case NODE_ARRAY_ACCESS:
+            d = resolve_var(fn, arg->strValue);
+            if (!d) return -1;
+            return d->dataType == TYPE_ARRAY ? TYPE_INT : d->dataType;
+        case NODE_ACCESS: {
+            char *un = unit_of(fn, arg->strValue);
+            UnitInfo *u = un ? find_unit(un) : NULL;
+            for (int k = 0; u && k < u->nfields; k++) {
+                if (strcmp(u->fields[k]->strValue, arg->extra->strValue) == 0) return u->fields[k]->dataType;
+            }
+            return -1;
+        }
+        default:
+            return -1;
+    }
+}
+
+/* Valida os argumentos passados a parâmetros ref (precisam ser variáveis do mesmo tipo) */
+static void check_ref_args(FuncInfo *fn, ASTNode *node) {
+    if (!node) return;
+    if (node->type == NODE_FUNC_CALL || node->type == NODE_PROC_CALL) {
+        FuncInfo *callee = find_func(node->strValue);
+        ASTNode *args[MAX_PARAMS];
+        int n = collect_params(node->left, args, MAX_PARAMS);
+        for (int i = 0; callee && i < n && i < callee->nparams; i++) {
+            ASTNode *p = callee->params[i];
+            if (p->passMode != PASS_REF) continue;
+            char *un;
+            int t = lvalue_type(fn, args[i], &un);
+            if (t < 0) {
+                printf("ERRO (Linha %d): Argumento '%s' de '%s' e ref e precisa ser uma variavel.\n", node->line, p->strValue, callee->name);
+                exit(1);
+            }
+            if (t != p->dataType || (t == 1000 && (!un || strcmp(un, p->unitName) != 0))) {
+                printf("ERRO (Linha %d): Argumento '%s' de '%s' e ref e precisa ter o mesmo tipo do parametro.\n", node->line, p->strValue, callee->name);
+                exit(1);
+            }
+        }
+    }
+    if (node->type == NODE_ACCESS) return;
+    check_ref_args(fn, node->left);
+    check_ref_args(fn, node->right);
+    check_ref_args(fn, node->extra);
+}
+
+/* A função (ou algo que ela chama) lê/escreve alguma global? */
+static int touches_globals(FuncInfo *fn, ASTNode *node, int *visited);
+
+static int func_touches_globals(FuncInfo *fn, int *visited) {
+    int idx = 0;
+    for (FuncInfo *g = func_list; g != fn; g = g->next) idx++;
+    if (visited[idx]) return 0;
+    visited[idx] = 1;
+    for (int i = 0; i < fn->nparams; i++) {
+        /* Arrays recebidos podem ser a própria memória apontada por um ref */
+        if (fn->params[i]->dataType == TYPE_ARRAY || fn->params[i]->dataType == TYPE_STRING || is_array_param(fn->params[i])) return 1;
+    }
+    return touches_globals(fn, fn->def->right, visited);
+}
+
+static int touches_globals(FuncInfo *fn, ASTNode *node, int *visited) {
+    if (!node) return 0;
+    switch (node->type) {
+        case NODE_VAR:
+        case NODE_ARRAY_ACCESS:
+        case NODE_SLICE:
+        case NODE_ASSIGN_IDX:
+        case NODE_READ:
+        case NODE_READ_ALL:
+        case NODE_PRINT_ALL:
+        case NODE_LOAD:
+        case NODE_STORE:
+        case NODE_FOR:
+            if (!is_local_name(fn, node->strValue)) return 1;
+            break;
+        case NODE_ASSIGN:
+            if (!is_field_assign(node) && !is_local_name(fn, node->strValue)) return 1;
+            break;
+        case NODE_ACCESS:
+            return !is_local_name(fn, node->strValue);
+        case NODE_FUNC_CALL:
+        case NODE_PROC_CALL: {
+            FuncInfo *callee = find_func(node->strValue);
+            if (!callee || func_touches_globals(callee, visited)) return 1;
+            break;
+        }
+        default:
+            break;
+    }
+    return touches_globals(fn, node->left, visited) ||
+           touches_globals(fn, node->right, visited) ||
+           touches_globals(fn, node->extra, visited);
+}
+
+/*
+ * Um ref escalar só pode ser apelidado por globais, arrays recebidos ou
+ * outro ref. Se a função tem um único ref e nada que ela executa toca
+ * globais ou arrays recebidos, ninguém mais observa *r durante a chamada:
+ * o valor fica numa local (em registrador) e é escrito de volta ao retornar.
+ * Chamadas que recebem r passam o endereço da local, que é a cópia atual.
+ */
+static void plan_ref_params(void) {
+    int count = 0;
+    for (FuncInfo *fn = func_list; fn != NULL; fn = fn->next) count++;
+
+    for (FuncInfo *fn = func_list; fn != NULL; fn = fn->next) {
+        check_ref_args(fn, fn->def->right);
+
+        ASTNode *ref = NULL;
+        int nrefs = 0;
+        for (int i = 0; i < fn->nparams; i++) {
+            if (fn->params[i]->passMode == PASS_REF) {
+                ref = fn->params[i];
+                nrefs++;
+            }
+        }
+        if (nrefs != 1 || ref->dataType == 1000) continue;
+
+        int *visited = (int*) calloc(count + 1, sizeof(int));
+        int unsafe = func_touches_globals(fn, visited);
+        free(visited);
+        if (unsafe) continue;
+
+        fn->ref_cache = ref;
+        printf("[OTIM] Parametro ref '%s' de '%s' mantido em local durante a chamada.\n", ref->strValue, fn->name);
+    }
+    check_ref_args(NULL, main_body);
+}
+
+/* --- ARRAYS RECEBIDOS --- */
+
+/* Valida os argumentos de parâmetros 'T[]' / 'T[][]': array do mesmo formato e tipo de elemento */
+static void check_array_args(FuncInfo *fn, ASTNode *node) {
+    if (!node) return;
+    if (node->type == NODE_FUNC_CALL || node->type == NODE_PROC_CALL) {
+        FuncInfo *callee = find_func(node->strValue);
+        ASTNode *args[MAX_PARAMS];
+        int n = collect_params(node->left, args, MAX_PARAMS);
+        for (int i = 0; callee && i < n && i < callee->nparams; i++) {
+            ASTNode *p = callee->params[i];
+            if (!is_array_param(p)) continue;
+            ASTNode *a = args[i];
+            ASTNode *d = (a->type == NODE_VAR || a->type == NODE_SLICE) ? resolve_var(fn, a->strValue) : NULL;
+            int kind = (a->type == NODE_SLICE) ? KIND_ARRAY : (d ? d->kind : KIND_SCALAR);
+            if (!d || kind != p->kind || d->dataType != p->dataType) {
+                printf("ERRO (Linha %d): Argumento '%s' de '%s' precisa ser %s com o mesmo tipo de elemento.\n",
+                       node->line, p->strValue, callee->name, p->kind == KIND_MATRIX ? "uma matriz" : "um array");
+                exit(1);
+            }
+        }
+    }
+    if (node->type == NODE_ACCESS) return;
+    check_array_args(fn, node->left);
+    check_array_args(fn, node->right);
+    check_array_args(fn, node->extra);
+}
+
+/* Argumento que dá à função acesso à memória de um array: o array inteiro ou um elemento passado a ref */
+static int array_arg(FuncInfo *callee, ASTNode **args, int i) {
+    if (args[i]->type == NODE_SLICE) return 1;
+    if (args[i]->type == NODE_VAR) return args[i]->kind == KIND_ARRAY || args[i]->kind == KIND_MATRIX;
+    return args[i]->type == NODE_ARRAY_ACCESS && i < callee->nparams && callee->params[i]->passMode == PASS_REF;
+}
+
+/*
+ * Objeto de um argumento array no chamador: a declaração (local, global ou
+ * de tamanho calculado), ou NULL se for um array que o próprio chamador
+ * recebeu e que pode ser qualquer memória de fora dele.
+ */
+static ASTNode* array_root(FuncInfo *fn, ASTNode *arg) {
+    ASTNode *d = resolve_var(fn, arg->strValue);
+    return (d && d->type == NODE_DECL) ? d : NULL;
+}
+
+/* Dois argumentos da mesma chamada podem chegar à mesma memória? */
+static int args_may_alias(FuncInfo *fn, ASTNode *a, ASTNode *b) {
+    ASTNode *ra = array_root(fn, a), *rb = array_root(fn, b);
+    if (ra && rb) return ra == rb;
+    if (ra || rb) return find_global(ra ? ra : rb) != NULL; /* Um recebido só pode ser uma global */
+    /* Dois parâmetros restrict diferentes do chamador já são memórias separadas */
+    if (!fn) return 1;
+    if (strcmp(a->strValue, b->strValue) == 0) return 1;
+    return find_param(fn, a->strValue)->passMode != PASS_RESTRICT || find_param(fn, b->strValue)->passMode != PASS_RESTRICT;
+}
+
+/* A função (ou algo que ela chama) usa pelo nome a global array 'g' (NULL: qualquer global array)? */
+static int names_global_array(FuncInfo *fn, ASTNode *node, ASTNode *g, int *visited) {
+    if (!node || node->type == NODE_ACCESS) return 0;
+    switch (node->type) {
+        case NODE_VAR:
+        case NODE_ARRAY_ACCESS:
+        case NODE_SLICE:
+        case NODE_ASSIGN:
+        case NODE_ASSIGN_IDX:
+        case NODE_READ:
+        case NODE_READ_ALL:
+        case NODE_PRINT_ALL:
+        case NODE_LOAD:
+        case NODE_STORE: {
+            ASTNode *d = resolve_var(fn, node->strValue);
+            if (d && d->type == NODE_DECL && (d->kind == KIND_ARRAY || d->kind == KIND_MATRIX) &&
+                find_global(d) && (!g || d == g)) return 1;
+            break;
+        }
+        case NODE_FUNC_CALL:
+        case NODE_PROC_CALL: {
+            FuncInfo *callee = find_func(node->strValue);
+            if (!callee) return 1;
+            int idx = 0;
+            for (FuncInfo *h = func_list; h != callee; h = h->next) idx++;
+            if (!visited[idx]) {
+                visited[idx] = 1;
+                if (names_global_array(callee, callee->def->right, g, visited)) return 1;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    return names_global_array(fn, node->left, g, visited) ||
+           names_global_array(fn, node->right, g, visited) ||
+           names_global_array(fn, node->extra, g, visited);
+}
+
+/* Retira o restrict dos parâmetros cujo argumento, em alguma chamada do trecho, pode ter apelido */
+static int drop_restrict(FuncInfo *fn, ASTNode *node, int count) {
+    if (!node || node->type == NODE_ACCESS) return 0;
+    int changed = 0;
+    if (node->type == NODE_FUNC_CALL || node->type == NODE_PROC_CALL) {
+        FuncInfo *callee = find_func(node->strValue);
+        ASTNode *args[MAX_PARAMS];
+        int n = collect_params(node->left, args, MAX_PARAMS);
+        for (int i = 0; callee && i < n && i < callee->nparams; i++) {
+            ASTNode *p = callee->params[i];
+            if (p->passMode != PASS_RESTRICT) continue;
+            int alias = 0;
+            for (int j = 0; j < n && !alias; j++) {
+                if (j != i && array_arg(callee, args, j)) alias = args_may_alias(fn, args[i], args[j]);
+            }
+            if (!alias) {
+                ASTNode *root = array_root(fn, args[i]);
+                if (!root || find_global(root)) {
+                    int *visited = (int*) calloc(count + 1, sizeof(int));
+                    alias = names_global_array(callee, callee->def->right, root, visited);
+                    free(visited);
+                }
+            }
+            if (alias) {
+                p->passMode = PASS_VALUE;
+                changed = 1;
+            }
+        }
+    }
+    changed |= drop_restrict(fn, node->left, count);
+    changed |= drop_restrict(fn, node->right, count);
+    changed |= drop_restrict(fn, node->extra, count);
+    return changed;
+}
+
+/*
+ * Parâmetros 'T[]' / 'T[][]' viram ponteiro + tamanhos. O ponteiro é
+ * 'restrict' quando, em todas as chamadas, nenhum outro argumento chega à
+ * mesma memória e a função não usa aquele array pelo nome de global: assim
+ * o gcc pode vetorizar os laços do chamado sem testar sobreposição.
+ * Ponto fixo otimista: todos começam restrict e perdem a marca quando uma
+ * chamada pode apelidar (o apelido entre recebidos depende do restrict do
+ * chamador, então retirar um pode retirar outros).
+ */
+static void plan_array_params(void) {
+    int count = 0;
+    for (FuncInfo *fn = func_list; fn != NULL; fn = fn->next) {
+        count++;
+        check_array_args(fn, fn->def->right);
+        for (int i = 0; i < fn->nparams; i++) {
+            if (is_array_param(fn->params[i])) fn->params[i]->passMode = PASS_RESTRICT;
+        }
+    }
+    check_array_args(NULL, main_body);
+
+    int changed = 1;
+    while (changed) {
+        changed = drop_restrict(NULL, main_body, count);
+        for (FuncInfo *fn = func_list; fn != NULL; fn = fn->next) changed |= drop_restrict(fn, fn->def->right, count);
+    }
+    for (FuncInfo *fn = func_list; fn != NULL; fn = fn->next) {
+        for (int i = 0; i < fn->nparams; i++) {
+            if (fn->params[i]->passMode == PASS_RESTRICT) {
+                printf("[OTIM] Array '%s' de '%s' recebido com restrict.\n", fn->params[i]->strValue, fn->name);
+            }
+        }
+    }
+}
+
+/* --- STRINGS --- */
+
+/* O nome é uma string (ou array de strings) fora do quadro da função? */
+static int outer_string(FuncInfo *fn, char *name) {
+    if (is_local_name(fn, name)) return 0;
+    ASTNode *d = resolve_var(fn, name);
+    return d && d->dataType == TYPE_STRING;
+}
+
+/* O nome é uma unit com campos string fora do quadro da função (global ou recebida por ref)? */
+static int outer_string_unit(FuncInfo *fn, char *name) {
+    ASTNode *p = fn ? find_param(fn, name) : NULL;
+    if (is_local_name(fn, name) && !(p && p->passMode == PASS_REF)) return 0;
+    ASTNode *d = resolve_var(fn, name);
+    return d && d->dataType == 1000 && unit_has_strings(d->unitName);
+}
+
+/*
+ * A função (ou algo que ela chama) pode alterar texto de strings que não são
+ * dela? Alterar pode realocar o texto, então uma vista recebida do chamador
+ * não seria mais válida. Vale também para os campos string de units de fora.
+ */
+static int mutates_outer_strings(FuncInfo *fn, ASTNode *node, int *visited) {
+    if (!node) return 0;
+    switch (node->type) {
+        case NODE_ASSIGN:
+            if (is_field_assign(node)) {
+                if (node->right->dataType == TYPE_STRING && outer_string_unit(fn, node->left->strValue)) return 1;
+                break;
+            }
+            if (outer_string(fn, node->strValue) || outer_string_unit(fn, node->strValue)) return 1;
+            break;
+        case NODE_ASSIGN_IDX:
+        case NODE_READ:
+        case NODE_READ_ALL:
+            if (outer_string(fn, node->strValue)) return 1;
+            break;
+        case NODE_FUNC_CALL:
+        case NODE_PROC_CALL: {
+            FuncInfo *callee = find_func(node->strValue);
+            if (callee) {
+                int idx = 0;
+                for (FuncInfo *g = func_list; g != callee; g = g->next) idx++;
+                if (!visited[idx]) {
+                    visited[idx] = 1;
+                    if (mutates_outer_strings(callee, callee->def->right, visited)) return 1;
+                }
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    return mutates_outer_strings(fn, node->left, visited) ||
+           mutates_outer_strings(fn, node->right, visited) ||
+           mutates_outer_strings(fn, node->extra, visited);
+}
+
+/* O parâmetro é alvo de atribuição ou leitura dentro da função? */
+static int string_param_written(ASTNode *node, char *name) {
+    if (!node) return 0;
+    if ((node->type == NODE_ASSIGN && !is_field_assign(node)) || node->type == NODE_READ) {
+        if (strcmp(node->strValue, name) == 0) return 1;
+    }
+    if (node->type == NODE_ACCESS) return 0;
+    return string_param_written(node->left, name) ||
+           string_param_written(node->right, name) ||
+           string_param_written(node->extra, name);
+}
+
+/*
+ * Parâmetros string são recebidos como vista do texto do chamador quando a
+ * função não os altera e nada que ela executa altera strings de fora.
+ * Caso contrário, a função recebe a vista e faz a própria cópia na entrada.
+ * 'mutates_strings' também serve ao codegen: uma vista de string de fora
+ * tomada numa expressão que chama uma dessas funções precisa ser copiada.
+ */
+static void plan_string_params(void) {
+    int count = 0;
+    for (FuncInfo *fn = func_list; fn != NULL; fn = fn->next) count++;
+
+    for (FuncInfo *fn = func_list; fn != NULL; fn = fn->next) {
+        int *visited = (int*) calloc(count + 1, sizeof(int));
+        fn->mutates_strings = mutates_outer_strings(fn, fn->def->right, visited);
+        free(visited);
+
+        for (int i = 0; i < fn->nparams; i++) {
+            ASTNode *p = fn->params[i];
+            if (p->dataType != TYPE_STRING) continue;
+            if (!fn->mutates_strings && !string_param_written(fn->def->right, p->strValue)) p->passMode = PASS_VIEW;
+        }
+    }
+}
+
+/* --- VALIDAÇÕES --- */
+
+/*
+ * Matriz sem índices só é aceita como echo(A, linhas, colunas) (que não guarda
+ * o nó da variável), argumento de um parâmetro 'T[][]', de rows/cols, de
+ * reduções e de matmul/transpose/fill/copy, ou operando de uma atribuição
+ * de matriz inteira.
+ * Vistas (v[a:b], m[i]) só como argumento de parâmetro array ou de len.
+ */
+static void check_whole_uses(ASTNode *node);
+
+/* Lado direito de 'v := expr' com v array: arrays inteiros valem, o resto é conferido */
+static void check_elementwise_uses(ASTNode *e) {
+    if (e->type == NODE_VAR && e->kind != KIND_SCALAR) return;
+    if ((e->type == NODE_BIN_OP || e->type == NODE_CAST) && e->kind != KIND_SCALAR) {
+        check_elementwise_uses(e->left);
+        if (e->right) check_elementwise_uses(e->right);
+        return;
+    }
+    check_whole_uses(e);
+}
+
+static void check_whole_uses(ASTNode *node) {
+    if (!node) return;
+    if (node->type == NODE_ASSIGN && node->kind != KIND_SCALAR) {
+        check_elementwise_uses(node->left);
+        return;
+    }
+    if (node->type == NODE_VAR && node->kind == KIND_MATRIX) {
+        printf("ERRO (Linha %d): '%s' e matriz, use [][] para acessar.\n", node->line, node->strValue);
+        exit(1);
+    }
+    if (node->type == NODE_SLICE) {
+        printf("ERRO (Linha %d): Vista de '%s' so pode ser passada a um parametro array ou a len.\n", node->line, node->strValue);
+        exit(1);
+    }
+    if (node->type == NODE_FUNC_DEF) {
+        check_whole_uses(node->right); /* Os parâmetros 'T[][] m' não são usos */
+        return;
+    }
+    if (node->type == NODE_BUILTIN && strcmp(node->strValue, "substr") != 0) {
+        /* len/rows/cols e reduções: os argumentos são os próprios arrays ou vistas */
+        ASTNode *args[2];
+        int n = collect_params(node->left, args, 2);
+        for (int i = 0; i < n; i++) {
+            ASTNode *arg = args[i];
+            if (arg->type == NODE_BIN_OP) {
+                check_whole_uses(arg->right); /* count(v == x) */
+                arg = arg->left;
+            }
+            if (arg->type == NODE_SLICE) {
+                check_whole_uses(arg->left);
+                check_whole_uses(arg->right);
+                check_whole_uses(arg->extra);
+            }
+        }
+        return;
+    }
+    if (node->type == NODE_MATRIX_OP) {
+        ASTNode *args[MAX_PARAMS];
+        int n = collect_params(node->left, args, MAX_PARAMS);
+        for (int i = find_matrix_op(node->strValue)->nmats; i < n; i++) check_whole_uses(args[i]);
+        return;
+    }
+    if (node->type == NODE_FUNC_CALL || node->type == NODE_PROC_CALL) {
+        FuncInfo *callee = find_func(node->strValue);
+        ASTNode *args[MAX_PARAMS];
+        int n = collect_params(node->left, args, MAX_PARAMS);
+        for (int i = 0; i < n; i++) {
+            ASTNode *p = (callee && i < callee->nparams) ? callee->params[i] : NULL;
+            int whole = p && args[i]->type == NODE_VAR && p->kind == KIND_MATRIX;
+            int view_ok = p && ((is_array_param(p) && p->kind == KIND_ARRAY) || (p->dataType == TYPE_ARRAY && args[i]->dataType == TYPE_INT));
+            if (args[i]->type == NODE_SLICE && view_ok) {
+                check_whole_uses(args[i]->left);
+                check_whole_uses(args[i]->right);
+                check_whole_uses(args[i]->extra);
+            } else if (!whole) {
+                check_whole_uses(args[i]);
+            }
+        }
+        return;
+    }
+    if (node->type == NODE_ACCESS) return;
+    check_whole_uses(node->left);
+    check_whole_uses(node->right);
+    check_whole_uses(node->extra);
+}
+
+/* --- PARALLEL FOR --- */
+
+/*
+ * O corpo de um parallel for roda em várias threads ao mesmo tempo e vira
+ * uma função à parte. Ficam de fora E/S (o buffer de saída é um só),
+ * return e goto, declarações, strings, units locais e chamadas que fazem
+ * E/S, gravam escalares globais ou usam cache memo. Escalares gravadas no
+ * corpo precisam estar num reduce ou num private, ou ser variável de um
+ * 'for' de dentro lida só nele; qualquer outra é compartilhada pelas
+ * threads e a escrita seria uma corrida.
+ */
+
+/* O chamado (ou alguém que ele chama) faz E/S, grava global ou usa cache memo? Devolve o motivo */
+static const char* par_unsafe(FuncInfo *fn, ASTNode *node, int *visited) {
+    if (!node || node->type == NODE_ACCESS) return NULL;
+    switch (node->type) {
+        case NODE_ASSIGN:
+        case NODE_FOR:
+            if (fn && !(node->type == NODE_ASSIGN && is_field_assign(node))) {
+                ASTNode *d = resolve_var(fn, node->strValue);
+                GlobalInfo *g = d ? find_global(d) : NULL;
+                if (g && !g->home && d->kind == KIND_SCALAR) return "grava variavel global";
+            }
+            break;
+        case NODE_PRINT:
+        case NODE_PRINT_ALL:
+        case NODE_READ:
+        case NODE_READ_ALL:
+        case NODE_MAP_OPEN:
+        case NODE_MAP_CLOSE:
+        case NODE_LOAD:
+        case NODE_STORE:
+            return "faz E/S";
+        case NODE_FUNC_CALL:
+        case NODE_PROC_CALL: {
+            int idx = 0;
+            FuncInfo *callee = func_list;
+            while (callee && strcmp(callee->name, node->strValue) != 0) {
+                callee = callee->next;
+                idx++;
+            }
+            if (!callee || visited[idx]) break;
+            visited[idx] = 1;
+            if (callee->def->memo) return "e memo (a cache e compartilhada)";
+            const char *why = par_unsafe(callee, callee->def->right, visited);
+            if (why) return why;
+            break;
+        }
+        default:
+            break;
+    }
+    const char *why = par_unsafe(fn, node->left, visited);
+    if (!why) why = par_unsafe(fn, node->right, visited);
+    return why ? why : par_unsafe(fn, node->extra, visited);
+}
+
+/* Toda menção de 'var' está dentro de um 'for var' */
+static int loop_local(ASTNode *node, char *var) {
+    if (!node || node->type == NODE_ACCESS) return 1;
+    if ((node->type == NODE_VAR || (node->type == NODE_ASSIGN && !is_field_assign(node))) && strcmp(node->strValue, var) == 0) return 0;
+    if (node->type == NODE_FOR && strcmp(node->strValue, var) == 0) return loop_local(node->left, var) && loop_local(node->right, var);
+    return loop_local(node->left, var) && loop_local(node->right, var) && loop_local(node->extra, var);
+}
+
+static int in_par_clause(ASTNode *par, char *name) {
+    for (ASTNode *c = par->right; c; c = c->right) {
+        if (strcmp(c->left->strValue, name) == 0) return 1;
+    }
+    return 0;
+}
+
+static void par_write(FuncInfo *fn, ASTNode *par, ASTNode *at, char *name) {
+    ASTNode *loop = par->left;
+    if (strcmp(name, loop->strValue) == 0) {
+        printf("ERRO (Linha %d): O corpo do parallel for altera o iterador '%s'.\n", at->line, name);
+        exit(1);
+    }
+    ASTNode *p = fn ? find_param(fn, name) : NULL;
+    if (opt_openmp && p && p->passMode == PASS_REF) {
+        /* No OpenMP as cópias das threads são variáveis do C: parâmetro ref é um ponteiro */
+        printf("ERRO (Linha %d): Com --openmp, o parallel for nao pode gravar '%s' (parametro ref).\n", at->line, name);
+        exit(1);
+    }
+    if (in_par_clause(par, name) || loop_local(loop->extra, name)) return;
+    printf("ERRO (Linha %d): parallel for grava a variavel compartilhada '%s' (use reduce(op: %s) ou private(%s)).\n",
+           at->line, name, name, name);
+    exit(1);
+}
+
+/* Variável que no C gerado é global de verdade (não local de função nem do main) */
+static int c_global(FuncInfo *fn, char *name) {
+    ASTNode *d = resolve_var(fn, name);
+    GlobalInfo *g = d ? find_global(d) : NULL;
+    return g && !g->home && !g->home_main;
+}
+
+/*
+ * Primeiro trecho de 'node' que impede rodar as voltas em várias threads:
+ * devolve o motivo ("E/S", "return", ...) e o nó em *at, ou NULL.
+ */
+const char* par_blocker(FuncInfo *fn, ASTNode *node, ASTNode **at) {
+    static char why[256];
+    const char *r;
+    if (!node) return NULL;
+    *at = node;
+    if (node->dataType == TYPE_STRING) return "string";
+    switch (node->type) {
+        case NODE_PRINT:
+        case NODE_PRINT_ALL:
+        case NODE_READ:
+        case NODE_READ_ALL:
+        case NODE_MAP_OPEN:
+        case NODE_MAP_CLOSE:
+        case NODE_LOAD:
+        case NODE_STORE:
+            return "E/S";
+        case NODE_RETURN:
+            return "return";
+        case NODE_DECL:
+            return "declaracao";
+        case NODE_GOTO:
+        case NODE_LABEL:
+            return "goto ou rotulo";
+        case NODE_PARALLEL:
+            return "outro parallel for";
+        case NODE_ACCESS:
+            return c_global(fn, node->strValue) ? NULL : "unit local";
+        case NODE_VAR:
+            if (node->dataType == 1000 && !c_global(fn, node->strValue)) return "unit local";
+            break;
+        case NODE_ASSIGN: {
+            if (is_field_assign(node)) return "atribuicao a campo de unit";
+            ASTNode *d = resolve_var(fn, node->strValue);
+            if (d && d->dataType == TYPE_STRING) return "string";
+            break;
+        }
+        case NODE_FUNC_CALL:
+        case NODE_PROC_CALL: {
+            int count = 0;
+            for (FuncInfo *g = func_list; g != NULL; g = g->next) count++;
+            int *visited = (int*) calloc(count + 1, sizeof(int));
+            r = par_unsafe(NULL, node, visited);
+            free(visited);
+            if (r) {
+                snprintf(why, sizeof(why), "chamada a '%s', que %s", node->strValue, r);
+                return why;
+            }
+            FuncInfo *callee = find_func(node->strValue);
+            ASTNode *args[MAX_PARAMS];
+            int n = collect_params(node->left, args, MAX_PARAMS);
+            for (int i = 0; callee && i < n && i < callee->nparams; i++) {
+                if (callee->params[i]->passMode == PASS_REF && args[i]->type == NODE_ACCESS) return "campo de unit passado por ref";
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    if ((r = par_blocker(fn, node->left, at)) != NULL) return r;
+    if ((r = par_blocker(fn, node->right, at)) != NULL) return r;
+    return par_blocker(fn, node->extra, at);
+}
+
+/* Escalares gravadas no corpo: só as das cláusulas e variáveis de 'for' de dentro */
+static void check_par_writes(FuncInfo *fn, ASTNode *par, ASTNode *node) {
+    if (!node || node->type == NODE_ACCESS) return;
+    if (node->type == NODE_ASSIGN && !is_field_assign(node) && node->kind == KIND_SCALAR) par_write(fn, par, node, node->strValue);
+    if (node->type == NODE_FOR) par_write(fn, par, node, node->strValue);
+    if (node->type == NODE_FUNC_CALL || node->type == NODE_PROC_CALL) {
+        FuncInfo *callee = find_func(node->strValue);
+        ASTNode *args[MAX_PARAMS];
+        int n = collect_params(node->left, args, MAX_PARAMS);
+        for (int i = 0; callee && i < n && i < callee->nparams; i++) {
+            if (callee->params[i]->passMode == PASS_REF && args[i]->type == NODE_VAR) par_write(fn, par, node, args[i]->strValue);
+        }
+    }
+    check_par_writes(fn, par, node->left);
+    check_par_writes(fn, par, node->right);
+    check_par_writes(fn, par, node->extra);
+}
+
+static void check_parallel(FuncInfo *fn, ASTNode *node) {
+    if (!node || node->type == NODE_ACCESS) return;
+    if (node->type == NODE_PARALLEL) {
+        ASTNode *loop = node->left, *at;
+        const char *why = par_blocker(fn, loop, &at);
+        if (why) {
+            printf("ERRO (Linha %d): parallel for nao pode ter %s.\n", at->line, why);
+            exit(1);
+        }
+        check_par_writes(fn, node, loop->left);
+        check_par_writes(fn, node, loop->right);
+        check_par_writes(fn, node, loop->extra);
+        for (ASTNode *c = node->right; opt_openmp && fn && c; c = c->right) {
+            ASTNode *p = find_param(fn, c->left->strValue);
+            if (p && p->passMode == PASS_REF) {
+                printf("ERRO (Linha %d): Com --openmp, '%s' (parametro ref) nao pode estar em reduce ou private.\n", node->line, p->strValue);
+                exit(1);
+            }
+        }
+        ASTNode *p = fn ? find_param(fn, loop->strValue) : NULL;
+        if (opt_openmp && p && p->passMode == PASS_REF) {
+            printf("ERRO (Linha %d): Com --openmp, o iterador '%s' nao pode ser parametro ref.\n", node->line, p->strValue);
+            exit(1);
+        }
+        return;
+    }
+    check_parallel(fn, node->left);
+    check_parallel(fn, node->right);
+    check_parallel(fn, node->extra);
+}
+
+/* --- DRIVER --- */
+
+static void collect_funcs(ASTNode *node) {
+    if (!node) return;
+    if (node->type == NODE_SEQ) {
+        collect_funcs(node->left);
+        collect_funcs(node->right);
+        return;
+    }
+    if (node->type == NODE_UNIT_DEF) {
+        UnitInfo *u = (UnitInfo*) malloc(sizeof(UnitInfo));
+        memset(u, 0, sizeof(UnitInfo));
+        u->name = node->strValue;
+        ASTNode **fields;
+        int n = flatten_seq(node->left, &fields);
+        u->scalar_only = 1;
+        for (int i = 0; i < n && u->nfields < MAX_FIELDS; i++) {
+            ASTNode *fd = fields[i];
+            u->fields[u->nfields++] = fd;
+            if (fd->kind != KIND_SCALAR || fd->dataType == TYPE_STRING) u->scalar_only = 0;
+        }
+        if (n > MAX_FIELDS) u->scalar_only = 0;
+        free(fields);
+        u->next = unit_list;
+        unit_list = u;
+        return;
+    }
+    if (node->type == NODE_DECL) {
+        GlobalInfo *g = (GlobalInfo*) malloc(sizeof(GlobalInfo));
+        memset(g, 0, sizeof(GlobalInfo));
+        g->decl = node;
+
+        GlobalInfo **gtail = &global_list;
+        while (*gtail) gtail = &(*gtail)->next;
+        *gtail = g;
+        return;
+    }
+    if (node->type != NODE_FUNC_DEF) return;
+
+    FuncInfo *fn = (FuncInfo*) malloc(sizeof(FuncInfo));
+    memset(fn, 0, sizeof(FuncInfo));
+    fn->name = node->strValue;
+    fn->def = node;
+    fn->nparams = collect_params(node->left, fn->params, MAX_PARAMS);
+
+    /* Mantém a ordem do código fonte */
+    FuncInfo **tail = &func_list;
+    while (*tail) tail = &(*tail)->next;
+    *tail = fn;
+}
+
+void analyze_program(ASTNode *root) {
+    func_list = NULL;
+    global_list = NULL;
+    unit_list = NULL;
+    if (root->type == NODE_SEQ) {
+        collect_funcs(root->left);
+        main_body = root->right;
+    } else {
+        main_body = root;
+    }
+
+    check_whole_uses(root);
+    plan_ref_params();
+    plan_array_params();
+    plan_string_params();
+    compute_effects();
+    promote_globals();
+    scalarize_units();
+    lower_unit_passing();
+
+    for (FuncInfo *fn = func_list; fn != NULL; fn = fn->next) {
+        if (fn->def->memo || opt_memo_auto) detect_memo(fn);
+    }
+
+    for (FuncInfo *fn = func_list; fn != NULL; fn = fn->next) check_parallel(fn, fn->def->right);
+    check_parallel(NULL, main_body);
+}
@@ -0,0 +1,114 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include "ast.h"
+
+#define MAX_PARAMS 32
+#define MAX_FIELDS 64
+
+/* Passagem de parâmetros no C gerado */
+#define PASS_VALUE     0   /* Cópia (padrão) */
+#define PASS_CONST_PTR 1   /* Unit nunca modificada: 'const struct X *' */
+#define PASS_REF       2   /* Parâmetro 'ref': ponteiro para a variável do chamador */
+#define PASS_VIEW      3   /* String só lida: vista (ezc_sv) do texto do chamador, sem cópia */
+#define PASS_RESTRICT  4   /* Array tipado que nada mais apelida durante a chamada: 'T *restrict' */
+
+/* Classes de efeito (ordenadas: o efeito de uma função é o máximo do corpo e dos chamados) */
+#define EFFECT_CONST  0   /* Depende apenas dos argumentos */
+#define EFFECT_PURE   1   /* Lê globais/memória apontada, mas não escreve */
+#define EFFECT_WRITES 2   /* Escreve globais ou arrays recebidos, ou faz I/O */
+
+/*
+ * Informações coletadas sobre cada função do programa antes da geração de código.
+ * A lista é montada a partir da AST (a tabela de símbolos já descartou os
+ * escopos locais quando o codegen roda).
+ */
+typedef struct FuncInfo {
+    char *name;
+    ASTNode *def;                 /* Nó NODE_FUNC_DEF */
+    ASTNode *params[MAX_PARAMS];  /* Parâmetros na ordem da declaração */
+    int nparams;
+    int effect;                   /* EFFECT_CONST / EFFECT_PURE / EFFECT_WRITES */
+    ASTNode **build_exprs;        /* Construtor de unit: expressão de cada campo (NULL se não for) */
+    int ret_slot;                 /* Devolve unit num espaço do chamador: void f(struct X *ret__, ...) */
+    ASTNode *ref_cache;           /* Parâmetro ref escalar mantido numa local (r__v) durante a chamada */
+    int mutates_strings;          /* Pode alterar (realocar) strings de fora da função, direta ou indiretamente */
+    struct FuncInfo *next;
+} FuncInfo;
+
+/* Definição de unit (struct): campos na ordem da declaração */
+typedef struct UnitInfo {
+    char *name;
+    ASTNode *fields[MAX_FIELDS];  /* Nós NODE_DECL dos campos */
+    int nfields;
+    int scalar_only;              /* Todos os campos são int/float/char escalares */
+    struct UnitInfo *next;
+} UnitInfo;
+
+/*
+ * Variáveis declaradas no escopo global. A análise de escape decide se a
+ * variável pode virar local da única função que a usa (ou do main).
+ */
+typedef struct GlobalInfo {
+    ASTNode *decl;               /* Nó NODE_DECL no escopo global */
+    FuncInfo *home;              /* != NULL: passa a ser local desta função */
+    int home_main;               /* 1: passa a ser local do main */
+    struct GlobalInfo *next;
+} GlobalInfo;
+
+extern FuncInfo *func_list;
+extern UnitInfo *unit_list;
+extern GlobalInfo *global_list;
+extern ASTNode *main_body;
+
+void analyze_program(ASTNode *root);
+FuncInfo* find_func(char *name);
+GlobalInfo* find_global(ASTNode *decl);
+UnitInfo* find_unit(char *name);
+ASTNode* resolve_var(FuncInfo *fn, char *name);
+char* unit_of(FuncInfo *fn, char *name);
+int contains_call(ASTNode *node);
+int is_field_assign(ASTNode *node);
+int flatten_seq(ASTNode *node, ASTNode ***out);
+
+int collect_params(ASTNode *list, ASTNode **out, int max);
+int is_local_name(FuncInfo *fn, char *name);
+ASTNode* find_param(FuncInfo *fn, char *name);
+int is_array_param(ASTNode *p);
+int is_reduction(ASTNode *node);
+
+/*
+ * Operações de matriz embutidas: matmul(R, A, B [, n, m, p]),
+ * transpose(T, A [, n, m]), fill(A, x [, n, m]) e copy(D, S [, n, m]).
+ * As matrizes vêm primeiro (a primeira é o destino), depois o valor de
+ * fill e, opcionais, as dimensões. Cada dimensão precisa caber nos tamanhos
+ * de 'limits' (matriz, 0 = linhas / 1 = colunas; matriz -1 termina). Sem
+ * as dimensões, vale o primeiro tamanho da lista e os outros têm de ser iguais.
+ */
+#define MAX_MATRIX_DIMS 3
+
+typedef struct {
+    const char *name;
+    int nmats;
+    int has_value;
+    int ndims;
+    int limits[MAX_MATRIX_DIMS][2][2];
+} MatrixOp;
+
+const MatrixOp* find_matrix_op(const char *name);
+
+/* Memoização */
+int memo_signature_ok(ASTNode *def);
+int count_self_calls(ASTNode *node, char *name);
+
+/* Parâmetros ref */
+int ref_arg_of(ASTNode *call, char *name);
+int passed_by_ref(ASTNode *node, char *name);
+
+/* Efeitos */
+const char* effect_name(int effect);
+
+/* Parallel for: o que impede o trecho de rodar em várias threads (NULL: nada) */
+const char* par_blocker(FuncInfo *fn, ASTNode *node, ASTNode **at);
+
+#endif
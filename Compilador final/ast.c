@@ -2,6 +2,8 @@
 #include "y.tab.h"
 #include "symbol_table.h"
 
+extern int yylineno; /* Mantido pelo lexer */
+
 /* 
  * CONSTRUTOR GENÉRICO (FÁBRICA BASE)
  * 
@@ -10,7 +12,11 @@
  */
 ASTNode* create_node(NodeType type) {
     ASTNode *node = (ASTNode*) malloc(sizeof(ASTNode));
+    /* Zera todos os campos (dataType, kind, unitName, memo...) para que
+       as análises nunca leiam lixo de nós que não os preenchem. */
+    memset(node, 0, sizeof(ASTNode));
     node->type = type;
+    node->line = yylineno;
     node->left = NULL;
     node->right = NULL;
     node->extra = NULL;
@@ -140,6 +146,15 @@ ASTNode* create_array_access(char *name, ASTNode *idx1, ASTNode *idx2) {
     return node;
 }
 
+ASTNode* create_slice(char *name, ASTNode *row, ASTNode *start, ASTNode *end) {
+    ASTNode *node = create_node(NODE_SLICE);
+    node->strValue = strdup(name);
+    node->left = row;    /* Linha da matriz (NULL se for vetor) */
+    node->right = start; /* Início (NULL: linha inteira) */
+    node->extra = end;   /* Fim, exclusivo */
+    return node;
+}
+
 /* Variação de leitura específica para Arrays (guarda o índice) */
 ASTNode* create_read_array(char *varName, ASTNode *index, int type) {
     ASTNode *node = create_node(NODE_READ);
@@ -161,6 +176,22 @@ ASTNode* create_read_matrix(char *varName, ASTNode *row, ASTNode *col, int type)
     return node;
 }
 
+/*
+ * E/S do container inteiro: read(v, n), read(A, r, c), echo(v, n), echo(A, r, c).
+ * size1/size2 guardam as dimensões declaradas (0 = desconhecida, ex: parâmetro arr[]).
+ */
+ASTNode* create_bulk_io(NodeType type, char *varName, int elemType, int kind, int size1, int size2, ASTNode *rows, ASTNode *cols) {
+    ASTNode *node = create_node(type);
+    node->strValue = strdup(varName);
+    node->dataType = elemType;
+    node->kind = kind;
+    node->size1 = size1;
+    node->size2 = size2;
+    node->left = rows;
+    node->right = cols;
+    return node;
+}
+
 /* Atribuição em índice: arr[x] = y */
 ASTNode* create_assign_idx(char *name, ASTNode *idx1, ASTNode *idx2, ASTNode *val) {
     ASTNode *node = create_node(NODE_ASSIGN_IDX);
@@ -336,6 +367,25 @@ void print_ast(ASTNode *node, int level) {
             }
             break;
             
+        case NODE_SLICE:
+            printf("Slice: %s\n", node->strValue);
+            print_ast(node->left, level+1);
+            print_ast(node->right, level+1);
+            print_ast(node->extra, level+1);
+            break;
+
+        case NODE_MATRIX_OP:
+            printf("Matrix Op: %s\n", node->strValue);
+            print_ast(node->left, level+1);
+            break;
+
+        case NODE_PARALLEL:
+            printf("PARALLEL (%s)\n", node->intValue ? "dynamic" : "static");
+            print_ast(node->left, level+1);
+            print_indent(level+1); printf("Clausulas:\n");
+            print_ast(node->right, level+2);
+            break;
+
         case NODE_ASSIGN_IDX:
             printf("Assign Array: %s [...] :=\n", node->strValue);
             print_indent(level+1); printf("Index 1:\n");
@@ -349,7 +399,8 @@ void print_ast(ASTNode *node, int level) {
             break;
             
         case NODE_FUNC_DEF:
-            printf("FUNCTION: %s (Type: %d)\n", node->strValue, node->dataType);
+            printf("FUNCTION: %s (Type: %d)%s\n", node->strValue, node->dataType,
+                   node->memo ? " [memo]" : "");
             print_indent(level+1); printf("Params:\n");
             print_ast(node->left, level+2);
             print_indent(level+1); printf("Body:\n");
@@ -373,10 +424,36 @@ void print_ast(ASTNode *node, int level) {
             print_ast(node->left, level+2);
             break;
             
+        case NODE_BUILTIN:
+            printf("Builtin: %s(...)\n", node->strValue);
+            print_indent(level+1); printf("Args:\n");
+            print_ast(node->left, level+2);
+            break;
+
         case NODE_ARG_LIST:
             printf("Arg:\n");
             print_ast(node->left, level+1);
             if(node->right) print_ast(node->right, level);
             break;
+
+        case NODE_READ_ALL:
+        case NODE_PRINT_ALL:
+            printf("%s (inteiro): %s\n", node->type == NODE_READ_ALL ? "READ" : "PRINT", node->strValue);
+            print_ast(node->left, level+1);
+            print_ast(node->right, level+1);
+            break;
+
+        case NODE_MAP_OPEN:
+        case NODE_MAP_CLOSE:
+            printf("%s\n", node->type == NODE_MAP_OPEN ? "OPEN_MAP" : "CLOSE_MAP");
+            print_ast(node->left, level+1);
+            break;
+
+        case NODE_LOAD:
+        case NODE_STORE:
+            printf("%s: %s\n", node->type == NODE_LOAD ? "LOAD" : "STORE", node->strValue);
+            print_ast(node->left, level+1);
+            print_ast(node->right, level+1);
+            break;
     }
 }
\ No newline at end of file
@@ -32,7 +32,17 @@ typedef enum {
     NODE_PARAM_LIST,   // Lista de Parâmetros
     NODE_ARG_LIST,      // Lista de Argumentos (na chamada)
     NODE_UNIT_DEF,     // Definição da Unit (o molde)
-    NODE_ACCESS 
+    NODE_ACCESS,
+    NODE_READ_ALL,     // read(v, n) / read(A, linhas, colunas)
+    NODE_PRINT_ALL,    // echo(v, n) / echo(A, linhas, colunas)
+    NODE_MAP_OPEN,     // open_map(caminho): devolve um handle inteiro
+    NODE_MAP_CLOSE,    // close_map(h)
+    NODE_LOAD,         // load(X, h [, deslocamento])
+    NODE_STORE,        // store(X, caminho)
+    NODE_BUILTIN,      // Função embutida (strValue = nome, left = argumentos)
+    NODE_SLICE,        // Vista de parte de um array: v[a:b], m[i], m[i][a:b]
+    NODE_MATRIX_OP,    // matmul/transpose/fill/copy (strValue = nome, left = argumentos)
+    NODE_PARALLEL      // parallel for (left = for, right = NODE_VAR das cláusulas: intValue = operação do reduce, 0 = private)
 } NodeType;
 
 // Estrutura do Nó da Árvore
@@ -46,6 +56,12 @@ typedef struct ASTNode {
     int size1;
     int size2;
     char *unitName;
+    int memo;           // Funções: 1 = anotada com 'memo', 2 = detectada automaticamente
+    int scalarized;     // Declarações de unit: campos viram escalares independentes
+    int passMode;       // Parâmetros: PASS_VALUE, PASS_CONST_PTR, PASS_REF, PASS_VIEW ou PASS_RESTRICT (ver analysis.h)
+    int line;           // Linha do fonte onde o nó foi criado (mensagens de erro)
+    int tmp;            // Expressões string: 1 + índice da temporária do comando (0 = nenhuma)
+    int minTrips;       // Parallel for do --auto-par: voltas mínimas para usar threads (0 = sempre usa)
 
     struct ASTNode *left;
     struct ASTNode *right;
@@ -68,6 +84,8 @@ ASTNode* create_float_const(float val);
 ASTNode* create_array_access(char *name, ASTNode *idx1, ASTNode *idx2);
 ASTNode* create_read_array(char *varName, ASTNode *index, int type);
 ASTNode* create_read_matrix(char *varName, ASTNode *row, ASTNode *col, int type);
+ASTNode* create_bulk_io(NodeType type, char *varName, int elemType, int kind, int size1, int size2, ASTNode *rows, ASTNode *cols);
+ASTNode* create_slice(char *name, ASTNode *row, ASTNode *start, ASTNode *end);
 ASTNode* create_assign_idx(char *name, ASTNode *idx1, ASTNode *idx2, ASTNode *val);
 ASTNode* create_unit_def(char *name, ASTNode *fields);
 ASTNode* create_access(char *var, char *field);
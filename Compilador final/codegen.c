@@ -1,28 +1,3879 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include "ast.h"
 #include "y.tab.h"
 #include "symbol_table.h"
+#include "analysis.h"
+#include "runtime.h"
+#include "codegen.h"
+
+/* Opções de linha de comando (ver codegen.h) */
+int opt_memo_auto = 0;
+int opt_stdio = 0;
+int opt_bounds_check = 0;
+int opt_checked_arith = 0;
+int opt_openmp = 0;
+int opt_auto_par = 0;
 
 /* * Variável Global 'f': 
  * Aponta para o ficheiro .c que está a ser gerado. 
  * É global para evitar passá-la como argumento em todas as chamadas recursivas.
  */
-FILE *f = NULL;
+FILE *f = NULL;
+
+/* Função cujo corpo está sendo gerado (NULL = escopo global / main) */
+static FuncInfo *current_func = NULL;
+
+/*
+ * Substituição de parâmetros ao expandir um construtor de unit no chamador:
+ * enquanto ativa, o parâmetro 'name' é gerado como a expressão 'arg',
+ * convertida para o tipo do parâmetro como faria a passagem por valor.
+ */
+typedef struct {
+    char *name;
+    ASTNode *arg;
+    int type;
+} Subst;
+
+static Subst subst[MAX_PARAMS];
+static int nsubst = 0;
+
+/*
+ * Função Auxiliar: map_type
+ * Traduz os tipos internos da linguagem (TYPE_INT, etc.) para os tipos da linguagem C.
+ * Exemplo: TYPE_STRING torna-se "ezc_str" (string do runtime, com tamanho).
+ */
+const char* map_type(int type) {
+    switch (type) {
+        case TYPE_INT:      return "int";
+        case TYPE_FLOAT:    return "float";
+        case TYPE_CHAR:     return "char";
+        case TYPE_STRING:   return "ezc_str"; // Ver runtime de strings
+		case TYPE_ARRAY:    return "int*";
+        default:            return "int";   // Fallback de segurança
+    }
+}
+
+void gen_code(ASTNode *node);
+
+static Subst* subst_find(char *name) {
+    for (int i = 0; i < nsubst; i++) {
+        if (strcmp(subst[i].name, name) == 0) return &subst[i];
+    }
+    return NULL;
+}
+
+static ASTNode* subst_lookup(char *name) {
+    Subst *s = subst_find(name);
+    return s ? s->arg : NULL;
+}
+
+/* Gera o argumento no contexto do chamador (sem substituições): '((int)(q))' */
+static void gen_subst_arg(Subst *s) {
+    int saved = nsubst;
+    int scalar = s->type == TYPE_INT || s->type == TYPE_FLOAT || s->type == TYPE_CHAR;
+    nsubst = 0;
+    fprintf(f, scalar ? "((%s)(" : "(", map_type(s->type));
+    gen_code(s->arg);
+    fprintf(f, scalar ? "))" : ")");
+    nsubst = saved;
+}
+
+/* Declaração de unit substituída por escalares no contexto atual (ou NULL) */
+static ASTNode* scalarized_unit(char *name) {
+    ASTNode *d = resolve_var(current_func, name);
+    return (d && d->type == NODE_DECL && d->scalarized) ? d : NULL;
+}
+
+/* Parâmetro unit recebido por ponteiro ('const struct X *' ou ref) na função atual? */
+static int unit_ptr_param(char *name) {
+    ASTNode *p = current_func ? find_param(current_func, name) : NULL;
+    return p && p->dataType == 1000 && p->passMode != PASS_VALUE;
+}
+
+/* Parâmetro ref escalar da função atual (NULL se não for) */
+static ASTNode* scalar_ref_param(char *name) {
+    ASTNode *p = current_func ? find_param(current_func, name) : NULL;
+    return (p && p->passMode == PASS_REF && p->dataType != 1000) ? p : NULL;
+}
+
+/* Variável escalar como lvalue: 'x', '(*r)' para ref, ou 'r__v' se o ref está numa local */
+static void gen_var_name(char *name) {
+    ASTNode *p = scalar_ref_param(name);
+    if (p && current_func->ref_cache == p) fprintf(f, "%s__v", name);
+    else if (p) fprintf(f, "(*%s)", name);
+    else fprintf(f, "%s", name);
+}
+
+/* Endereço de um argumento passado a um parâmetro ref (o parser garantiu que é lvalue) */
+static void gen_ref_address(ASTNode *arg) {
+    if (arg->type == NODE_VAR && unit_ptr_param(arg->strValue)) {
+        fprintf(f, "%s", arg->strValue);
+        return;
+    }
+    fprintf(f, "&");
+    if (arg->type == NODE_VAR) gen_var_name(arg->strValue);
+    else gen_code(arg);
+}
+
+/* Campo de uma variável unit: "r.num", "r->num" (referência) ou "r__num" (escalares) */
+static void gen_unit_field(char *var, char *field) {
+    if (scalarized_unit(var)) fprintf(f, "%s__%s", var, field);
+    else if (unit_ptr_param(var)) fprintf(f, "%s->%s", var, field);
+    else fprintf(f, "%s.%s", var, field);
+}
+
+/* Campo acessado (p1.x) como lvalue; dentro de um construtor expandido, vem da variável do chamador */
+static void gen_access_lvalue(ASTNode *node) {
+    ASTNode *arg = subst_lookup(node->strValue);
+    if (arg) {
+        int saved = nsubst;
+        nsubst = 0;
+        gen_unit_field(arg->strValue, node->extra->strValue);
+        nsubst = saved;
+    } else {
+        gen_unit_field(node->strValue, node->extra->strValue);
+    }
+}
+
+/* A função chamada devolve unit num espaço do chamador? */
+static int slot_call(ASTNode *node) {
+    if (!node || node->type != NODE_FUNC_CALL) return 0;
+    FuncInfo *callee = find_func(node->strValue);
+    return callee && callee->ret_slot;
+}
+
+/*
+ * Endereço de um argumento unit para um parâmetro 'const struct X *'.
+ * Variáveis struct passam '&x'; valores sem endereço (escalares remontados,
+ * resultados de chamadas) viram um literal composto de array, que decai para ponteiro.
+ */
+static void gen_unit_address(ASTNode *arg, char *unitName) {
+    if (arg->type == NODE_VAR && !subst_lookup(arg->strValue) && !scalarized_unit(arg->strValue)) {
+        if (unit_ptr_param(arg->strValue)) fprintf(f, "%s", arg->strValue);
+        else fprintf(f, "&%s", arg->strValue);
+        return;
+    }
+    fprintf(f, "(struct %s[]){ ", unitName);
+    gen_code(arg);
+    fprintf(f, " }");
+}
+
+/* Variável na raiz de um argumento ref (x, x.campo ou v[i]); NULL se não houver */
+static char* ref_root(ASTNode *arg) {
+    if (arg->type == NODE_VAR || arg->type == NODE_ACCESS || arg->type == NODE_ARRAY_ACCESS) return arg->strValue;
+    return NULL;
+}
+
+/*
+ * O argumento k, passado por 'const struct X *', pode ser alcançado por um
+ * parâmetro ref da mesma chamada (ex: f(a.x, a))? O chamado escreveria no
+ * original que deveria ver como cópia. Refs recebidos pela função atual
+ * podem apontar um para o outro, então também contam.
+ */
+static int unit_arg_aliased(FuncInfo *callee, ASTNode **args, int n, int k) {
+    if (args[k]->type != NODE_VAR) return 0;
+    char *name = args[k]->strValue;
+    ASTNode *pk = current_func ? find_param(current_func, name) : NULL;
+    for (int i = 0; i < n && i < callee->nparams; i++) {
+        if (i == k || callee->params[i]->passMode != PASS_REF) continue;
+        char *root = ref_root(args[i]);
+        if (!root) continue;
+        if (strcmp(root, name) == 0) return 1;
+        ASTNode *pi = current_func ? find_param(current_func, root) : NULL;
+        if (pk && pi && pk->passMode == PASS_REF && pi->passMode == PASS_REF) return 1;
+    }
+    return 0;
+}
+
+static void gen_array_arg(ASTNode *arg);
+static void gen_index(ASTNode *site, ASTNode *e, int which);
+
+/*
+ * Chamada de função. 'slot' é o ponteiro de destino para funções que
+ * devolvem unit no espaço do chamador (NULL nas demais).
+ */
+static void gen_call(ASTNode *node, const char *slot) {
+    FuncInfo *callee = find_func(node->strValue);
+    ASTNode *args[MAX_PARAMS];
+    int n = collect_params(node->left, args, MAX_PARAMS);
+
+    fprintf(f, "%s(", node->strValue);
+    if (slot) fprintf(f, "%s%s", slot, n ? ", " : "");
+    for (int i = 0; i < n; i++) {
+        if (i) fprintf(f, ", ");
+        if (callee && i < callee->nparams && callee->params[i]->passMode == PASS_CONST_PTR) {
+            if (unit_arg_aliased(callee, args, n, i)) {
+                /* Cópia feita aqui, como na passagem por valor */
+                fprintf(f, "(struct %s[]){ ", callee->params[i]->unitName);
+                gen_code(args[i]);
+                fprintf(f, " }");
+            } else {
+                gen_unit_address(args[i], callee->params[i]->unitName);
+            }
+        } else if (callee && i < callee->nparams && callee->params[i]->passMode == PASS_REF) {
+            gen_ref_address(args[i]);
+        } else if (callee && i < callee->nparams && is_array_param(callee->params[i])) {
+            gen_array_arg(args[i]);
+        } else {
+            gen_code(args[i]);
+        }
+    }
+    fprintf(f, ")");
+}
+
+static int unit_has_strings(char *unitName);
+
+/*
+ * Unit com campos string: cada variável é dona do próprio texto, então a
+ * atribuição inteira copia campo a campo (unit__copy) em vez de copiar a struct.
+ */
+static void gen_unit_copy(const char *dest_ptr, ASTNode *e, char *unitName) {
+    fprintf(f, "%s__copy(%s, ", unitName, dest_ptr);
+    gen_unit_address(e, unitName);
+    fprintf(f, ");\n");
+}
+
+/* Escreve o valor unit 'e' em *dest_ptr */
+static void gen_unit_store(const char *dest_ptr, ASTNode *e) {
+    ASTNode *d;
+    char *un = e->type == NODE_VAR ? unit_of(current_func, e->strValue) : NULL;
+    if (slot_call(e)) {
+        gen_call(e, dest_ptr);
+        fprintf(f, ";\n");
+    } else if (e->type == NODE_VAR && (d = scalarized_unit(e->strValue)) != NULL) {
+        UnitInfo *u = find_unit(d->unitName);
+        for (int k = 0; k < u->nfields; k++) {
+            fprintf(f, "(%s)->%s = %s__%s;\n", dest_ptr, u->fields[k]->strValue, e->strValue, u->fields[k]->strValue);
+        }
+    } else if (un && unit_has_strings(un)) {
+        gen_unit_copy(dest_ptr, e, un);
+    } else {
+        fprintf(f, "*(%s) = ", dest_ptr);
+        gen_code(e);
+        fprintf(f, ";\n");
+    }
+}
+
+/* Declara os campos de uma unit substituída como variáveis independentes */
+static void gen_scalarized_decl(ASTNode *d, int zero_init) {
+    UnitInfo *u = find_unit(d->unitName);
+    for (int i = 0; i < u->nfields; i++) {
+        fprintf(f, "%s %s__%s", map_type(u->fields[i]->dataType), d->strValue, u->fields[i]->strValue);
+        if (zero_init) fprintf(f, " = 0");
+        fprintf(f, ";\n");
+    }
+}
+
+/*
+ * Argumentos simples o bastante para o construtor ser expandido no chamador:
+ * sem chamadas (duplicar ou omitir a avaliação não muda o resultado) e, para
+ * parâmetros unit, uma variável unit.
+ */
+static int builder_args_ok(FuncInfo *callee, ASTNode **args, int nargs) {
+    if (nargs != callee->nparams) return 0;
+    for (int i = 0; i < nargs; i++) {
+        if (contains_call(args[i])) return 0;
+        if (callee->params[i]->dataType == 1000 && args[i]->type != NODE_VAR) return 0;
+    }
+    return 1;
+}
+
+/*
+ * x := construtor(args)  ->  { t0 = expr0; t1 = expr1; x.c0 = t0; x.c1 = t1; }
+ * Os temporários garantem o resultado certo mesmo quando x aparece nos argumentos
+ * (ex: r := inverter(r)).
+ */
+static int gen_builder_assign(char *target, ASTNode *call) {
+    if (!call || call->type != NODE_FUNC_CALL) return 0;
+    FuncInfo *callee = find_func(call->strValue);
+    if (!callee || !callee->build_exprs) return 0;
+
+    ASTNode *args[MAX_PARAMS];
+    int nargs = collect_params(call->left, args, MAX_PARAMS);
+    if (!builder_args_ok(callee, args, nargs)) return 0;
+
+    UnitInfo *u = find_unit(callee->def->unitName);
+    for (int i = 0; i < nargs; i++) {
+        subst[i].name = callee->params[i]->strValue;
+        subst[i].arg = args[i];
+        subst[i].type = callee->params[i]->dataType;
+    }
+
+    fprintf(f, "{\n");
+    for (int k = 0; k < u->nfields; k++) {
+        nsubst = nargs;
+        fprintf(f, "%s %s__t = ", map_type(u->fields[k]->dataType), u->fields[k]->strValue);
+        gen_code(callee->build_exprs[k]);
+        fprintf(f, ";\n");
+        nsubst = 0;
+    }
+    for (int k = 0; k < u->nfields; k++) {
+        gen_unit_field(target, u->fields[k]->strValue);
+        fprintf(f, " = %s__t;\n", u->fields[k]->strValue);
+    }
+    fprintf(f, "}\n");
+    return 1;
+}
+
+/*
+ * ARRAYS DE TAMANHO CALCULADO
+ * 'int v := [n];' vira um ponteiro para um bloco do runtime (ezc_array_new),
+ * com o tamanho em 'v__n' (matrizes: 'm__r' x 'm__c'). O ponteiro e os
+ * tamanhos são declarados na entrada da função/main, para que um goto por
+ * cima da declaração continue válido; a memória é liberada na saída.
+ * Matrizes usam índice plano m[i * m__c + j] sobre o bloco contíguo.
+ * Parâmetros 'int[] v' / 'float[][] m' chegam com os mesmos nomes
+ * (ponteiro, v__n ou m__r/m__c) e são acessados do mesmo jeito.
+ */
+static ASTNode* dynamic_array(char *name) {
+    ASTNode *d = resolve_var(current_func, name);
+    return (d && ((d->type == NODE_DECL && d->left) || is_array_param(d))) ? d : NULL;
+}
+
+/* Tamanho de uma dimensão de array/matriz: 0 = elementos ou linhas, 1 = colunas */
+static void gen_dim(char *name, int which) {
+    ASTNode *d = resolve_var(current_func, name);
+    if (dynamic_array(name)) fprintf(f, "%s__%s", name, which ? "c" : (d->kind == KIND_MATRIX ? "r" : "n"));
+    else fprintf(f, "%d", which ? d->size2 : d->size1);
+}
+
+/* Primeiro elemento de uma vista: v + a, M[i] + a ou m + i * m__c + a */
+static void gen_slice_ptr(ASTNode *s) {
+    char *v = s->strValue;
+    fprintf(f, "(");
+    if (s->left && dynamic_array(v)) {
+        fprintf(f, "%s + (", v);
+        gen_index(s, s->left, 0);
+        fprintf(f, ") * %s__c", v);
+    } else if (s->left) {
+        fprintf(f, "%s[", v);
+        gen_index(s, s->left, 0);
+        fprintf(f, "]");
+    } else {
+        fprintf(f, "%s", v);
+    }
+    if (s->right && opt_bounds_check) {
+        /* --bounds-check: a vista inteira precisa caber no array (ver ezc_span) */
+        fprintf(f, " + ezc_span(");
+        gen_code(s->right);
+        fprintf(f, ", ");
+        gen_code(s->extra);
+        fprintf(f, ", ");
+        gen_dim(v, s->left != NULL);
+        fprintf(f, ", \"%s\", %d)", v, s->line);
+    } else if (s->right) {
+        fprintf(f, " + (");
+        gen_code(s->right);
+        fprintf(f, ")");
+    }
+    fprintf(f, ")");
+}
+
+/* Elementos de uma vista: b - a, ou as colunas da matriz para a linha inteira */
+static void gen_slice_len(ASTNode *s) {
+    if (!s->right) {
+        gen_dim(s->strValue, 1);
+        return;
+    }
+    fprintf(f, "((");
+    gen_code(s->extra);
+    fprintf(f, ") - (");
+    gen_code(s->right);
+    fprintf(f, "))");
+}
+
+/* Argumento de um parâmetro 'T[]' / 'T[][]': o primeiro elemento e os tamanhos */
+static void gen_array_arg(ASTNode *arg) {
+    if (arg->type == NODE_SLICE) {
+        gen_slice_ptr(arg);
+        fprintf(f, ", ");
+        gen_slice_len(arg);
+        return;
+    }
+    char *v = arg->strValue;
+    ASTNode *d = resolve_var(current_func, v);
+    fprintf(f, d->kind == KIND_MATRIX && !dynamic_array(v) ? "&%s[0][0], " : "%s, ", v);
+    gen_dim(v, 0);
+    if (d->kind == KIND_MATRIX) {
+        fprintf(f, ", ");
+        gen_dim(v, 1);
+    }
+}
+
+/* Parâmetro 'T[]' / 'T[][]' no cabeçalho da função */
+static void gen_array_param(ASTNode *p) {
+    fprintf(f, "%s *%s%s, ", map_type(p->dataType), p->passMode == PASS_RESTRICT ? "restrict " : "", p->strValue);
+    if (p->kind == KIND_MATRIX) fprintf(f, "int %s__r, int %s__c", p->strValue, p->strValue);
+    else fprintf(f, "int %s__n", p->strValue);
+}
+
+/* Elemento v[i] ou m[i][j] ('site' é o nó do acesso: nome e linha) */
+static void gen_element(ASTNode *site, ASTNode *i, ASTNode *j) {
+    char *name = site->strValue;
+    if (j && dynamic_array(name)) {
+        fprintf(f, "%s[(", name);
+        gen_index(site, i, 0);
+        fprintf(f, ") * %s__c + (", name);
+        gen_index(site, j, 1);
+        fprintf(f, ")]");
+        return;
+    }
+    fprintf(f, "%s[", name);
+    gen_index(site, i, 0);
+    fprintf(f, "]");
+    if (j) {
+        fprintf(f, "[");
+        gen_index(site, j, 1);
+        fprintf(f, "]");
+    }
+}
+
+/* Executa a declaração: calcula os tamanhos e aloca o bloco */
+static void gen_dynamic_alloc(ASTNode *d) {
+    char *v = d->strValue;
+    if (d->kind == KIND_MATRIX) {
+        fprintf(f, "%s__r = ", v);
+        gen_code(d->left);
+        fprintf(f, ";\n%s__c = ", v);
+        gen_code(d->right);
+        fprintf(f, ";\n%s = ezc_array_new(%s, %s__r, %s__c, sizeof *%s, \"%s\", %d);\n", v, v, v, v, v, v, d->line);
+    } else {
+        fprintf(f, "%s__n = ", v);
+        gen_code(d->left);
+        fprintf(f, ";\n%s = ezc_array_new(%s, %s__n, 1, sizeof *%s, \"%s\", %d);\n", v, v, v, v, v, d->line);
+    }
+}
+
+static int has_dynamic_arrays(ASTNode *node) {
+    if (!node || node->type == NODE_ACCESS) return 0;
+    if (node->type == NODE_DECL) return node->left != NULL;
+    return has_dynamic_arrays(node->left) || has_dynamic_arrays(node->right) || has_dynamic_arrays(node->extra);
+}
+
+static void gen_dynamic_array_vars(ASTNode *node) {
+    if (!node || node->type == NODE_ACCESS) return;
+    if (node->type == NODE_DECL) {
+        if (!node->left) return;
+        fprintf(f, "%s *%s = NULL;\n", map_type(node->dataType), node->strValue);
+        if (node->kind == KIND_MATRIX) fprintf(f, "int %s__r = 0, %s__c = 0;\n", node->strValue, node->strValue);
+        else fprintf(f, "int %s__n = 0;\n", node->strValue);
+        return;
+    }
+    gen_dynamic_array_vars(node->left);
+    gen_dynamic_array_vars(node->right);
+    gen_dynamic_array_vars(node->extra);
+}
+
+static void gen_free_dynamic_arrays(ASTNode *node) {
+    if (!node || node->type == NODE_ACCESS) return;
+    if (node->type == NODE_DECL) {
+        if (node->left) fprintf(f, "ezc_array_free(%s);\n", node->strValue);
+        return;
+    }
+    gen_free_dynamic_arrays(node->left);
+    gen_free_dynamic_arrays(node->right);
+    gen_free_dynamic_arrays(node->extra);
+}
+
+/*
+ * CHECAGEM DE LIMITES (--bounds-check)
+ * Todo índice de array com tamanho conhecido passa por ezc_idx, a menos que
+ * a análise de intervalos prove que ele cabe. Os intervalos vêm dos laços
+ * 'for': dentro do corpo, i vai do início ao fim do laço quando o corpo não
+ * altera i nem as variáveis dos limites. Valores são 'base + c', com base
+ * constante, variável ou tamanho de array, então 'for i := 0 to len(v) - 1'
+ * e 'int v := [n]; for i := 0 to n - 1' provam v[i] sem checagem.
+ * Índices i + c que o corpo executa em toda volta são checados uma vez,
+ * antes do laço, nos dois extremos (o erro aparece antes da primeira volta).
+ */
+typedef struct {
+    char base;   /* 0: constante; 'v': variável; 'n', 'r', 'c': tamanho do array; '?': desconhecido */
+    char *name;
+    long c;
+} Bound;
+
+typedef struct {
+    char *var;
+    Bound lo, hi;
+} LoopRange;
+
+#define MAX_LOOPS 64
+#define MAX_HOISTED 1024
+
+static LoopRange loops[MAX_LOOPS];      /* Laços 'for' abertos, do mais externo ao atual */
+static int nloops = 0;
+static ASTNode *hoisted[MAX_HOISTED];   /* Índices checados antes do laço */
+static int nhoisted = 0;
+static int checks_total = 0, checks_proven = 0, checks_hoisted = 0;
+
+static const Bound UNKNOWN_BOUND = { '?', NULL, 0 };
+
+/*
+ * Corpo de parallel for sendo gerado (ver PARALLEL FOR): o bloco de voltas
+ * é p__a..p__b, dentro dos limites do laço, e as variáveis de par_locals
+ * são locais do bloco.
+ */
+#define MAX_PAR_VARS 128
+
+static ASTNode *par_loop = NULL;
+static char *par_locals[MAX_PAR_VARS];
+static int npar_locals = 0;
+
+static int par_bound(char *name) {
+    return par_loop && (strcmp(name, "p__a") == 0 || strcmp(name, "p__b") == 0);
+}
+
+static int par_local(char *name) {
+    for (int k = 0; par_loop && k < npar_locals; k++) {
+        if (strcmp(par_locals[k], name) == 0) return 1;
+    }
+    return 0;
+}
+
+static int uses_node(ASTNode *node, NodeType type);
+static int uses_strings(ASTNode *node);
+static int expr_uses(ASTNode *node, char *name);
+
+/* Atribuição, leitura, 'for' ou passagem por ref que altera a variável escalar 'name' */
+static int assigns_var(ASTNode *node, char *name) {
+    if (!node || node->type == NODE_ACCESS) return 0;
+    if ((node->type == NODE_ASSIGN && !is_field_assign(node)) || node->type == NODE_FOR ||
+        (node->type == NODE_READ && node->kind == KIND_SCALAR)) {
+        if (strcmp(node->strValue, name) == 0) return 1;
+    }
+    return assigns_var(node->left, name) || assigns_var(node->right, name) || assigns_var(node->extra, name);
+}
+
+static int writes_var(ASTNode *node, char *name) {
+    return assigns_var(node, name) || passed_by_ref(node, name);
+}
+
+/* Inteiro que só o código da função atual (ou do main) pode alterar */
+static int private_var(char *name) {
+    if (par_bound(name)) return 1;
+    ASTNode *d = resolve_var(current_func, name);
+    if (!d || d->kind != KIND_SCALAR || d->dataType != TYPE_INT) return 0;
+    if (par_local(name)) return 1;
+    if (current_func) return is_local_name(current_func, name) && !scalar_ref_param(name);
+    GlobalInfo *g = find_global(d);
+    return g && g->home_main;
+}
+
+static int sized_by(ASTNode *d, char *n) {
+    return (d->left && d->left->type == NODE_VAR && strcmp(d->left->strValue, n) == 0) ||
+           (d->right && d->right->type == NODE_VAR && strcmp(d->right->strValue, n) == 0);
+}
+
+/*
+ * 'n' não muda depois da primeira declaração 'T v := [n]' do corpo, então
+ * todo array com tamanho n tem exatamente n elementos. Sem goto, que
+ * poderia voltar para antes dela.
+ */
+static int stable_size_var(char *n) {
+    ASTNode *body = current_func ? current_func->def->right : main_body;
+    if (!private_var(n) || uses_node(body, NODE_GOTO)) return 0;
+    ASTNode **items;
+    int count = flatten_seq(body && body->type == NODE_BLOCK ? body->left : body, &items);
+    int after = 0, ok = 1;
+    for (int k = 0; k < count && ok; k++) {
+        if (after && writes_var(items[k], n)) ok = 0;
+        if (items[k]->type == NODE_DECL && sized_by(items[k], n)) after = 1;
+    }
+    free(items);
+    return ok && after;
+}
+
+/* Tamanho da dimensão 'which' (0: elementos ou linhas, 1: colunas) como Bound */
+static Bound dim_bound(char *name, int which) {
+    ASTNode *d = resolve_var(current_func, name);
+    Bound b = UNKNOWN_BOUND;
+    if (!d || d->dataType == TYPE_ARRAY) return b; /* 'arr[]': tamanho desconhecido */
+    if (!dynamic_array(name)) {
+        int size = which ? d->size2 : d->size1;
+        if (size > 0) {
+            b.base = 0;
+            b.c = size;
+        }
+        return b;
+    }
+    ASTNode *e = (d->type == NODE_DECL) ? (which ? d->right : d->left) : NULL;
+    if (e && e->type == NODE_VAR && stable_size_var(e->strValue)) {
+        b.base = 'v';
+        b.name = e->strValue;
+        return b;
+    }
+    b.base = which ? 'c' : (d->kind == KIND_MATRIX ? 'r' : 'n');
+    b.name = name;
+    return b;
+}
+
+/* a + b (sign = 1) ou a - b (sign = -1); no máximo um lado simbólico, e nunca subtraído */
+static Bound bound_add(Bound a, Bound b, int sign) {
+    if (a.base == '?' || b.base == '?') return UNKNOWN_BOUND;
+    if (b.base != 0 && (sign < 0 || a.base != 0)) return UNKNOWN_BOUND;
+    if (b.base != 0) {
+        b.c += a.c;
+        return b;
+    }
+    a.c += sign * b.c;
+    return a;
+}
+
+/* len(v), rows(m) ou cols(m) de um array: o tamanho, que o corpo não muda */
+static int size_builtin(ASTNode *e) {
+    if (strcmp(e->strValue, "len") != 0 && strcmp(e->strValue, "rows") != 0 && strcmp(e->strValue, "cols") != 0) return 0;
+    return e->left->left->type == NODE_VAR && e->left->left->kind != KIND_SCALAR;
+}
+
+/* Intervalo [lo, hi] do valor inteiro de 'e' no ponto atual da geração */
+static void range_of(ASTNode *e, Bound *lo, Bound *hi) {
+    Bound alo, ahi, blo, bhi;
+    *lo = *hi = UNKNOWN_BOUND;
+    if (!e || e->dataType != TYPE_INT) return;
+    switch (e->type) {
+        case NODE_CONST:
+            lo->base = hi->base = 0;
+            lo->c = hi->c = e->intValue;
+            return;
+        case NODE_VAR:
+            if (par_bound(e->strValue)) {
+                /* p__a e p__b ficam entre os limites do parallel for */
+                range_of(par_loop->left->left, lo, &alo);
+                range_of(par_loop->left->right, &blo, hi);
+                return;
+            }
+            for (int k = (nloops < MAX_LOOPS ? nloops : MAX_LOOPS) - 1; k >= 0; k--) {
+                if (strcmp(loops[k].var, e->strValue) == 0) {
+                    *lo = loops[k].lo;
+                    *hi = loops[k].hi;
+                    return;
+                }
+            }
+            if (private_var(e->strValue)) {
+                lo->base = hi->base = 'v';
+                lo->name = hi->name = e->strValue;
+                lo->c = hi->c = 0;
+            }
+            return;
+        case NODE_BIN_OP:
+            if (strcmp(e->strValue, "+") != 0 && strcmp(e->strValue, "-") != 0) return;
+            range_of(e->left, &alo, &ahi);
+            range_of(e->right, &blo, &bhi);
+            if (e->strValue[0] == '+') {
+                *lo = bound_add(alo, blo, 1);
+                *hi = bound_add(ahi, bhi, 1);
+            } else {
+                *lo = bound_add(alo, bhi, -1);
+                *hi = bound_add(ahi, blo, -1);
+            }
+            return;
+        case NODE_BUILTIN:
+            if (!size_builtin(e)) return; /* len(s) de string, reduções */
+            *lo = *hi = dim_bound(e->left->left->strValue, strcmp(e->strValue, "cols") == 0);
+            return;
+        default:
+            return;
+    }
+}
+
+static int nonnegative(Bound b) {
+    return (b.base == 0 || b.base == 'n' || b.base == 'r' || b.base == 'c') && b.c >= 0;
+}
+
+/* hi < dim? */
+static int below(Bound hi, Bound dim) {
+    if (hi.base == '?' || dim.base == '?' || hi.base != dim.base) return 0;
+    if (hi.base != 0 && strcmp(hi.name, dim.name) != 0) return 0;
+    return hi.c < dim.c;
+}
+
+/* Limite de laço que não muda enquanto o corpo executa (só constantes, variáveis privadas e tamanhos) */
+static int invariant_expr(ASTNode *e, ASTNode *body) {
+    if (!e) return 1;
+    switch (e->type) {
+        case NODE_CONST:
+            return 1;
+        case NODE_VAR:
+            return private_var(e->strValue) && !writes_var(body, e->strValue);
+        case NODE_BIN_OP:
+            return invariant_expr(e->left, body) && invariant_expr(e->right, body);
+        case NODE_BUILTIN:
+            return size_builtin(e);
+        default:
+            return 0;
+    }
+}
+
+/* O corpo não altera a variável nem os limites do laço */
+static int counted_loop(ASTNode *loop) {
+    return private_var(loop->strValue) && !writes_var(loop->extra, loop->strValue) &&
+           !expr_uses(loop->left, loop->strValue) && !expr_uses(loop->right, loop->strValue) &&
+           invariant_expr(loop->left, loop->extra) && invariant_expr(loop->right, loop->extra);
+}
+
+/* i + c, com i a variável do laço: devolve 1 e c */
+static int affine_in(ASTNode *e, char *var, long *c) {
+    if (e->type == NODE_VAR && strcmp(e->strValue, var) == 0) {
+        *c = 0;
+        return 1;
+    }
+    if (e->type != NODE_BIN_OP || (strcmp(e->strValue, "+") != 0 && strcmp(e->strValue, "-") != 0)) return 0;
+    ASTNode *v = e->left, *k = e->right;
+    if (e->strValue[0] == '+' && v->type == NODE_CONST) {
+        v = e->right;
+        k = e->left;
+    }
+    if (v->type != NODE_VAR || strcmp(v->strValue, var) != 0 || k->type != NODE_CONST || k->dataType != TYPE_INT) return 0;
+    *c = e->strValue[0] == '+' ? k->intValue : -k->intValue;
+    return 1;
+}
+
+static int is_hoisted(ASTNode *e) {
+    for (int k = 0; k < nhoisted; k++) {
+        if (hoisted[k] == e) return 1;
+    }
+    return 0;
+}
+
+/* Índice já provado dentro da dimensão? */
+static int index_proven(ASTNode *site, ASTNode *e, int which) {
+    Bound lo, hi;
+    range_of(e, &lo, &hi);
+    return nonnegative(lo) && below(hi, dim_bound(site->strValue, which));
+}
+
+/* Checagens dos extremos do laço para os índices i + c de 'site' */
+static void hoist_site(ASTNode *loop, ASTNode *site, ASTNode **idx, int nidx, int *opened) {
+    for (int w = 0; w < nidx; w++) {
+        long c;
+        if (!idx[w] || nhoisted == MAX_HOISTED) continue;
+        if (dim_bound(site->strValue, w).base == '?') continue;
+        if (!affine_in(idx[w], loop->strValue, &c) || index_proven(site, idx[w], w)) continue;
+        hoisted[nhoisted++] = idx[w];
+        if (!*opened) {
+            fprintf(f, "if (");
+            gen_code(loop->left);
+            fprintf(f, " <= ");
+            gen_code(loop->right);
+            fprintf(f, ") {\n");
+            *opened = 1;
+        }
+        for (int end = 0; end < 2; end++) {
+            fprintf(f, "ezc_idx(");
+            gen_code(end ? loop->right : loop->left);
+            if (c) fprintf(f, " + %ld", c);
+            fprintf(f, ", ");
+            gen_dim(site->strValue, w);
+            fprintf(f, ", \"%s\", %d);\n", site->strValue, site->line);
+        }
+    }
+}
+
+/*
+ * Percorre as partes do corpo que executam em toda volta: fora de if/while/
+ * for internos e do lado direito de && e ||. (O chamador garante que o corpo
+ * não tem return, goto nem rótulo.)
+ */
+static void hoist_scan(ASTNode *loop, ASTNode *node, int *opened) {
+    if (!node || node->type == NODE_ACCESS) return;
+    switch (node->type) {
+        case NODE_IF:
+        case NODE_WHILE:
+            hoist_scan(loop, node->left, opened); /* A condição sempre executa */
+            return;
+        case NODE_FOR:
+            hoist_scan(loop, node->left, opened);
+            hoist_scan(loop, node->right, opened);
+            return;
+        case NODE_BIN_OP:
+            if (strcmp(node->strValue, "&&") == 0 || strcmp(node->strValue, "||") == 0) {
+                hoist_scan(loop, node->left, opened);
+                return;
+            }
+            break;
+        case NODE_ARRAY_ACCESS:
+        case NODE_ASSIGN_IDX: {
+            ASTNode *idx[2] = { node->left, node->right };
+            hoist_site(loop, node, idx, 2, opened);
+            break;
+        }
+        case NODE_READ:
+            if (node->kind != KIND_SCALAR) {
+                ASTNode *idx[2] = { node->left, node->kind == KIND_MATRIX ? node->right : NULL };
+                hoist_site(loop, node, idx, 2, opened);
+            }
+            break;
+        default:
+            break;
+    }
+    hoist_scan(loop, node->left, opened);
+    hoist_scan(loop, node->right, opened);
+    hoist_scan(loop, node->extra, opened);
+}
+
+/* Entrada de um 'for': registra o intervalo da variável e checa antes os índices que dá */
+static void enter_loop(ASTNode *loop) {
+    LoopRange r = { loop->strValue, UNKNOWN_BOUND, UNKNOWN_BOUND };
+    int counted = counted_loop(loop);
+    if (counted) {
+        Bound unused;
+        range_of(loop->left, &r.lo, &unused);
+        range_of(loop->right, &unused, &r.hi);
+    }
+    if (nloops < MAX_LOOPS) loops[nloops] = r;
+    nloops++;
+
+    ASTNode *body = loop->extra;
+    if (opt_bounds_check && counted && !contains_call(loop->left) && !contains_call(loop->right) && !uses_node(body, NODE_RETURN) &&
+        !uses_node(body, NODE_GOTO) && !uses_node(body, NODE_LABEL)) {
+        int opened = 0;
+        hoist_scan(loop, body, &opened);
+        if (opened) fprintf(f, "}\n");
+    }
+}
+
+static void leave_loop(void) {
+    nloops--;
+}
+
+/* Índice 'e' da dimensão 'which' do acesso 'site' (com ezc_idx se não for provado) */
+static void gen_index(ASTNode *site, ASTNode *e, int which) {
+    if (!opt_bounds_check || dim_bound(site->strValue, which).base == '?') {
+        gen_code(e);
+        return;
+    }
+    checks_total++;
+    if (is_hoisted(e)) {
+        checks_hoisted++;
+        gen_code(e);
+        return;
+    }
+    if (index_proven(site, e, which)) {
+        checks_proven++;
+        gen_code(e);
+        return;
+    }
+    fprintf(f, "ezc_idx(");
+    gen_code(e);
+    fprintf(f, ", ");
+    gen_dim(site->strValue, which);
+    fprintf(f, ", \"%s\", %d)", site->strValue, site->line);
+}
+
+/*
+ * ARITMÉTICA CONFERIDA (--checked-arith)
+ * Com a opção, + - * / e ^ inteiros viram chamadas ezc_add, ezc_sub, ...
+ * que param o programa com a linha do erro em vez de estourar em silêncio
+ * (ou dividir por zero). A operação fica como está quando o intervalo dos
+ * operandos (constantes e variáveis de 'for', os mesmos intervalos de
+ * --bounds-check) prova que o resultado cabe em int.
+ */
+static int arith_total = 0, arith_proven = 0;
+
+/* Valores possíveis de um Bound: tamanhos de array estão em [0, INT_MAX], variáveis em todo int */
+static void bound_span(Bound b, long long *lo, long long *hi) {
+    if (b.base == 0) {
+        *lo = *hi = b.c;
+    } else if (b.base == 'n' || b.base == 'r' || b.base == 'c') {
+        *lo = b.c;
+        *hi = (long long) INT_MAX + b.c;
+    } else {
+        *lo = (long long) INT_MIN + b.c;
+        *hi = (long long) INT_MAX + b.c;
+    }
+}
+
+static long long min4(long long a, long long b, long long c, long long d) {
+    long long m = a < b ? a : b;
+    if (c < m) m = c;
+    return d < m ? d : m;
+}
+
+static long long max4(long long a, long long b, long long c, long long d) {
+    long long m = a > b ? a : b;
+    if (c > m) m = c;
+    return d > m ? d : m;
+}
+
+/* Intervalo numérico [lo, hi] do valor inteiro de 'e' (o resultado de toda operação cabe em int) */
+static void int_range(ASTNode *e, long long *lo, long long *hi) {
+    long long alo, ahi, blo, bhi, unused;
+    *lo = INT_MIN;
+    *hi = INT_MAX;
+    if (!e || e->dataType != TYPE_INT) return;
+    switch (e->type) {
+        case NODE_CONST:
+            *lo = *hi = e->intValue;
+            return;
+        case NODE_VAR:
+            for (int k = (nloops < MAX_LOOPS ? nloops : MAX_LOOPS) - 1; k >= 0; k--) {
+                if (strcmp(loops[k].var, e->strValue) == 0) {
+                    bound_span(loops[k].lo, lo, &unused);
+                    bound_span(loops[k].hi, &unused, hi);
+                    break;
+                }
+            }
+            break;
+        case NODE_BUILTIN:
+            /* Tamanhos, contagens e índices não são negativos */
+            if (strcmp(e->strValue, "len") == 0 || strcmp(e->strValue, "rows") == 0 || strcmp(e->strValue, "cols") == 0 ||
+                strcmp(e->strValue, "count") == 0 || strncmp(e->strValue, "arg", 3) == 0) *lo = 0;
+            return;
+        case NODE_BIN_OP:
+            int_range(e->left, &alo, &ahi);
+            int_range(e->right, &blo, &bhi);
+            switch (e->strValue[0]) {
+                case '+':
+                    *lo = alo + blo;
+                    *hi = ahi + bhi;
+                    break;
+                case '-':
+                    *lo = alo - bhi;
+                    *hi = ahi - blo;
+                    break;
+                case '*':
+                    *lo = min4(alo * blo, alo * bhi, ahi * blo, ahi * bhi);
+                    *hi = max4(alo * blo, alo * bhi, ahi * blo, ahi * bhi);
+                    break;
+                case '/':
+                    if (blo > 0 || bhi < 0) {
+                        *lo = min4(alo / blo, alo / bhi, ahi / blo, ahi / bhi);
+                        *hi = max4(alo / blo, alo / bhi, ahi / blo, ahi / bhi);
+                    } else {
+                        *hi = -alo > ahi ? -alo : ahi; /* |a / b| <= |a| */
+                        *lo = -*hi;
+                    }
+                    break;
+                default:
+                    return;
+            }
+            break;
+        default:
+            return;
+    }
+    if (*lo < INT_MIN) *lo = INT_MIN;
+    if (*hi > INT_MAX) *hi = INT_MAX;
+}
+
+/* Operação inteira que nunca estoura nem divide por zero? */
+static int arith_proven_safe(ASTNode *e) {
+    long long lo, hi, alo, ahi, blo, bhi;
+    if (e->strValue[0] == '^') return 0;
+    int_range(e->left, &alo, &ahi);
+    int_range(e->right, &blo, &bhi);
+    if (e->strValue[0] == '/') return (blo > 0 || bhi < 0) && (alo > INT_MIN || blo > -1 || bhi < -1);
+    switch (e->strValue[0]) {
+        case '+':
+            lo = alo + blo;
+            hi = ahi + bhi;
+            break;
+        case '-':
+            lo = alo - bhi;
+            hi = ahi - blo;
+            break;
+        default:
+            lo = min4(alo * blo, alo * bhi, ahi * blo, ahi * bhi);
+            hi = max4(alo * blo, alo * bhi, ahi * blo, ahi * bhi);
+            break;
+    }
+    return lo >= INT_MIN && hi <= INT_MAX;
+}
+
+/* + - * / ^ entre inteiros que a opção confere? */
+static int checked_op(ASTNode *e) {
+    if (!opt_checked_arith || e->dataType != TYPE_INT) return 0;
+    if (e->left->dataType != TYPE_INT || e->right->dataType != TYPE_INT) return 0;
+    return strlen(e->strValue) == 1 && strchr("+-*/^", e->strValue[0]);
+}
+
+static const char* checked_fn(ASTNode *e) {
+    static const char *ops = "+-*/^";
+    static const char *fns[] = { "ezc_add", "ezc_sub", "ezc_mul", "ezc_div", "ezc_pow" };
+    return fns[strchr(ops, e->strValue[0]) - ops];
+}
+
+/* ezc_add(A, B, linha) e afins; (A op B) quando a operação é provada segura */
+static void gen_checked_op(ASTNode *e) {
+    arith_total++;
+    if (arith_proven_safe(e)) {
+        arith_proven++;
+        fprintf(f, "(");
+        gen_code(e->left);
+        fprintf(f, " %s ", e->strValue);
+        gen_code(e->right);
+        fprintf(f, ")");
+        return;
+    }
+    fprintf(f, "%s(", checked_fn(e));
+    gen_code(e->left);
+    fprintf(f, ", ");
+    gen_code(e->right);
+    fprintf(f, ", %d)", e->line);
+}
+
+/*
+ * ARRAYS INTEIROS
+ * 'c := a + b * 2;' vira um único laço sobre a memória contígua dos arrays
+ * (a matriz é linhas x colunas elementos seguidos). Cada array tem um
+ * ponteiro 'v__p' e cada operando escalar é calculado uma vez, antes do
+ * laço, em 'e__k'. Se os arrays não podem se sobrepor em parte (declarados,
+ * ou parâmetros restrict), os ponteiros são restrict e o laço leva
+ * '#pragma omp simd' (ativo com gcc -fopenmp-simd).
+ */
+#define MAX_OPERANDS 32
+
+typedef struct {
+    char *arrays[MAX_OPERANDS];   /* O destino é o primeiro */
+    int narrays;
+    ASTNode *scalars[MAX_OPERANDS];
+    int nscalars;
+} Elementwise;
+
+static void elementwise_fail(ASTNode *e) {
+    printf("ERRO (Linha %d): Expressao de array com mais de %d operandos.\n", e->line, MAX_OPERANDS);
+    exit(1);
+}
+
+static void add_array_operand(Elementwise *w, char *name, ASTNode *e) {
+    for (int k = 0; k < w->narrays; k++) {
+        if (strcmp(w->arrays[k], name) == 0) return;
+    }
+    if (w->narrays == MAX_OPERANDS) elementwise_fail(e);
+    w->arrays[w->narrays++] = name;
+}
+
+static void collect_operands(ASTNode *e, Elementwise *w) {
+    if (e->type == NODE_VAR && e->kind != KIND_SCALAR) {
+        add_array_operand(w, e->strValue, e);
+    } else if (e->kind != KIND_SCALAR) {
+        collect_operands(e->left, w);
+        if (e->right) collect_operands(e->right, w);
+    } else if (e->type != NODE_CONST) {
+        if (w->nscalars == MAX_OPERANDS) elementwise_fail(e);
+        w->scalars[w->nscalars++] = e;
+    }
+}
+
+/* Valor do elemento k__ */
+static void gen_elementwise(ASTNode *e, Elementwise *w) {
+    if (e->type == NODE_VAR && e->kind != KIND_SCALAR) {
+        fprintf(f, "%s__p[k__]", e->strValue);
+        return;
+    }
+    if (e->kind == KIND_SCALAR) {
+        for (int k = 0; k < w->nscalars; k++) {
+            if (w->scalars[k] == e) {
+                fprintf(f, "e__%d", k);
+                return;
+            }
+        }
+        gen_code(e); /* Constante */
+        return;
+    }
+    if (e->type == NODE_CAST) {
+        fprintf(f, "(%s)(", map_type(e->dataType));
+        gen_elementwise(e->left, w);
+        fprintf(f, ")");
+        return;
+    }
+    if (checked_op(e)) {
+        arith_total++;
+        fprintf(f, "%s(", checked_fn(e));
+        gen_elementwise(e->left, w);
+        fprintf(f, ", ");
+        gen_elementwise(e->right, w);
+        fprintf(f, ", %d)", e->line);
+        return;
+    }
+    fprintf(f, "(");
+    gen_elementwise(e->left, w);
+    fprintf(f, " %s ", e->strValue);
+    gen_elementwise(e->right, w);
+    fprintf(f, ")");
+}
+
+static int same_bound(Bound a, Bound b) {
+    if (a.base == '?' || a.base != b.base || a.c != b.c) return 0;
+    return a.base == 0 || strcmp(a.name, b.name) == 0;
+}
+
+static void gen_array_assign(ASTNode *node) {
+    Elementwise w = { { node->strValue }, 1, { NULL }, 0 };
+    collect_operands(node->left, &w);
+
+    /* Parâmetro sem restrict pode ser parte de outro array: ordem do laço importa */
+    int disjoint = 1;
+    for (int k = 0; k < w.narrays && w.narrays > 1; k++) {
+        ASTNode *d = resolve_var(current_func, w.arrays[k]);
+        if (is_array_param(d) && d->passMode != PASS_RESTRICT) disjoint = 0;
+    }
+    const char *restrict_kw = disjoint ? "restrict " : "";
+
+    ASTNode *dst = resolve_var(current_func, node->strValue);
+    int dims = dst->kind == KIND_MATRIX ? 2 : 1;
+    fprintf(f, "{\n");
+    for (int k = 0; k < w.narrays; k++) {
+        char *v = w.arrays[k];
+        ASTNode *d = resolve_var(current_func, v);
+        fprintf(f, "%s%s *%s%s__p = ", k ? "const " : "", map_type(d->dataType), restrict_kw, v);
+        fprintf(f, d->kind == KIND_MATRIX && !dynamic_array(v) ? "&%s[0][0];\n" : "%s;\n", v);
+    }
+    for (int k = 0; k < w.nscalars; k++) {
+        fprintf(f, "%s e__%d = ", map_type(w.scalars[k]->dataType), k);
+        gen_code(w.scalars[k]);
+        fprintf(f, ";\n");
+    }
+    /* Tamanhos calculados: conferidos ao executar, exceto se provados iguais */
+    for (int k = 1; k < w.narrays; k++) {
+        for (int which = 0; which < dims; which++) {
+            if (same_bound(dim_bound(w.arrays[k], which), dim_bound(node->strValue, which))) continue;
+            if (!dynamic_array(w.arrays[k]) && !dynamic_array(node->strValue)) continue;
+            fprintf(f, "if (");
+            gen_dim(w.arrays[k], which);
+            fprintf(f, " != ");
+            gen_dim(node->strValue, which);
+            fprintf(f, ") ezc_fail(\"ERRO (Linha %d): '%s' e '%s' tem tamanhos diferentes.\\n\");\n",
+                    node->line, w.arrays[k], node->strValue);
+        }
+    }
+    if (disjoint) fprintf(f, "#pragma omp simd\n");
+    fprintf(f, "for (int k__ = 0; k__ < ");
+    gen_dim(node->strValue, 0);
+    if (dims == 2) {
+        fprintf(f, " * ");
+        gen_dim(node->strValue, 1);
+    }
+    fprintf(f, "; k__++) {\n%s__p[k__] = ", node->strValue);
+    gen_elementwise(node->left, &w);
+    fprintf(f, ";\n}\n}\n");
+}
+
+/*
+ * REDUÇÕES
+ * sum, min, max, argmin, argmax, dot e count chamam os núcleos do runtime
+ * (ezc_sum_i, ezc_count_lt_f, ...) com o primeiro elemento e o total de
+ * elementos: a matriz inteira é vista como plana (linhas x colunas) e a
+ * vista é só o trecho. Somas e produtos de int voltam de long long para
+ * int (conferidos com --checked-arith).
+ */
+static void gen_flat_array(ASTNode *arg) {
+    if (arg->type == NODE_VAR && arg->kind == KIND_MATRIX) {
+        char *v = arg->strValue;
+        fprintf(f, dynamic_array(v) ? "%s, " : "&%s[0][0], ", v);
+        gen_dim(v, 0);
+        fprintf(f, " * ");
+        gen_dim(v, 1);
+        return;
+    }
+    gen_array_arg(arg);
+}
+
+static void gen_reduction(ASTNode *node) {
+    static const char *cmps[] = { "==", "<", "<=", ">", ">=" };
+    static const char *cmp_names[] = { "eq", "lt", "le", "gt", "ge" };
+    ASTNode *args[2];
+    int n = collect_params(node->left, args, 2);
+    char *name = node->strValue;
+
+    if (strcmp(name, "count") == 0) {
+        ASTNode *cmp = args[0];
+        int k = 0;
+        while (strcmp(cmps[k], cmp->strValue) != 0) k++;
+        fprintf(f, "ezc_count_%s_%c(", cmp_names[k], cmp->left->dataType == TYPE_FLOAT ? 'f' : 'i');
+        gen_flat_array(cmp->left);
+        fprintf(f, ", ");
+        gen_code(cmp->right);
+        fprintf(f, ")");
+        return;
+    }
+
+    char t = args[0]->dataType == TYPE_FLOAT ? 'f' : 'i';
+    int wide = t == 'i' && (strcmp(name, "sum") == 0 || strcmp(name, "dot") == 0);
+    if (wide) fprintf(f, opt_checked_arith ? "ezc_narrow(" : "(int) ");
+    fprintf(f, "ezc_%s_%c(", name, t);
+    gen_flat_array(args[0]);
+    if (n == 2) {
+        fprintf(f, ", ");
+        gen_flat_array(args[1]);
+    }
+    if (strcmp(name, "sum") != 0) fprintf(f, ", %d", node->line);
+    fprintf(f, ")");
+    if (wide && opt_checked_arith) fprintf(f, ", %d)", node->line);
+}
+
+static int uses_reduction(ASTNode *node) {
+    if (!node) return 0;
+    if (is_reduction(node)) return 1;
+    return uses_reduction(node->left) || uses_reduction(node->right) || uses_reduction(node->extra);
+}
+
+/* Algum erro em tempo de execução (ezc_fail) pode ser gerado: checagens, arrays
+   dinâmicos e tamanhos de arrays recebidos por parâmetro, conferidos ao executar,
+   reduções (min/max de array vazio), dimensões de read/echo de array inteiro,
+   arquivos binários e operações de matriz */
+static int needs_fail_runtime(ASTNode *root) {
+    if (opt_bounds_check || opt_checked_arith || has_dynamic_arrays(root) || uses_reduction(root)) return 1;
+    if (uses_node(root, NODE_READ_ALL) || uses_node(root, NODE_PRINT_ALL)) return 1;
+    if (uses_node(root, NODE_MAP_OPEN) || uses_node(root, NODE_LOAD) || uses_node(root, NODE_STORE)) return 1;
+    if (uses_node(root, NODE_MATRIX_OP)) return 1;
+    for (FuncInfo *fn = func_list; fn; fn = fn->next) {
+        for (int i = 0; i < fn->nparams; i++) {
+            if (is_array_param(fn->params[i])) return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * OPERAÇÕES DE MATRIZ
+ * matmul/transpose/fill/copy chamam o núcleo do runtime com o primeiro
+ * elemento e o passo da linha de cada matriz. As dimensões são calculadas
+ * uma vez em 'd__k' e conferidas com os tamanhos (ver MatrixOp), exceto
+ * quando a análise já provou: dimensão constante contra tamanho constante.
+ */
+static void gen_matrix_ptr(char *v) {
+    fprintf(f, dynamic_array(v) ? "%s, " : "&%s[0][0], ", v);
+    gen_dim(v, 1);
+}
+
+static void gen_matrix_op(ASTNode *node) {
+    const MatrixOp *op = find_matrix_op(node->strValue);
+    ASTNode *args[MAX_PARAMS];
+    int n = collect_params(node->left, args, MAX_PARAMS);
+    int fixed = op->nmats + op->has_value;
+    int whole = n == fixed;
+
+    fprintf(f, "{\n");
+    for (int d = 0; d < op->ndims; d++) {
+        const int *first = op->limits[d][0];
+        fprintf(f, "int d__%d = ", d);
+        if (whole) gen_dim(args[first[0]]->strValue, first[1]);
+        else gen_code(args[fixed + d]);
+        fprintf(f, ";\n");
+    }
+
+    /* Sem dimensões os tamanhos são iguais; com elas, cada dimensão cabe nos tamanhos */
+    int opened = 0;
+    for (int d = 0; d < op->ndims; d++) {
+        ASTNode *e = whole ? NULL : args[fixed + d];
+        for (int k = whole; k < 2; k++) {
+            const int *lim = op->limits[d][k];
+            if (lim[0] < 0) break;
+            char *v = args[lim[0]]->strValue;
+            if (!dynamic_array(v) && (whole ? !dynamic_array(args[op->limits[d][0][0]]->strValue) : e->type == NODE_CONST)) continue;
+            fprintf(f, opened ? " || " : "if (");
+            if (!whole && e->type != NODE_CONST) fprintf(f, "d__%d < 0 || ", d);
+            fprintf(f, "d__%d %s ", d, whole ? "!=" : ">");
+            gen_dim(v, lim[1]);
+            opened = 1;
+        }
+    }
+    if (opened) {
+        fprintf(f, ") ezc_fail(\"ERRO (Linha %d): Dimensoes incompativeis em %s.\\n\");\n",
+                node->line, node->strValue);
+    }
+
+    fprintf(f, "ezc_%s_%c(", node->strValue, node->dataType == TYPE_FLOAT ? 'f' : 'i');
+    for (int i = 0; i < op->nmats; i++) {
+        if (i) fprintf(f, ", ");
+        gen_matrix_ptr(args[i]->strValue);
+    }
+    if (op->has_value) {
+        fprintf(f, ", ");
+        gen_code(args[op->nmats]);
+    }
+    for (int d = 0; d < op->ndims; d++) fprintf(f, ", d__%d", d);
+    fprintf(f, ");\n}\n");
+}
+
+/*
+ * LAÇOS ANINHADOS
+ * Um 'for' cujo corpo é só outro 'for' (sem laços dentro), com os limites
+ * de dentro sem a variável de fora, é um ninho retangular. Quando todo
+ * índice do corpo é afim (a*i + b*j + c + termo invariante), o teste de
+ * dependência decide se a ordem das voltas pode mudar: nenhum elemento
+ * pode ser tocado em voltas que avançam num laço e recuam no outro. Então
+ * os laços são trocados para que o de dentro ande pelas colunas (memória
+ * contígua das matrizes) e, se ainda sobrar matriz andada pelas linhas
+ * (b[j][i] := a[i][j]), o ninho é percorrido em blocos NEST_TILE x NEST_TILE.
+ * As variáveis dos dois laços não podem ser lidas fora deles: o valor final
+ * muda com a ordem quando um dos intervalos é vazio.
+ */
+#define NEST_TILE 32
+#define MAX_NEST_REFS 64
+
+typedef struct {
+    long co, ci, c;   /* Coeficientes da variável de fora, da de dentro e a constante */
+    ASTNode *rest;    /* Termo invariante somado (NULL: nenhum) */
+} Affine;
+
+typedef struct {
+    ASTNode *site;    /* NODE_ARRAY_ACCESS (leitura) ou NODE_ASSIGN_IDX (escrita) */
+    int write;
+} NestRef;
+
+typedef struct {
+    ASTNode *loop;    /* 'for' de fora */
+    char *outer, *inner;
+    char *sum;        /* Acumulador int (s := s + e), a única escalar escrita */
+    int nsums;
+    NestRef refs[MAX_NEST_REFS];
+    int nrefs;
+} Nest;
+
+/* Distância entre as voltas de duas referências numa variável: livre ou fixa */
+typedef struct {
+    int fixed;
+    long d;
+} Dist;
+
+static ASTNode* only_stmt(ASTNode *s) {
+    while (s && s->type == NODE_BLOCK) s = s->left;
+    return s && s->type != NODE_SEQ ? s : NULL;
+}
+
+static int same_expr(ASTNode *a, ASTNode *b) {
+    if (!a || !b) return a == b;
+    if (a->type != b->type || a->intValue != b->intValue) return 0;
+    if (a->strValue != b->strValue && (!a->strValue || !b->strValue || strcmp(a->strValue, b->strValue) != 0)) return 0;
+    return same_expr(a->left, b->left) && same_expr(a->right, b->right) && same_expr(a->extra, b->extra);
+}
+
+static int count_uses(ASTNode *node, char *name) {
+    if (!node || node->type == NODE_ACCESS) return 0;
+    int here = node->type == NODE_VAR && strcmp(node->strValue, name) == 0;
+    return here + count_uses(node->left, name) + count_uses(node->right, name) + count_uses(node->extra, name);
+}
+
+static long gcd_long(long a, long b) {
+    if (a < 0) a = -a;
+    if (b < 0) b = -b;
+    while (b) {
+        long t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/* Índice inteiro como forma afim nas variáveis do ninho */
+static int nest_affine(ASTNode *e, Nest *n, Affine *a) {
+    Affine l, r;
+    memset(a, 0, sizeof *a);
+    if (!e || e->dataType != TYPE_INT) return 0;
+    if (e->type == NODE_CONST) {
+        a->c = e->intValue;
+        return 1;
+    }
+    if (e->type == NODE_VAR && strcmp(e->strValue, n->outer) == 0) {
+        a->co = 1;
+        return 1;
+    }
+    if (e->type == NODE_VAR && strcmp(e->strValue, n->inner) == 0) {
+        a->ci = 1;
+        return 1;
+    }
+    if (invariant_expr(e, n->loop)) {
+        a->rest = e;
+        return 1;
+    }
+    if (e->type != NODE_BIN_OP || e->strValue[1] || !strchr("+-*", e->strValue[0])) return 0;
+    if (!nest_affine(e->left, n, &l) || !nest_affine(e->right, n, &r)) return 0;
+    if (e->strValue[0] == '*') {
+        if (!r.co && !r.ci && !r.rest) {
+            Affine t = l;
+            l = r;
+            r = t;
+        }
+        if (l.co || l.ci || l.rest || r.rest) return 0; /* Só constante * forma sem termo invariante */
+        a->co = l.c * r.co;
+        a->ci = l.c * r.ci;
+        a->c = l.c * r.c;
+        return 1;
+    }
+    long s = e->strValue[0] == '+' ? 1 : -1;
+    if (r.rest && (l.rest || s < 0)) return 0;
+    a->co = l.co + s * r.co;
+    a->ci = l.ci + s * r.ci;
+    a->c = l.c + s * r.c;
+    a->rest = l.rest ? l.rest : r.rest;
+    return 1;
+}
+
+static int pin_dist(Dist *d, long v) {
+    if (d->fixed) return d->d == v;
+    d->fixed = 1;
+    d->d = v;
+    return 1;
+}
+
+/*
+ * x e y (mesmo array) podem tocar o mesmo elemento em voltas cuja ordem a
+ * troca inverte? Cada dimensão dá uma equação nas distâncias dO e dI entre
+ * as voltas; sem solução inteira, as referências são independentes.
+ */
+static int nest_conflict(Nest *n, NestRef *x, NestRef *y) {
+    ASTNode *ix[2] = { x->site->left, x->site->right }, *iy[2] = { y->site->left, y->site->right };
+    Dist o = { 0, 0 }, i = { 0, 0 };
+    Affine eq = { 0, 0, 0, NULL };
+    int coupled = 0;
+    for (int d = 0; d < 2 && ix[d] && iy[d]; d++) {
+        Affine a, b;
+        if (!nest_affine(ix[d], n, &a) || !nest_affine(iy[d], n, &b)) return 1;
+        if (!same_expr(a.rest, b.rest) || a.co != b.co || a.ci != b.ci) continue; /* Sem informação */
+        long k = a.c - b.c; /* co * dO + ci * dI = k */
+        if (!a.co && !a.ci) {
+            if (k) return 0;
+        } else if (!a.ci) {
+            if (k % a.co || !pin_dist(&o, k / a.co)) return 0;
+        } else if (!a.co) {
+            if (k % a.ci || !pin_dist(&i, k / a.ci)) return 0;
+        } else {
+            if (k % gcd_long(a.co, a.ci)) return 0;
+            eq = a;
+            eq.c = k;
+            coupled = 1;
+        }
+    }
+    if (coupled) {
+        if (o.fixed && i.fixed && eq.co * o.d + eq.ci * i.d != eq.c) return 0;
+        if (o.fixed && !i.fixed && ((eq.c - eq.co * o.d) % eq.ci || !pin_dist(&i, (eq.c - eq.co * o.d) / eq.ci))) return 0;
+        if (i.fixed && !o.fixed && ((eq.c - eq.ci * i.d) % eq.co || !pin_dist(&o, (eq.c - eq.ci * i.d) / eq.co))) return 0;
+        if (!o.fixed && !i.fixed && eq.c == 0 && (eq.co > 0) != (eq.ci > 0)) return 0; /* dO e dI com o mesmo sinal */
+    }
+    if ((o.fixed && o.d == 0) || (i.fixed && i.d == 0)) return 0;
+    if (o.fixed && i.fixed) return (o.d > 0) != (i.d > 0);
+    return 1;
+}
+
+static int nest_expr_ok(ASTNode *e, Nest *n);
+
+static int nest_ref(ASTNode *site, int write, Nest *n) {
+    ASTNode *d = resolve_var(current_func, site->strValue);
+    if (!d || (d->dataType != TYPE_INT && d->dataType != TYPE_FLOAT && d->dataType != TYPE_CHAR)) return 0;
+    if (n->nrefs == MAX_NEST_REFS) return 0;
+    Affine unused;
+    if (!nest_affine(site->left, n, &unused) || (site->right && !nest_affine(site->right, n, &unused))) return 0;
+    n->refs[n->nrefs].site = site;
+    n->refs[n->nrefs++].write = write;
+    return 1;
+}
+
+/* Expressão sem chamadas nem E/S; os acessos a arrays vão para a lista do ninho */
+static int nest_expr_ok(ASTNode *e, Nest *n) {
+    if (!e) return 1;
+    switch (e->type) {
+        case NODE_CONST:
+            return 1;
+        case NODE_VAR:
+            return e->kind == KIND_SCALAR;
+        case NODE_BIN_OP:
+        case NODE_CAST:
+            return nest_expr_ok(e->left, n) && nest_expr_ok(e->right, n);
+        case NODE_ARRAY_ACCESS:
+            return nest_ref(e, 0, n);
+        case NODE_BUILTIN:
+            return size_builtin(e);
+        default:
+            return 0;
+    }
+}
+
+/* s := s + e / s := e + s / s := s - e com s int: a soma não depende da ordem */
+static int nest_sum_ok(ASTNode *s, Nest *n) {
+    ASTNode *d = resolve_var(current_func, s->strValue), *e = s->left;
+    if (opt_checked_arith || !d || d->kind != KIND_SCALAR || d->dataType != TYPE_INT) return 0;
+    if (n->sum && strcmp(n->sum, s->strValue) != 0) return 0;
+    if (!e || e->type != NODE_BIN_OP || (strcmp(e->strValue, "+") != 0 && strcmp(e->strValue, "-") != 0)) return 0;
+    ASTNode *acc = e->left, *term = e->right;
+    if (e->strValue[0] == '+' && !(acc->type == NODE_VAR && strcmp(acc->strValue, s->strValue) == 0)) {
+        acc = e->right;
+        term = e->left;
+    }
+    if (acc->type != NODE_VAR || strcmp(acc->strValue, s->strValue) != 0) return 0;
+    n->sum = s->strValue;
+    n->nsums++;
+    return nest_expr_ok(term, n);
+}
+
+static int nest_stmt_ok(ASTNode *s, Nest *n) {
+    if (!s) return 1;
+    switch (s->type) {
+        case NODE_SEQ:
+            return nest_stmt_ok(s->left, n) && nest_stmt_ok(s->right, n);
+        case NODE_BLOCK:
+            return nest_stmt_ok(s->left, n);
+        case NODE_IF:
+            return nest_expr_ok(s->left, n) && nest_stmt_ok(s->right, n) && nest_stmt_ok(s->extra, n);
+        case NODE_ASSIGN_IDX:
+            return nest_ref(s, 1, n) && nest_expr_ok(s->left, n) && nest_expr_ok(s->right, n) && nest_expr_ok(s->extra, n);
+        case NODE_ASSIGN:
+            return !is_field_assign(s) && s->kind == KIND_SCALAR && nest_sum_ok(s, n);
+        default:
+            return 0;
+    }
+}
+
+/* Parâmetro sem restrict pode ser parte de qualquer outro array */
+static int may_alias(char *a, char *b) {
+    if (strcmp(a, b) == 0) return 1;
+    ASTNode *da = resolve_var(current_func, a), *db = resolve_var(current_func, b);
+    return (is_array_param(da) && da->passMode != PASS_RESTRICT) || (is_array_param(db) && db->passMode != PASS_RESTRICT);
+}
+
+/* Toda ordem das voltas dá o mesmo resultado? */
+static int nest_permutable(Nest *n) {
+    for (int a = 0; a < n->nrefs; a++) {
+        for (int b = a; b < n->nrefs; b++) {
+            NestRef *x = &n->refs[a], *y = &n->refs[b];
+            if ((!x->write && !y->write) || !may_alias(x->site->strValue, y->site->strValue)) continue;
+            if (strcmp(x->site->strValue, y->site->strValue) != 0 || nest_conflict(n, x, y)) return 0;
+        }
+    }
+    return 1;
+}
+
+/* Acessos a matriz cuja linha muda com 'var'; com 'across', só os que também andam nas colunas com 'across' */
+static int row_walks(Nest *n, char *var, char *across) {
+    int count = 0;
+    for (int k = 0; k < n->nrefs; k++) {
+        ASTNode *s = n->refs[k].site;
+        if (s->right && expr_uses(s->left, var) && (!across || expr_uses(s->right, across))) count++;
+    }
+    return count;
+}
+
+/* Toda leitura de 'var' acontece dentro de um 'for var' que não a altera */
+static int loop_var_dead(ASTNode *node, char *var) {
+    if (!node || node->type == NODE_ACCESS) return 1;
+    if (node->type == NODE_VAR && strcmp(node->strValue, var) == 0) return 0;
+    if (node->type == NODE_FOR && strcmp(node->strValue, var) == 0) {
+        return loop_var_dead(node->left, var) && loop_var_dead(node->right, var) && !writes_var(node->extra, var);
+    }
+    return loop_var_dead(node->left, var) && loop_var_dead(node->right, var) && loop_var_dead(node->extra, var);
+}
+
+/* Laço com poucas voltas conhecidas não ganha com blocos */
+static int short_loop(ASTNode *loop) {
+    return loop->left->type == NODE_CONST && loop->right->type == NODE_CONST &&
+           (long) loop->right->intValue - loop->left->intValue < 2 * NEST_TILE;
+}
+
+static void swap_loop_headers(ASTNode *a, ASTNode *b) {
+    char *var = a->strValue;
+    ASTNode *lo = a->left, *hi = a->right;
+    a->strValue = b->strValue;
+    a->left = b->left;
+    a->right = b->right;
+    b->strValue = var;
+    b->left = lo;
+    b->right = hi;
+}
+
+/*
+ * Decide a ordem do ninho que começa em 'loop' (trocando os cabeçalhos dos
+ * dois 'for' na AST) e devolve 1 se ele deve ser gerado em blocos.
+ */
+static int plan_loop_nest(ASTNode *loop) {
+    ASTNode *in = only_stmt(loop->extra);
+    ASTNode *scope = current_func ? current_func->def->right : main_body;
+    if (!in || in->type != NODE_FOR || strcmp(loop->strValue, in->strValue) == 0) return 0;
+    if (!counted_loop(loop) || !counted_loop(in) || expr_uses(in->left, loop->strValue) || expr_uses(in->right, loop->strValue)) return 0;
+    if (uses_node(scope, NODE_GOTO) || !loop_var_dead(scope, loop->strValue) || !loop_var_dead(scope, in->strValue)) return 0;
+
+    Nest n;
+    memset(&n, 0, sizeof n);
+    n.loop = loop;
+    n.outer = loop->strValue;
+    n.inner = in->strValue;
+    if (!nest_stmt_ok(in->extra, &n) || (n.sum && count_uses(in->extra, n.sum) != n.nsums)) return 0;
+    if (row_walks(&n, n.inner, NULL) == 0 || !nest_permutable(&n)) return 0;
+
+    int swapped = row_walks(&n, n.outer, NULL) < row_walks(&n, n.inner, NULL);
+    if (swapped) {
+        swap_loop_headers(loop, in);
+        n.outer = loop->strValue;
+        n.inner = in->strValue;
+    }
+    int tiled = row_walks(&n, n.inner, n.outer) > 0 && !short_loop(loop) && !short_loop(in);
+    if (swapped) {
+        printf("[OTIM] Lacos 'for %s' e 'for %s' (linha %d) trocados: o de dentro anda pelas colunas.\n",
+               n.inner, n.outer, loop->line);
+    }
+    if (tiled) {
+        printf("[OTIM] Lacos 'for %s' e 'for %s' (linha %d) percorridos em blocos de %dx%d.\n",
+               n.outer, n.inner, loop->line, NEST_TILE, NEST_TILE);
+    }
+    return tiled;
+}
+
+static void gen_tile_loop(ASTNode *loop) {
+    fprintf(f, "for (int %s__t = ", loop->strValue);
+    gen_code(loop->left);
+    fprintf(f, "; %s__t <= ", loop->strValue);
+    gen_code(loop->right);
+    fprintf(f, "; %s__t += %d) {\n", loop->strValue, NEST_TILE);
+}
+
+static void gen_tile_inner_loop(ASTNode *loop) {
+    fprintf(f, "for (");
+    gen_var_name(loop->strValue);
+    fprintf(f, " = %s__t; ", loop->strValue);
+    gen_var_name(loop->strValue);
+    fprintf(f, " <= ");
+    gen_code(loop->right);
+    fprintf(f, " && ");
+    gen_var_name(loop->strValue);
+    fprintf(f, " - %s__t < %d; ", loop->strValue, NEST_TILE);
+    gen_var_name(loop->strValue);
+    fprintf(f, "++) {\n");
+}
+
+/* Ninho em blocos: laços dos blocos por fora, os originais limitados ao bloco por dentro */
+static void gen_tiled_nest(ASTNode *loop) {
+    ASTNode *in = only_stmt(loop->extra);
+    int track = opt_bounds_check || opt_checked_arith;
+    if (track) enter_loop(loop);
+    gen_tile_loop(loop);
+    if (track) enter_loop(in);
+    gen_tile_loop(in);
+    gen_tile_inner_loop(loop);
+    gen_tile_inner_loop(in);
+    gen_code(in->extra);
+    fprintf(f, "}\n}\n}\n}\n");
+    if (track) {
+        leave_loop();
+        leave_loop();
+    }
+}
+
+/*
+ * DESENROLAMENTO
+ * Um 'for' contado (ver counted_loop) com limites constantes e poucas voltas
+ * vira cópias do corpo, uma por volta, com a variável trocada pela constante
+ * (índices como v[i] ficam v[3] e --bounds-check os prova um a um). Laços
+ * mais longos de corpo pequeno, sem chamadas, E/S nem laços dentro, andam
+ * UNROLL_FACTOR voltas por vez ('i', 'i + 1', ...) e terminam no laço de
+ * resto. Corpos com rótulos, goto, declarações ou strings não são copiados.
+ */
+#define UNROLL_FULL_TRIPS 16    /* Máximo de voltas desenroladas por completo */
+#define UNROLL_FULL_SIZE 1024   /* Máximo de nós somando todas as cópias */
+#define UNROLL_FACTOR 4
+#define UNROLL_PARTIAL_SIZE 48  /* Máximo de nós do corpo desenrolado em UNROLL_FACTOR */
+
+typedef struct {
+    char *var;
+    int fixed;   /* 1: a variável vale 'value'; 0: vale 'var + value' */
+    long value;
+} Unrolled;
+
+static Unrolled unrolled[MAX_LOOPS];
+static int nunrolled = 0;
+
+/* Gera a variável de uma cópia desenrolada; 0 se 'name' não é de laço desenrolado */
+static int gen_unrolled_var(char *name) {
+    for (int k = nunrolled - 1; k >= 0; k--) {
+        if (strcmp(unrolled[k].var, name) != 0) continue;
+        if (unrolled[k].fixed) fprintf(f, "%ld", unrolled[k].value);
+        else if (unrolled[k].value) fprintf(f, "(%s + %ld)", name, unrolled[k].value);
+        else gen_var_name(name);
+        return 1;
+    }
+    return 0;
+}
+
+/* Valor de uma expressão inteira constante (também len/rows/cols de array de tamanho fixo) */
+static int const_int(ASTNode *e, long *value) {
+    Bound lo, hi;
+    range_of(e, &lo, &hi);
+    if (lo.base != 0 || hi.base != 0 || lo.c != hi.c) return 0;
+    *value = lo.c;
+    return 1;
+}
+
+/* Voltas de um 'for' de limites constantes (-1: desconhecido) */
+static long const_trips(ASTNode *loop) {
+    long a, b;
+    if (!const_int(loop->left, &a) || !const_int(loop->right, &b)) return -1;
+    return b < a ? 0 : b - a + 1;
+}
+
+/* Nós gerados pelo corpo, já contando o desenrolamento completo dos laços de dentro */
+static long unroll_size(ASTNode *node) {
+    if (!node || node->type == NODE_ACCESS) return node ? 1 : 0;
+    long size = 1 + unroll_size(node->left) + unroll_size(node->right);
+    long trips = node->type == NODE_FOR ? const_trips(node) : -1;
+    long body = unroll_size(node->extra);
+    return size + (trips > 0 && trips <= UNROLL_FULL_TRIPS ? trips * body : body);
+}
+
+/* Comandos que não podem aparecer duas vezes no C gerado (ou que pedem temporárias de string) */
+static int unroll_blocked(ASTNode *body) {
+    return uses_node(body, NODE_PARALLEL) || uses_node(body, NODE_LABEL) || uses_node(body, NODE_GOTO) || uses_node(body, NODE_DECL) || uses_strings(body);
+}
+
+/* Corpo só de contas: sem chamadas, E/S nem laços */
+static int straight_body(ASTNode *node) {
+    if (!node) return 1;
+    switch (node->type) {
+        case NODE_FOR:
+        case NODE_WHILE:
+        case NODE_PARALLEL:
+        case NODE_FUNC_CALL:
+        case NODE_PROC_CALL:
+        case NODE_PRINT:
+        case NODE_READ:
+        case NODE_READ_ALL:
+        case NODE_PRINT_ALL:
+        case NODE_MAP_OPEN:
+        case NODE_MAP_CLOSE:
+        case NODE_LOAD:
+        case NODE_STORE:
+        case NODE_RETURN:
+            return 0;
+        default:
+            return straight_body(node->left) && straight_body(node->right) && straight_body(node->extra);
+    }
+}
+
+/* Laço de dentro de uma cópia é gerado de novo em cada cópia: informa só a primeira vez */
+static int first_report(ASTNode *loop) {
+    static ASTNode **seen = NULL;
+    static int nseen = 0, cap = 0;
+    for (int k = 0; k < nseen; k++) {
+        if (seen[k] == loop) return 0;
+    }
+    if (nseen == cap) {
+        cap = cap ? cap * 2 : 16;
+        seen = (ASTNode**) realloc(seen, cap * sizeof(ASTNode*));
+    }
+    seen[nseen++] = loop;
+    return 1;
+}
+
+/* 0: laço normal; 1: desenrolar por completo; UNROLL_FACTOR: desenrolar com resto */
+static int plan_unroll(ASTNode *loop) {
+    ASTNode *body = loop->extra;
+    if (!counted_loop(loop) || unroll_blocked(body)) return 0;
+    long trips = const_trips(loop), size = unroll_size(body);
+    if (trips > 0 && trips <= UNROLL_FULL_TRIPS && trips * size <= UNROLL_FULL_SIZE) {
+        if (first_report(loop)) {
+            printf("[OTIM] Laco 'for %s' (linha %d) desenrolado por completo (%ld volta%s).\n", loop->strValue, loop->line, trips, trips > 1 ? "s" : "");
+        }
+        return 1;
+    }
+    if ((trips < 0 || trips >= 2 * UNROLL_FACTOR) && size <= UNROLL_PARTIAL_SIZE && straight_body(body)) {
+        if (first_report(loop)) {
+            printf("[OTIM] Laco 'for %s' (linha %d) desenrolado %dx, com laco de resto.\n", loop->strValue, loop->line, UNROLL_FACTOR);
+        }
+        return UNROLL_FACTOR;
+    }
+    return 0;
+}
+
+static void gen_unrolled_copy(ASTNode *loop, int fixed, long value) {
+    if (nunrolled == MAX_LOOPS) {
+        fprintf(stderr, "ERRO (Linha %d): lacos desenrolados demais.\n", loop->line);
+        exit(1);
+    }
+    unrolled[nunrolled++] = (Unrolled) { loop->strValue, fixed, value };
+    gen_code(loop->extra);
+    nunrolled--;
+}
+
+static int auto_local(char *name);
+
+/*
+ * Começa a atribuição do valor de saída de 'var' ('i = ', o chamador
+ * completa) e devolve 1. Se ninguém lê a variável depois do laço, gera só
+ * '(void) i;', que mantém usada a declaração de um laço que sumiu inteiro.
+ */
+static int gen_loop_exit(char *var) {
+    ASTNode *scope = current_func ? current_func->def->right : main_body;
+    int dead = !uses_node(scope, NODE_GOTO) && auto_local(var) && loop_var_dead(scope, var);
+    fprintf(f, dead ? "(void) " : "");
+    gen_var_name(var);
+    fprintf(f, dead ? ";\n" : " = ");
+    return !dead;
+}
+
+static void gen_unrolled_loop(ASTNode *loop, int factor) {
+    int track = opt_bounds_check || opt_checked_arith;
+    if (track) enter_loop(loop);
+    if (factor == 1) {
+        long a, b;
+        const_int(loop->left, &a);
+        const_int(loop->right, &b);
+        for (long k = a; k <= b; k++) {
+            /* Cada cópia conhece o valor exato da variável */
+            LoopRange r = { loop->strValue, { 0, NULL, k }, { 0, NULL, k } };
+            if (track && nloops < MAX_LOOPS) loops[nloops] = r;
+            if (track) nloops++;
+            gen_unrolled_copy(loop, 1, k);
+            if (track) nloops--;
+        }
+        if (gen_loop_exit(loop->strValue)) fprintf(f, "%ld;\n", b + 1);
+    } else {
+        fprintf(f, "for (");
+        gen_var_name(loop->strValue);
+        fprintf(f, " = ");
+        gen_code(loop->left);
+        fprintf(f, "; ");
+        gen_var_name(loop->strValue);
+        fprintf(f, " <= (");
+        gen_code(loop->right);
+        fprintf(f, ") - %d; ", factor - 1);
+        gen_var_name(loop->strValue);
+        fprintf(f, " += %d) {\n", factor);
+        for (int k = 0; k < factor; k++) gen_unrolled_copy(loop, 0, k);
+        fprintf(f, "}\nfor (; ");
+        gen_var_name(loop->strValue);
+        fprintf(f, " <= ");
+        gen_code(loop->right);
+        fprintf(f, "; ");
+        gen_var_name(loop->strValue);
+        fprintf(f, "++) {\n");
+        gen_code(loop->extra);
+        fprintf(f, "}\n");
+    }
+    if (track) leave_loop();
+}
+
+/*
+ * IDIOMAS DE LAÇO
+ * Laços cujo corpo só atribui a arrays, um elemento por volta, na posição
+ * da variável (X[i + c] ou, em matriz, X[linha][i + c]), viram operações
+ * sobre o trecho inteiro: valor invariante -> memset (0, -1 e char) ou
+ * ezc_set_*; Y[i + c] -> memcpy; i + c -> ezc_iota_*. Cada destino é um
+ * array diferente e nenhum é origem de cópia (nem pode apelidá-la), então
+ * fazer um comando de cada vez dá o mesmo resultado que intercalar. O laço
+ * com goto (i := a; L: if i >= n then goto E; ...; i := i + 1; goto L; E:)
+ * é reescrito antes como 'for' quando o corpo não tem rótulos, idioma ou
+ * não (assim também entra na fusão de laços).
+ */
+#define MAX_IDIOMS 16
+#define MAX_GOTO_LOOPS 256
+
+enum { IDIOM_FILL, IDIOM_COPY, IDIOM_IOTA };
+
+typedef struct {
+    ASTNode *site;   /* NODE_ASSIGN_IDX */
+    int kind;
+    long c;          /* Destino: X[i + c] */
+    long c2;         /* Cópia: Y[i + c2]; sequência: valor i + c2 */
+} Idiom;
+
+/* Expressão sem arrays, chamadas nem a variável do laço: mesmo valor em toda volta */
+static int idiom_invariant(ASTNode *e, char *var) {
+    if (!e) return 1;
+    switch (e->type) {
+        case NODE_CONST:
+            return e->dataType != TYPE_STRING;
+        case NODE_VAR:
+            return e->kind == KIND_SCALAR && strcmp(e->strValue, var) != 0 &&
+                   (e->dataType == TYPE_INT || e->dataType == TYPE_FLOAT || e->dataType == TYPE_CHAR);
+        case NODE_BIN_OP:
+        case NODE_CAST:
+            return idiom_invariant(e->left, var) && idiom_invariant(e->right, var);
+        case NODE_BUILTIN:
+            return size_builtin(e);
+        default:
+            return 0;
+    }
+}
+
+/* Elemento X[i + c] / X[linha][i + c] com linha invariante; devolve c */
+static int idiom_element(ASTNode *site, char *var, long *c) {
+    ASTNode *d = resolve_var(current_func, site->strValue);
+    if (!d || (d->kind != KIND_ARRAY && d->kind != KIND_MATRIX)) return 0;
+    if (d->dataType != TYPE_INT && d->dataType != TYPE_FLOAT && d->dataType != TYPE_CHAR) return 0;
+    if (site->right && !idiom_invariant(site->left, var)) return 0;
+    return affine_in(site->right ? site->right : site->left, var, c);
+}
+
+/* Comandos do corpo como idiomas (0: o corpo não é um idioma) */
+static int idiom_body(ASTNode *body, char *var, Idiom *out) {
+    while (body && body->type == NODE_BLOCK) body = body->left;
+    ASTNode **items;
+    int n = flatten_seq(body, &items), ok = n > 0 && n <= MAX_IDIOMS;
+    for (int k = 0; k < n && ok; k++) {
+        ASTNode *s = items[k], *v = s->extra;
+        Idiom *id = &out[k];
+        id->site = s;
+        if (s->type != NODE_ASSIGN_IDX || !idiom_element(s, var, &id->c)) {
+            ok = 0;
+        } else if (v->type == NODE_ARRAY_ACCESS) {
+            id->kind = IDIOM_COPY;
+            ASTNode *d = resolve_var(current_func, s->strValue), *sd = resolve_var(current_func, v->strValue);
+            ok = idiom_element(v, var, &id->c2) && sd->dataType == d->dataType;
+        } else if (v->dataType == TYPE_INT && affine_in(v, var, &id->c2)) {
+            id->kind = IDIOM_IOTA;
+            ok = resolve_var(current_func, s->strValue)->dataType != TYPE_CHAR;
+        } else {
+            id->kind = IDIOM_FILL;
+            ok = idiom_invariant(v, var);
+        }
+    }
+    /* Destinos distintos, e nenhum pode ser a origem de uma cópia */
+    for (int a = 0; a < n && ok; a++) {
+        for (int b = 0; b < n && ok; b++) {
+            if (a != b && may_alias(out[a].site->strValue, out[b].site->strValue)) ok = 0;
+            if (out[b].kind == IDIOM_COPY && may_alias(out[a].site->strValue, out[b].site->extra->strValue)) ok = 0;
+        }
+    }
+    free(items);
+    return ok ? n : 0;
+}
+
+/* 'for' de variável int cujo corpo é um idioma; devolve a quantidade de comandos */
+static int idiom_loop(ASTNode *loop, Idiom *out) {
+    ASTNode *d = resolve_var(current_func, loop->strValue);
+    if (!d || d->kind != KIND_SCALAR || d->dataType != TYPE_INT) return 0;
+    if (!idiom_invariant(loop->left, loop->strValue) || !idiom_invariant(loop->right, loop->strValue)) return 0;
+    return idiom_body(loop->extra, loop->strValue, out);
+}
+
+static ASTNode *goto_loops[MAX_GOTO_LOOPS];   /* 'for' que vieram de laços com goto */
+static int ngoto_loops = 0;
+
+/* Zeros (e -1 em int) têm todos os bytes iguais: memset serve */
+static int idiom_memset(ASTNode *site) {
+    ASTNode *d = resolve_var(current_func, site->strValue), *v = site->extra;
+    long x;
+    if (d->dataType == TYPE_CHAR) return 1;
+    if (d->dataType == TYPE_FLOAT) return v->type == NODE_CONST && v->dataType == TYPE_FLOAT && v->floatValue == 0;
+    return const_int(v, &x) && (x == 0 || x == -1);
+}
+
+static const char* idiom_name(Idiom *id) {
+    switch (id->kind) {
+        case IDIOM_COPY: return "memcpy";
+        case IDIOM_IOTA: return "sequencia";
+        default: return idiom_memset(id->site) ? "memset" : "preenchimento";
+    }
+}
+
+static int from_goto_loop(ASTNode *loop) {
+    for (int k = 0; k < ngoto_loops; k++) {
+        if (goto_loops[k] == loop) return 1;
+    }
+    return 0;
+}
+
+static void report_idiom_loop(ASTNode *loop, Idiom *ids, int n) {
+    printf("[OTIM] Laco %s'%s' (linha %d) vira", from_goto_loop(loop) ? "com goto em " : "de ", loop->strValue, loop->line);
+    for (int k = 0; k < n; k++) printf("%s %s(%s)", k ? "," : "", idiom_name(&ids[k]), ids[k].site->strValue);
+    printf(".\n");
+}
+
+static int count_gotos(ASTNode *node, char *label) {
+    if (!node) return 0;
+    int here = node->type == NODE_GOTO && strcmp(node->strValue, label) == 0;
+    return here + count_gotos(node->left, label) + count_gotos(node->right, label) + count_gotos(node->extra, label);
+}
+
+/* i := a; L: if i >= n (ou i > b) then goto E; corpo; i := i + 1; goto L; E: -> 'for' */
+static ASTNode* goto_loop_at(ASTNode **items, int n, int k, ASTNode *scope, int *len) {
+    if (k + 6 > n || items[k]->type != NODE_ASSIGN || items[k]->kind != KIND_SCALAR || is_field_assign(items[k])) return NULL;
+    char *var = items[k]->strValue;
+    ASTNode *label = items[k + 1], *test = items[k + 2];
+    if (label->type != NODE_LABEL || test->type != NODE_IF || test->extra) return NULL;
+    ASTNode *cond = test->left, *exit = only_stmt(test->right);
+    if (cond->type != NODE_BIN_OP || (strcmp(cond->strValue, ">=") != 0 && strcmp(cond->strValue, ">") != 0)) return NULL;
+    if (cond->left->type != NODE_VAR || strcmp(cond->left->strValue, var) != 0 || cond->right->dataType != TYPE_INT) return NULL;
+    if (!exit || exit->type != NODE_GOTO) return NULL;
+    ASTNode *d = resolve_var(current_func, var);
+    if (!d || d->kind != KIND_SCALAR || d->dataType != TYPE_INT) return NULL;
+
+    /* O corpo vai até o primeiro 'goto L' e não tem rótulos: nada entra nele por salto */
+    int m = k + 3;
+    while (m + 1 < n && !(items[m + 1]->type == NODE_GOTO && strcmp(items[m + 1]->strValue, label->strValue) == 0)) {
+        if (uses_node(items[m], NODE_LABEL)) return NULL;
+        m++;
+    }
+    if (m == k + 3 || m + 2 >= n) return NULL;
+    ASTNode *step = items[m], *end = items[m + 2];
+    if (step->type != NODE_ASSIGN || strcmp(step->strValue, var) != 0 || !step->left || step->left->type != NODE_BIN_OP) return NULL;
+    long one;
+    if (strcmp(step->left->strValue, "+") != 0 || !affine_in(step->left, var, &one) || one != 1) return NULL;
+    if (end->type != NODE_LABEL || strcmp(end->strValue, exit->strValue) != 0) return NULL;
+
+    /* Só o goto do fim volta ao rótulo, que some com o laço */
+    if (count_gotos(scope, label->strValue) != 1) return NULL;
+
+    ASTNode *last = cond->right;
+    if (strcmp(cond->strValue, ">=") == 0) {
+        last = create_bin_op("-", cond->right, create_const(1));
+        last->dataType = TYPE_INT;
+    }
+    ASTNode *body = items[k + 3];
+    for (int j = k + 4; j < m; j++) body = create_seq(body, items[j]);
+    ASTNode *loop = create_for(var, items[k]->left, last, body);
+    loop->line = label->line;
+    Idiom ids[MAX_IDIOMS];
+    if (ngoto_loops == MAX_GOTO_LOOPS) return NULL;
+    goto_loops[ngoto_loops++] = loop;
+    if (!idiom_loop(loop, ids)) printf("[OTIM] Laco com goto em '%s' (linha %d) vira 'for'.\n", var, loop->line);
+    /* Rótulo de saída que só o laço usava some junto (e libera um laço com goto de fora) */
+    *len = m + 2 - k + (count_gotos(scope, end->strValue) == 1);
+    return loop;
+}
+
+/* Reescreve os laços com goto das listas de comandos; devolve quantos */
+static int rewrite_goto_loops(ASTNode *node, ASTNode *scope) {
+    if (!node || node->type == NODE_ACCESS) return 0;
+    if (node->type != NODE_SEQ) {
+        return rewrite_goto_loops(node->left, scope) + rewrite_goto_loops(node->right, scope) + rewrite_goto_loops(node->extra, scope);
+    }
+    ASTNode **items;
+    int n = flatten_seq(node, &items), found = 0;
+    /* De trás para frente: o laço de dentro vira 'for' antes e libera o de fora */
+    for (int k = n - 1; k >= 0; k--) {
+        int len;
+        ASTNode *loop = goto_loop_at(items, n, k, scope, &len);
+        if (!loop) continue;
+        items[k] = loop;
+        memmove(&items[k + 1], &items[k + len], (n - k - len) * sizeof(ASTNode*));
+        n -= len - 1;
+        found++;
+    }
+    if (found) {
+        /* A cadeia nova fica no mesmo nó, que pode ser referenciado (ex: main_body) */
+        ASTNode *chain = items[0];
+        for (int k = 1; k < n; k++) chain = create_seq(chain, items[k]);
+        *node = *chain;
+    }
+    for (int k = 0; k < n; k++) found += rewrite_goto_loops(items[k], scope);
+    free(items);
+    return found;
+}
+
+/* Informa os laços 'for' que viram idiomas; devolve quantos (mais os que podem virar) */
+static int report_idioms(ASTNode *node) {
+    if (!node || node->type == NODE_ACCESS) return 0;
+    Idiom ids[MAX_IDIOMS];
+    int n = node->type == NODE_FOR ? idiom_loop(node, ids) : 0;
+    if (n) {
+        report_idiom_loop(node, ids, n);
+        return 1;
+    }
+    /* Ninho que a troca de laços pode transformar em idioma por dentro */
+    ASTNode *in = node->type == NODE_FOR ? only_stmt(node->extra) : NULL;
+    int swapped = in && in->type == NODE_FOR && idiom_body(in->extra, node->strValue, ids);
+    return swapped + report_idioms(node->left) + report_idioms(node->right) + report_idioms(node->extra);
+}
+
+static int fuse_loops(ASTNode *node);
+static int auto_parallel(ASTNode *node, ASTNode *scope);
+
+/*
+ * Antes da geração: reescreve os laços com goto, funde laços vizinhos,
+ * paraleliza (--auto-par) e diz se algum laço usa o runtime de
+ * preenchimento (o runtime é escrito antes do código).
+ */
+static int plan_idioms(void) {
+    int found = 0;
+    for (FuncInfo *fn = func_list; fn; fn = fn->next) {
+        current_func = fn;
+        rewrite_goto_loops(fn->def->right, fn->def->right);
+        fuse_loops(fn->def->right);
+        found += report_idioms(fn->def->right);
+        if (opt_auto_par) auto_parallel(fn->def->right, fn->def->right);
+    }
+    current_func = NULL;
+    rewrite_goto_loops(main_body, main_body);
+    fuse_loops(main_body);
+    found += report_idioms(main_body);
+    if (opt_auto_par) auto_parallel(main_body, main_body);
+    return found;
+}
+
+static void gen_idiom_addr(ASTNode *site, long c) {
+    char *v = site->strValue;
+    fprintf(f, "&%s[", v);
+    if (site->right && dynamic_array(v)) {
+        fprintf(f, "(");
+        gen_code(site->left);
+        fprintf(f, ") * %s__c + ", v);
+    } else if (site->right) {
+        gen_code(site->left);
+        fprintf(f, "][");
+    }
+    if (c) fprintf(f, "a__ + %ld]", c);
+    else fprintf(f, "a__]");
+}
+
+/* --bounds-check: a linha e os dois extremos do trecho, antes de escrever */
+static void gen_idiom_checks(ASTNode *site, long c) {
+    char *v = site->strValue;
+    int last = site->right != NULL;
+    if (!opt_bounds_check) return;
+    if (last && dim_bound(v, 0).base != '?') {
+        fprintf(f, "ezc_idx(");
+        gen_code(site->left);
+        fprintf(f, ", ");
+        gen_dim(v, 0);
+        fprintf(f, ", \"%s\", %d);\n", v, site->line);
+    }
+    if (dim_bound(v, last).base == '?') return;
+    for (int end = 0; end < 2; end++) {
+        fprintf(f, "ezc_idx(a__%s", end ? " + n__ - 1" : "");
+        if (c) fprintf(f, " + %ld", c);
+        fprintf(f, ", ");
+        gen_dim(v, last);
+        fprintf(f, ", \"%s\", %d);\n", v, site->line);
+    }
+}
+
+static void gen_idiom(Idiom *id) {
+    ASTNode *s = id->site, *v = s->extra;
+    ASTNode *d = resolve_var(current_func, s->strValue);
+    const char *t = map_type(d->dataType);
+    char suffix = d->dataType == TYPE_FLOAT ? 'f' : 'i';
+    gen_idiom_checks(s, id->c);
+    if (id->kind == IDIOM_COPY) gen_idiom_checks(v, id->c2);
+    switch (id->kind) {
+        case IDIOM_COPY:
+            fprintf(f, "memcpy(");
+            gen_idiom_addr(s, id->c);
+            fprintf(f, ", ");
+            gen_idiom_addr(v, id->c2);
+            fprintf(f, ", n__ * sizeof(%s));\n", t);
+            break;
+        case IDIOM_IOTA:
+            fprintf(f, "ezc_iota_%c(", suffix);
+            gen_idiom_addr(s, id->c);
+            fprintf(f, id->c2 ? ", a__ + %ld, n__);\n" : ", a__, n__);\n", id->c2);
+            break;
+        default:
+            fprintf(f, idiom_memset(s) ? "memset(" : "ezc_set_%c(", suffix);
+            gen_idiom_addr(s, id->c);
+            fprintf(f, ", ");
+            if (d->dataType == TYPE_CHAR) {
+                gen_code(v);
+                fprintf(f, ", n__);\n");
+            } else if (idiom_memset(s)) {
+                long x = 0;
+                if (d->dataType == TYPE_INT) const_int(v, &x);
+                fprintf(f, "%ld, n__ * sizeof(%s));\n", x, t);
+            } else {
+                fprintf(f, "(%s) (", t);
+                gen_code(v);
+                fprintf(f, "), n__);\n");
+            }
+            break;
+    }
+}
+
+/* Laço reconhecido: os idiomas sobre o trecho a..b e a variável com o valor final do laço */
+static int gen_idiom_loop(ASTNode *loop) {
+    Idiom ids[MAX_IDIOMS];
+    int n = idiom_loop(loop, ids);
+    if (!n) return 0;
+    fprintf(f, "{\nint a__ = ");
+    gen_code(loop->left);
+    fprintf(f, ";\nint n__ = (");
+    gen_code(loop->right);
+    fprintf(f, ") - a__ + 1;\nif (n__ > 0) {\n");
+    for (int k = 0; k < n; k++) gen_idiom(&ids[k]);
+    fprintf(f, "}\n");
+    if (gen_loop_exit(loop->strValue)) fprintf(f, "n__ > 0 ? a__ + n__ : a__;\n");
+    fprintf(f, "}\n");
+    return 1;
+}
+
+/*
+ * FUSÃO DE LAÇOS
+ * Dois 'for' seguidos com a mesma variável e os mesmos limites (que os
+ * corpos não alteram) viram um só, que faz o corpo do segundo logo depois
+ * do primeiro em cada volta: arrays paralelos (key/left/right/valid) e o
+ * array gravado num laço e lido no outro passam uma vez pela cache. Um
+ * elemento tocado pelos dois corpos (algum deles gravando) precisa ser
+ * tocado pelo segundo na mesma volta ou numa volta posterior à do primeiro;
+ * a distância vem dos índices afins, como nos laços aninhados. Escalares
+ * gravadas num corpo não aparecem no outro (exceto variáveis de 'for' de
+ * dentro que só são lidas nos próprios laços) e só um corpo faz E/S. Laços
+ * com laços dentro só são fundidos se os de dentro também forem, e um
+ * idioma não é fundido com um laço que não é.
+ */
+#define MAX_FUSE_SCALARS 64
+
+typedef struct {
+    NestRef refs[MAX_NEST_REFS];
+    int nrefs;
+    char *written[MAX_FUSE_SCALARS];   /* Escalares gravadas no corpo */
+    int nwritten;
+    int io;
+} LoopUses;
+
+static int fuse_ref(ASTNode *site, int write, LoopUses *u) {
+    if (u->nrefs == MAX_NEST_REFS) return 0;
+    u->refs[u->nrefs].site = site;
+    u->refs[u->nrefs++].write = write;
+    return 1;
+}
+
+static int fuse_written(char *name, LoopUses *u) {
+    if (u->nwritten == MAX_FUSE_SCALARS) return 0;
+    u->written[u->nwritten++] = name;
+    return 1;
+}
+
+/* Corpo sem chamadas, saltos, rótulos nem declarações; anota acessos, escalares gravadas e E/S */
+static int fuse_uses(ASTNode *node, LoopUses *u) {
+    if (!node) return 1;
+    switch (node->type) {
+        case NODE_CONST:
+            return 1;
+        case NODE_VAR:
+            return node->kind == KIND_SCALAR;
+        case NODE_SEQ:
+        case NODE_BLOCK:
+        case NODE_IF:
+        case NODE_WHILE:
+        case NODE_BIN_OP:
+        case NODE_CAST:
+        case NODE_ARG_LIST:
+            return fuse_uses(node->left, u) && fuse_uses(node->right, u) && fuse_uses(node->extra, u);
+        case NODE_FOR:
+            return fuse_written(node->strValue, u) && fuse_uses(node->left, u) && fuse_uses(node->right, u) && fuse_uses(node->extra, u);
+        case NODE_ASSIGN:
+            return !is_field_assign(node) && node->kind == KIND_SCALAR && fuse_written(node->strValue, u) && fuse_uses(node->left, u);
+        case NODE_ASSIGN_IDX:
+            return fuse_ref(node, 1, u) && fuse_uses(node->left, u) && fuse_uses(node->right, u) && fuse_uses(node->extra, u);
+        case NODE_ARRAY_ACCESS:
+            return fuse_ref(node, 0, u) && fuse_uses(node->left, u) && fuse_uses(node->right, u);
+        case NODE_PRINT:
+            u->io = 1;
+            return fuse_uses(node->left, u);
+        case NODE_READ:
+            u->io = 1;
+            if (node->kind == KIND_SCALAR) return fuse_written(node->strValue, u);
+            return fuse_ref(node, 1, u) && fuse_uses(node->left, u) && fuse_uses(node->right, u);
+        case NODE_BUILTIN:
+            return size_builtin(node);
+        default:
+            return 0;
+    }
+}
+
+/*
+ * x (primeiro corpo, volta i1) e y (segundo, volta i2) podem tocar o mesmo
+ * elemento com i2 < i1? Cada dimensão com a mesma forma co*i + c + termo dá
+ * co * (i2 - i1) = cx - cy; dimensões de outra forma não informam nada.
+ */
+static int fuse_conflict(Nest *n, NestRef *x, NestRef *y) {
+    ASTNode *ix[2] = { x->site->left, x->site->right }, *iy[2] = { y->site->left, y->site->right };
+    Dist d = { 0, 0 };
+    for (int k = 0; k < 2 && ix[k] && iy[k]; k++) {
+        Affine a, b;
+        if (!nest_affine(ix[k], n, &a) || !nest_affine(iy[k], n, &b)) continue;
+        if (!same_expr(a.rest, b.rest) || a.co != b.co) continue;
+        long c = a.c - b.c;
+        if (!a.co) {
+            if (c) return 0;
+        } else if (c % a.co || !pin_dist(&d, c / a.co)) {
+            return 0;
+        }
+    }
+    return !d.fixed || d.d < 0;
+}
+
+/* Escalar gravada num corpo e presente no outro: só variável de 'for' lida dentro dos seus laços */
+static int fuse_scalars_apart(LoopUses *u, ASTNode *other) {
+    ASTNode *scope = current_func ? current_func->def->right : main_body;
+    for (int k = 0; k < u->nwritten; k++) {
+        char *v = u->written[k];
+        if ((count_uses(other, v) || writes_var(other, v)) && !loop_var_dead(scope, v)) return 0;
+    }
+    return 1;
+}
+
+static ASTNode* fused_loop(ASTNode *a, ASTNode *b) {
+    ASTNode *ba = a->extra, *bb = b->extra;
+    while (ba && ba->type == NODE_BLOCK) ba = ba->left;
+    while (bb && bb->type == NODE_BLOCK) bb = bb->left;
+    ASTNode *loop = create_for(a->strValue, a->left, a->right, ba && bb ? create_seq(ba, bb) : (ba ? ba : bb));
+    loop->line = a->line;
+    return loop;
+}
+
+/* 'a' seguido de 'b' pode virar um laço só, sem mudar o resultado nem perder otimizações? */
+static int fusable(ASTNode *a, ASTNode *b) {
+    if (strcmp(a->strValue, b->strValue) != 0 || !same_expr(a->left, b->left) || !same_expr(a->right, b->right)) return 0;
+    ASTNode *loop = fused_loop(a, b);
+    if (!counted_loop(loop)) return 0;
+
+    Idiom ids[MAX_IDIOMS];
+    if ((idiom_loop(a, ids) || idiom_loop(b, ids)) && !idiom_loop(loop, ids)) return 0;
+    if (uses_node(a->extra, NODE_FOR) || uses_node(b->extra, NODE_FOR)) {
+        ASTNode *ia = only_stmt(a->extra), *ib = only_stmt(b->extra);
+        if (!ia || !ib || ia->type != NODE_FOR || ib->type != NODE_FOR || !fusable(ia, ib)) return 0;
+    }
+
+    LoopUses ua, ub;
+    memset(&ua, 0, sizeof ua);
+    memset(&ub, 0, sizeof ub);
+    if (!fuse_uses(a->extra, &ua) || !fuse_uses(b->extra, &ub) || (ua.io && ub.io)) return 0;
+    if (!fuse_scalars_apart(&ua, b->extra) || !fuse_scalars_apart(&ub, a->extra)) return 0;
+
+    Nest n;
+    memset(&n, 0, sizeof n);
+    n.loop = loop;
+    n.outer = loop->strValue;
+    n.inner = "";
+    for (int i = 0; i < ua.nrefs; i++) {
+        for (int j = 0; j < ub.nrefs; j++) {
+            NestRef *x = &ua.refs[i], *y = &ub.refs[j];
+            if ((!x->write && !y->write) || !may_alias(x->site->strValue, y->site->strValue)) continue;
+            if (strcmp(x->site->strValue, y->site->strValue) != 0 || fuse_conflict(&n, x, y)) return 0;
+        }
+    }
+    return 1;
+}
+
+/* Funde os 'for' vizinhos das listas de comandos (e os de dentro dos fundidos); devolve quantos pares */
+static int fuse_loops(ASTNode *node) {
+    if (!node || node->type == NODE_ACCESS) return 0;
+    if (node->type != NODE_SEQ) return fuse_loops(node->left) + fuse_loops(node->right) + fuse_loops(node->extra);
+    ASTNode **items;
+    int n = flatten_seq(node, &items), found = 0;
+    for (int k = 0; k + 1 < n; k++) {
+        while (k + 1 < n && items[k]->type == NODE_FOR && items[k + 1]->type == NODE_FOR && fusable(items[k], items[k + 1])) {
+            printf("[OTIM] Lacos 'for %s' das linhas %d e %d fundidos.\n", items[k]->strValue, items[k]->line, items[k + 1]->line);
+            items[k] = fused_loop(items[k], items[k + 1]);
+            memmove(&items[k + 1], &items[k + 2], (n - k - 2) * sizeof(ASTNode*));
+            n--;
+            found++;
+        }
+    }
+    if (found) {
+        ASTNode *chain = items[0];
+        for (int k = 1; k < n; k++) chain = create_seq(chain, items[k]);
+        *node = *chain;
+    }
+    for (int k = 0; k < n; k++) found += fuse_loops(items[k]);
+    free(items);
+    return found;
+}
+
+/*
+ * PARALLEL FOR
+ * O corpo vira a função 'ezc_par_K(void **p__c, int p__a, int p__b)', que
+ * faz as voltas p__a..p__b; ezc_par_for (runtime) divide o intervalo entre
+ * as threads. As locais que o laço usa chegam por endereço em p__c: arrays
+ * (e os tamanhos) são apelidados, escalares só lidas são copiadas. A
+ * variável do laço, as de private e as que o corpo grava (variáveis de
+ * 'for' de dentro) são locais do bloco; cada reduce começa no neutro da
+ * operação e é juntado ao original sob um mutex no fim do bloco. O bloco é
+ * um 'for' comum de p__a a p__b, então desenrolamento, idiomas e provas de
+ * limites continuam valendo. As funções (static) ficam em par_out e vão
+ * para o fim do arquivo, com os protótipos antes do código do programa.
+ * Os limites são calculados fora, então só o que o corpo menciona entra em
+ * p__c. Com --openmp não há função: o laço dos blocos leva
+ * '#pragma omp parallel for' com as mesmas cláusulas.
+ */
+enum { PAR_PRIVATE, PAR_REDUCE, PAR_COPY, PAR_ARRAY };
+
+typedef struct {
+    char *name;
+    ASTNode *decl;
+    int role;
+    int op;      /* reduce: '+', '*', 'm' (min) ou 'M' (max) */
+    int slot;    /* Posição em p__c (a dos tamanhos vem logo depois) */
+} ParVar;
+
+typedef struct {
+    ASTNode *par;
+    ParVar vars[MAX_PAR_VARS];
+    int n, nslots;
+} ParPlan;
+
+static FILE *par_out = NULL;   /* Funções dos parallel for, escritas depois do main */
+static int npar = 0;
+
+static FILE* par_tmpfile(void) {
+    FILE *t = tmpfile();
+    if (!t) {
+        fprintf(stderr, "Erro ao criar arquivo temporario para o parallel for.\n");
+        exit(1);
+    }
+    return t;
+}
+
+/* Copia o temporário para o fim de 'f' e o fecha */
+static void append_tmp(FILE *t) {
+    char buf[4096];
+    size_t n;
+    rewind(t);
+    while ((n = fread(buf, 1, sizeof(buf), t)) > 0) fwrite(buf, 1, n, f);
+    fclose(t);
+}
+
+static ParVar* par_find(ParPlan *pl, char *name) {
+    for (int k = 0; k < pl->n; k++) {
+        if (strcmp(pl->vars[k].name, name) == 0) return &pl->vars[k];
+    }
+    return NULL;
+}
+
+static void par_add(ParPlan *pl, char *name, int role, int op) {
+    if (par_find(pl, name)) return;
+    if (pl->n == MAX_PAR_VARS) {
+        fprintf(stderr, "ERRO (Linha %d): variaveis demais no parallel for.\n", pl->par->line);
+        exit(1);
+    }
+    pl->vars[pl->n++] = (ParVar) { name, resolve_var(current_func, name), role, op, 0 };
+}
+
+/* Global de verdade no C gerado: as threads a enxergam direto */
+static int par_shared_global(ASTNode *d) {
+    GlobalInfo *g = find_global(d);
+    return g && !g->home && !g->home_main;
+}
+
+/* Variáveis que o laço menciona, com o papel de cada uma */
+static void par_collect(ASTNode *node, ParPlan *pl) {
+    if (!node || node->type == NODE_ACCESS) return;
+    int named = node->type == NODE_VAR || node->type == NODE_ARRAY_ACCESS || node->type == NODE_ASSIGN_IDX ||
+                node->type == NODE_FOR || node->type == NODE_SLICE ||
+                (node->type == NODE_ASSIGN && !is_field_assign(node));
+    ASTNode *d = named ? resolve_var(current_func, node->strValue) : NULL;
+    if (d && d->dataType != 1000) {
+        if (d->kind != KIND_SCALAR) {
+            if (!par_shared_global(d)) par_add(pl, node->strValue, PAR_ARRAY, 0);
+        } else if (writes_var(pl->par->left->extra, node->strValue)) {
+            par_add(pl, node->strValue, PAR_PRIVATE, 0);
+        } else if (!par_shared_global(d)) {
+            par_add(pl, node->strValue, PAR_COPY, 0);
+        }
+    }
+    par_collect(node->left, pl);
+    par_collect(node->right, pl);
+    par_collect(node->extra, pl);
+}
+
+static void par_plan(ASTNode *par, ParPlan *pl) {
+    ASTNode *loop = par->left;
+    pl->par = par;
+    pl->n = pl->nslots = 0;
+    par_add(pl, loop->strValue, PAR_PRIVATE, 0);
+    for (ASTNode *c = par->right; c; c = c->right) {
+        par_add(pl, c->left->strValue, c->left->intValue ? PAR_REDUCE : PAR_PRIVATE, c->left->intValue);
+    }
+    par_collect(loop->extra, pl);
+    npar_locals = 0;
+    for (int k = 0; k < pl->n; k++) {
+        ParVar *v = &pl->vars[k];
+        if (v->role != PAR_PRIVATE) v->slot = pl->nslots++;
+        if (v->role == PAR_ARRAY && dynamic_array(v->name)) pl->nslots += v->decl->kind == KIND_MATRIX ? 2 : 1;
+        if (v->role != PAR_ARRAY && (v->role != PAR_COPY || !opt_openmp)) par_locals[npar_locals++] = v->name;
+    }
+}
+
+static ASTNode* par_bound_var(char *name) {
+    ASTNode *v = create_var(name);
+    v->dataType = TYPE_INT;
+    return v;
+}
+
+/* Elementos de p__c: endereços das escalares, arrays e tamanhos */
+static void gen_par_captures(ParPlan *pl) {
+    int first = 1;
+    fprintf(f, "void *p__c[] = { ");
+    for (int k = 0; k < pl->n; k++) {
+        ParVar *v = &pl->vars[k];
+        if (v->role == PAR_PRIVATE) continue;
+        fprintf(f, first ? "" : ", ");
+        first = 0;
+        if (v->role != PAR_ARRAY) {
+            fprintf(f, "&");
+            gen_var_name(v->name);
+        } else if (dynamic_array(v->name)) {
+            fprintf(f, v->decl->kind == KIND_MATRIX ? "%s, &%s__r, &%s__c" : "%s, &%s__n", v->name, v->name, v->name);
+        } else {
+            fprintf(f, "%s", v->name);
+        }
+    }
+    fprintf(f, " };\n");
+}
+
+/* Escalar local do bloco; ref sem cópia local ganha uma variável para o ponteiro apontar */
+static void gen_par_scalar(ParVar *v, const char *init) {
+    const char *t = map_type(v->decl->dataType);
+    ASTNode *p = scalar_ref_param(v->name);
+    if (p && current_func->ref_cache != p) {
+        fprintf(f, "%s %s__x%s%s;\n", t, v->name, init ? " = " : "", init ? init : "");
+        fprintf(f, "%s *%s = &%s__x;\n", t, v->name, v->name);
+        return;
+    }
+    fprintf(f, "%s ", t);
+    gen_var_name(v->name);
+    fprintf(f, "%s%s;\n", init ? " = " : "", init ? init : "");
+}
+
+static const char* par_identity(ParVar *v) {
+    int is_float = v->decl->dataType == TYPE_FLOAT;
+    switch (v->op) {
+        case '*': return "1";
+        case 'm': return is_float ? "HUGE_VALF" : "INT_MAX";
+        case 'M': return is_float ? "-HUGE_VALF" : "INT_MIN";
+        default:  return "0";
+    }
+}
+
+/* Entrada da função do bloco: apelidos, cópias e locais */
+static void gen_par_prologue(ParPlan *pl) {
+    char init[64];
+    for (int k = 0; k < pl->n; k++) {
+        ParVar *v = &pl->vars[k];
+        const char *t = map_type(v->decl->dataType == TYPE_ARRAY ? TYPE_INT : v->decl->dataType);
+        switch (v->role) {
+            case PAR_PRIVATE:
+                gen_par_scalar(v, NULL);
+                break;
+            case PAR_REDUCE:
+                gen_par_scalar(v, par_identity(v));
+                break;
+            case PAR_COPY:
+                /* 'arr[]' copiado é o ponteiro (int*) */
+                snprintf(init, sizeof(init), "*(%s *) p__c[%d]", map_type(v->decl->dataType), v->slot);
+                gen_par_scalar(v, init);
+                break;
+            case PAR_ARRAY:
+                if (dynamic_array(v->name)) {
+                    fprintf(f, "%s *%s%s = p__c[%d];\n", t, v->decl->passMode == PASS_RESTRICT ? "restrict " : "", v->name, v->slot);
+                    if (v->decl->kind == KIND_MATRIX) {
+                        fprintf(f, "int %s__r = *(int *) p__c[%d];\n", v->name, v->slot + 1);
+                        fprintf(f, "int %s__c = *(int *) p__c[%d];\n", v->name, v->slot + 2);
+                    } else {
+                        fprintf(f, "int %s__n = *(int *) p__c[%d];\n", v->name, v->slot + 1);
+                    }
+                } else if (v->decl->kind == KIND_MATRIX) {
+                    fprintf(f, "%s (*%s)[%d] = p__c[%d];\n", t, v->name, v->decl->size2, v->slot);
+                } else {
+                    fprintf(f, "%s *%s = p__c[%d];\n", t, v->name, v->slot);
+                }
+                break;
+        }
+    }
+}
+
+/* Saída do bloco: junta os reduce nos originais */
+static void gen_par_combine(ParPlan *pl) {
+    int locked = 0;
+    for (int k = 0; k < pl->n; k++) {
+        ParVar *v = &pl->vars[k];
+        if (v->role != PAR_REDUCE) continue;
+        if (!locked) fprintf(f, "pthread_mutex_lock(&ezc_par_mutex);\n");
+        locked = 1;
+        const char *t = map_type(v->decl->dataType);
+        int checked = opt_checked_arith && v->decl->dataType == TYPE_INT && (v->op == '+' || v->op == '*');
+        if (checked) {
+            fprintf(f, "*(int *) p__c[%d] = %s(*(int *) p__c[%d], ", v->slot, v->op == '+' ? "ezc_add" : "ezc_mul", v->slot);
+            gen_var_name(v->name);
+            fprintf(f, ", %d);\n", pl->par->line);
+        } else if (v->op == '+' || v->op == '*') {
+            fprintf(f, "*(%s *) p__c[%d] %c= ", t, v->slot, v->op);
+            gen_var_name(v->name);
+            fprintf(f, ";\n");
+        } else {
+            fprintf(f, "if (");
+            gen_var_name(v->name);
+            fprintf(f, " %c *(%s *) p__c[%d]) *(%s *) p__c[%d] = ", v->op == 'm' ? '<' : '>', t, v->slot, t, v->slot);
+            gen_var_name(v->name);
+            fprintf(f, ";\n");
+        }
+    }
+    if (locked) fprintf(f, "pthread_mutex_unlock(&ezc_par_mutex);\n");
+}
+
+/* Runtime de threads: chama ezc_par_for e gera a função do bloco em par_out */
+static void gen_par_pool(ParPlan *pl, ASTNode *chunk) {
+    ASTNode *par = pl->par;
+    int id = npar++;
+    if (pl->nslots) gen_par_captures(pl);
+    else fprintf(f, "void **p__c = NULL;\n");
+    fprintf(f, "ezc_par_for(ezc_par_%d, p__c, p__lo, p__hi, %d, %d, %d);\n", id, par->intValue, par->size1, par->minTrips);
+
+    FILE *saved = f;
+    if (!par_out) par_out = par_tmpfile();
+    f = par_out;
+    fprintf(f, "\nstatic void ezc_par_%d(void **p__c, int p__a, int p__b) {\n", id);
+    if (!pl->nslots) fprintf(f, "(void) p__c;\n");
+    gen_par_prologue(pl);
+    gen_code(chunk);
+    gen_par_combine(pl);
+    fprintf(f, "}\n");
+    f = saved;
+}
+
+/* --openmp: laço dos blocos com o pragma; p__a..p__b é o bloco de cada volta */
+static void gen_par_openmp(ParPlan *pl, ASTNode *chunk) {
+    ASTNode *par = pl->par;
+    int first = 1;
+    if (par->size1) fprintf(f, "long p__s = %d;\n", par->size1);
+    else fprintf(f, "long p__s = ((long) p__hi - p__lo + 256) / 256;\nif (p__s < 1) p__s = 1;\n");
+    fprintf(f, "#pragma omp parallel for schedule(%s)", par->intValue ? "dynamic" : (par->size1 ? "static, 1" : "static"));
+    for (int k = 0; k < pl->n; k++) {
+        if (pl->vars[k].role != PAR_PRIVATE) continue;
+        fprintf(f, "%s", first ? " private(" : ", ");
+        gen_var_name(pl->vars[k].name);
+        first = 0;
+    }
+    if (!first) fprintf(f, ")");
+    for (int k = 0; k < pl->n; k++) {
+        ParVar *v = &pl->vars[k];
+        if (v->role != PAR_REDUCE) continue;
+        fprintf(f, " reduction(%s: ", v->op == 'm' ? "min" : v->op == 'M' ? "max" : v->op == '*' ? "*" : "+");
+        gen_var_name(v->name);
+        fprintf(f, ")");
+    }
+    if (par->minTrips) fprintf(f, " if(p__hi - (long) p__lo + 1 >= %d)", par->minTrips);
+    fprintf(f, "\nfor (long p__k = p__lo; p__k <= p__hi; p__k += p__s) {\n");
+    fprintf(f, "int p__a = (int) p__k;\n");
+    fprintf(f, "int p__b = (int) (p__k + p__s - 1 < p__hi ? p__k + p__s - 1 : p__hi);\n");
+    gen_code(chunk);
+    fprintf(f, "}\n");
+}
+
+static void gen_parallel(ASTNode *par) {
+    ASTNode *loop = par->left;
+    static ParPlan pl;
+    par_plan(par, &pl);
+    ASTNode *chunk = create_for(loop->strValue, par_bound_var("p__a"), par_bound_var("p__b"), loop->extra);
+    chunk->line = loop->line;
+    if (!par->minTrips) {
+        printf("[OTIM] Laco 'parallel for %s' (linha %d) dividido entre as threads (%s%s).\n", loop->strValue, loop->line,
+               par->intValue ? "blocos dinamicos" : "blocos estaticos", opt_openmp ? ", OpenMP" : "");
+    }
+
+    fprintf(f, "{\nint p__lo = ");
+    gen_code(loop->left);
+    fprintf(f, ";\nint p__hi = ");
+    gen_code(loop->right);
+    fprintf(f, ";\n");
+    par_loop = par;
+    if (opt_openmp) gen_par_openmp(&pl, chunk);
+    else gen_par_pool(&pl, chunk);
+    par_loop = NULL;
+    /* Sem OpenMP as privadas só são usadas dentro de ezc_par_K: a declaração de fora pode ficar sem uso */
+    for (int k = 0; k < pl.n && !opt_openmp; k++) {
+        if (pl.vars[k].role != PAR_PRIVATE || strcmp(pl.vars[k].name, loop->strValue) == 0) continue;
+        fprintf(f, "(void) ");
+        gen_var_name(pl.vars[k].name);
+        fprintf(f, ";\n");
+    }
+    if (gen_loop_exit(loop->strValue)) fprintf(f, "p__hi >= p__lo ? p__hi + 1 : p__lo;\n");
+    fprintf(f, "}\n");
+}
+
+/*
+ * PARALELIZAÇÃO AUTOMÁTICA (--auto-par)
+ * Antes da geração, os 'for' contados viram parallel for (os de fora
+ * primeiro; o recusado é examinado por dentro) quando as voltas são
+ * independentes: nada que par_blocker recuse, nenhuma chamada que grave
+ * memória, nenhum elemento de array gravado numa volta e tocado em outra
+ * (índices a*i + c, como na troca de laços) e nenhuma escalar que passe de
+ * uma volta para a seguinte. Escalares gravadas valem se cada volta as
+ * grava antes de ler e ninguém as lê depois do laço (ficam privadas), ou
+ * se só acumulam com + e * (int) ou min/max (viram reduce). Com voltas
+ * conhecidas e pouco trabalho o laço fica como está; senão minTrips guarda
+ * quantas voltas pagam acordar as threads, conferido ao executar.
+ */
+#define AUTO_PAR_MIN_WORK 100000   /* Nós executados que pagam dividir o laço */
+#define AUTO_PAR_GUESS_TRIPS 64    /* Voltas supostas de um laço de dentro sem limites constantes */
+#define AUTO_PAR_CALL_WORK 50      /* Peso de uma chamada ou operação sobre arrays inteiros */
+#define MAX_AUTO_REFS 256
+
+typedef struct {
+    ASTNode *site;   /* NODE_ARRAY_ACCESS, NODE_ASSIGN_IDX ou nó que usa o array inteiro */
+    int write, whole;
+} AutoRef;
+
+typedef struct {
+    AutoRef refs[MAX_AUTO_REFS];
+    int nrefs, too_many;
+    char *scalars[MAX_PAR_VARS];   /* Escalares que o corpo menciona */
+    int nscalars;
+    ASTNode *writer, *reader;      /* Chamadas que gravam / leem memória de fora */
+    ASTNode *reds[MAX_PAR_VARS];   /* Cláusulas reduce a criar */
+    int nreds;
+    char *privs[MAX_PAR_VARS];
+    int nprivs;
+    long min;
+    char why[256];
+} AutoPlan;
+
+static void auto_ref(AutoPlan *pl, ASTNode *site, int write, int whole) {
+    if (pl->nrefs == MAX_AUTO_REFS) pl->too_many = 1;
+    else pl->refs[pl->nrefs++] = (AutoRef) { site, write, whole };
+}
+
+static void auto_scalar(AutoPlan *pl, char *name) {
+    for (int k = 0; k < pl->nscalars; k++) {
+        if (strcmp(pl->scalars[k], name) == 0) return;
+    }
+    if (pl->nscalars == MAX_PAR_VARS) pl->too_many = 1;
+    else pl->scalars[pl->nscalars++] = name;
+}
+
+/* Acessos a arrays, escalares e chamadas do corpo */
+static void auto_scan(ASTNode *node, AutoPlan *pl) {
+    if (!node || node->type == NODE_ACCESS) return;
+    if (node->type == NODE_BUILTIN && size_builtin(node)) return;
+    int named = node->type == NODE_VAR || node->type == NODE_ARRAY_ACCESS || node->type == NODE_ASSIGN_IDX ||
+                node->type == NODE_FOR || node->type == NODE_SLICE ||
+                (node->type == NODE_ASSIGN && !is_field_assign(node));
+    ASTNode *d = named ? resolve_var(current_func, node->strValue) : NULL;
+    if (d && d->dataType != 1000) {
+        if (d->kind == KIND_SCALAR && d->dataType != TYPE_ARRAY) auto_scalar(pl, node->strValue);
+        else if (node->type == NODE_ARRAY_ACCESS) auto_ref(pl, node, 0, 0);
+        else if (node->type == NODE_ASSIGN_IDX) auto_ref(pl, node, 1, 0);
+        else auto_ref(pl, node, node->type == NODE_ASSIGN, 1);
+    }
+    if (node->type == NODE_MATRIX_OP) {
+        ASTNode *args[MAX_PARAMS];
+        if (collect_params(node->left, args, MAX_PARAMS)) auto_ref(pl, args[0], 1, 1);
+    }
+    if (node->type == NODE_FUNC_CALL || node->type == NODE_PROC_CALL) {
+        FuncInfo *callee = find_func(node->strValue);
+        if (!callee || callee->effect == EFFECT_WRITES) pl->writer = node;
+        else if (callee->effect == EFFECT_PURE) pl->reader = node;
+    }
+    auto_scan(node->left, pl);
+    auto_scan(node->right, pl);
+    auto_scan(node->extra, pl);
+}
+
+/* Duas referências ao mesmo array podem tocar o mesmo elemento em voltas diferentes? */
+static int auto_carried(Nest *n, ASTNode *x, ASTNode *y) {
+    ASTNode *ix[2] = { x->left, x->right }, *iy[2] = { y->left, y->right };
+    for (int w = 0; w < 2; w++) {
+        Affine a, b;
+        if (!ix[w] || !iy[w] || !nest_affine(ix[w], n, &a) || !nest_affine(iy[w], n, &b)) continue;
+        if (a.co != b.co || !same_expr(a.rest, b.rest)) continue;
+        long k = a.c - b.c;
+        /* Elementos sempre diferentes, ou iguais só na mesma volta */
+        if (a.co == 0 ? k != 0 : (k == 0 || k % a.co != 0)) return 0;
+    }
+    return 1;
+}
+
+/* Array que uma função chamada pode ler sem recebê-lo: global do C ou parâmetro (pode ser um global) */
+static int auto_visible(char *name) {
+    if (current_func && find_param(current_func, name)) return 1;
+    return par_shared_global(resolve_var(current_func, name));
+}
+
+/* Como may_alias, e um parâmetro 'arr[]' (ponteiro sem tamanho) pode ser parte de qualquer array */
+static int auto_alias(char *a, char *b) {
+    ASTNode *da = resolve_var(current_func, a), *db = resolve_var(current_func, b);
+    return may_alias(a, b) || da->dataType == TYPE_ARRAY || db->dataType == TYPE_ARRAY;
+}
+
+/* O nó menciona (lê ou grava) a escalar 's'? */
+static int names_var(ASTNode *node, char *s) {
+    int named = node->type == NODE_VAR || node->type == NODE_FOR || (node->type == NODE_ASSIGN && !is_field_assign(node)) ||
+                (node->type == NODE_READ && node->kind == KIND_SCALAR);
+    return named && strcmp(node->strValue, s) == 0;
+}
+
+static int mentions_var(ASTNode *node, char *s) {
+    if (!node || node->type == NODE_ACCESS) return 0;
+    return names_var(node, s) + mentions_var(node->left, s) + mentions_var(node->right, s) + mentions_var(node->extra, s);
+}
+
+static int is_var(ASTNode *e, char *s) {
+    return e->type == NODE_VAR && strcmp(e->strValue, s) == 0;
+}
+
+/* 's := s + e', 's := s * e', 'if e < s then s := e', ...: operação do reduce (0: não acumula) */
+static int auto_reduce_op(ASTNode *node, char *s) {
+    if (node->type == NODE_ASSIGN && !is_field_assign(node) && strcmp(node->strValue, s) == 0) {
+        ASTNode *e = node->left;
+        if (!e || e->type != NODE_BIN_OP || e->strValue[1]) return 0;
+        int left = is_var(e->left, s) && !expr_uses(e->right, s);
+        int right = is_var(e->right, s) && !expr_uses(e->left, s);
+        if (e->strValue[0] == '+' || e->strValue[0] == '*') return left || right ? e->strValue[0] : 0;
+        return e->strValue[0] == '-' && left ? '+' : 0;
+    }
+    if (node->type != NODE_IF || node->extra) return 0;
+    ASTNode *c = node->left, *a = only_stmt(node->right);
+    if (c->type != NODE_BIN_OP || !a || a->type != NODE_ASSIGN || is_field_assign(a) || strcmp(a->strValue, s) != 0) return 0;
+    int less = strcmp(c->strValue, "<") == 0 || strcmp(c->strValue, "<=") == 0;
+    if (!less && strcmp(c->strValue, ">") != 0 && strcmp(c->strValue, ">=") != 0) return 0;
+    if (expr_uses(a->left, s)) return 0;
+    if (is_var(c->right, s) && same_expr(c->left, a->left)) return less ? 'm' : 'M';
+    if (is_var(c->left, s) && same_expr(c->right, a->left)) return less ? 'M' : 'm';
+    return 0;
+}
+
+/* Toda menção de 's' está num acúmulo com a mesma operação */
+static int auto_reduce_scan(ASTNode *node, char *s, int *op) {
+    if (!node || node->type == NODE_ACCESS) return 1;
+    int here = auto_reduce_op(node, s);
+    if (here) {
+        if (*op && *op != here) return 0;
+        *op = here;
+        return 1;
+    }
+    if (names_var(node, s)) return 0;
+    return auto_reduce_scan(node->left, s, op) && auto_reduce_scan(node->right, s, op) && auto_reduce_scan(node->extra, s, op);
+}
+
+/* Local da função (ou do main) que não é parâmetro ref: o laço vê a única cópia */
+static int auto_local(char *name) {
+    if (current_func) return is_local_name(current_func, name) && !scalar_ref_param(name);
+    GlobalInfo *g = find_global(resolve_var(NULL, name));
+    return g && g->home_main;
+}
+
+/* O comando grava 's' sem lê-la antes ('s := e' ou 'for s', que atribui o início mesmo sem voltas) */
+static int kills_var(ASTNode *it, char *s) {
+    if (it->type == NODE_ASSIGN && !is_field_assign(it)) return strcmp(it->strValue, s) == 0 && !expr_uses(it->left, s);
+    return it->type == NODE_FOR && strcmp(it->strValue, s) == 0 && !expr_uses(it->left, s) && !expr_uses(it->right, s);
+}
+
+static int first_mention(ASTNode *it, char *s);
+
+/* Primeira menção certa de 's' na lista de comandos (ver first_mention) */
+static int seq_first_mention(ASTNode *body, char *s) {
+    ASTNode **items;
+    while (body && body->type == NODE_BLOCK) body = body->left;
+    int n = flatten_seq(body, &items), m = 0;
+    for (int k = 0; k < n && !m; k++) m = first_mention(items[k], s);
+    free(items);
+    return m;
+}
+
+/*
+ * Como o comando usa 's' antes de qualquer outro: 1 = grava sem ler, -1 = pode
+ * ler antes, 0 = não menciona ou só grava em parte dos caminhos (quem vem
+ * depois decide). Um 'for' de outra variável, como o 'for j' de um ninho,
+ * pode não dar volta nenhuma, então gravar no corpo dele não basta.
+ */
+static int first_mention(ASTNode *it, char *s) {
+    if (!mentions_var(it, s)) return 0;
+    if (kills_var(it, s)) return 1;
+    if (it->type == NODE_SEQ || it->type == NODE_BLOCK) return seq_first_mention(it, s);
+    if (it->type == NODE_FOR && !expr_uses(it->left, s) && !expr_uses(it->right, s)) {
+        return seq_first_mention(it->extra, s) < 0 ? -1 : 0;
+    }
+    if (it->type == NODE_IF && !expr_uses(it->left, s)) {
+        int a = seq_first_mention(it->right, s), b = seq_first_mention(it->extra, s);
+        if (a < 0 || b < 0) return -1;
+        return a > 0 && b > 0;
+    }
+    return -1;
+}
+
+/* Cada volta grava 's' antes de ler */
+static int auto_private(ASTNode *body, char *s) {
+    return seq_first_mention(body, s) > 0 || loop_var_dead(body, s);
+}
+
+/* Ninguém lê 's' depois do laço items[k] antes de gravá-la de novo */
+static int auto_dead_after(ASTNode **items, int n, int k, ASTNode *scope, int top, char *s) {
+    if (!uses_node(scope, NODE_GOTO)) {
+        for (int j = k + 1; j < n; j++) {
+            int m = first_mention(items[j], s);
+            if (m) return m > 0;
+        }
+        if (top) return 1;
+    }
+    return mentions_var(scope, s) == mentions_var(items[k], s);
+}
+
+/* Nós executados por volta, com os laços de dentro multiplicados (satura em AUTO_PAR_MIN_WORK) */
+static long auto_work(ASTNode *node) {
+    if (!node || node->type == NODE_ACCESS) return node ? 1 : 0;
+    long w = 1 + auto_work(node->left) + auto_work(node->right);
+    long body = auto_work(node->extra);
+    if (node->type == NODE_FOR) {
+        long trips = const_trips(node);
+        body *= trips >= 0 ? trips : AUTO_PAR_GUESS_TRIPS;
+    }
+    if (node->type == NODE_FUNC_CALL || node->type == NODE_PROC_CALL || node->type == NODE_MATRIX_OP ||
+        (node->type == NODE_BUILTIN && !size_builtin(node))) w += AUTO_PAR_CALL_WORK;
+    w += body;
+    return w < AUTO_PAR_MIN_WORK ? w : AUTO_PAR_MIN_WORK;
+}
+
+/* Escalares gravadas no corpo: reduce, privada ou motivo da recusa */
+static const char* auto_scalars(AutoPlan *pl, ASTNode **items, int n, int k, ASTNode *scope, int top) {
+    ASTNode *loop = items[k], *body = loop->extra;
+    for (int m = 0; m < pl->nscalars; m++) {
+        char *s = pl->scalars[m];
+        ASTNode *d = resolve_var(current_func, s);
+        int op = 0;
+        if (strcmp(s, loop->strValue) == 0 || !writes_var(body, s)) continue;
+        if (!auto_local(s)) {
+            snprintf(pl->why, sizeof pl->why, "grava '%s', que e vista fora da funcao", s);
+            return pl->why;
+        }
+        if (auto_reduce_scan(body, s, &op) && op) {
+            if (d->dataType != TYPE_INT && (d->dataType != TYPE_FLOAT || op == '+' || op == '*')) {
+                snprintf(pl->why, sizeof pl->why, "acumula '%s' fora de int (a ordem das voltas mudaria o resultado)", s);
+                return pl->why;
+            }
+            if ((op == '+' || op == '*') && opt_checked_arith) {
+                snprintf(pl->why, sizeof pl->why, "acumula '%s' com --checked-arith (o estouro dependeria da divisao)", s);
+                return pl->why;
+            }
+            ASTNode *v = create_var(s);
+            v->dataType = d->dataType;
+            v->intValue = op;
+            pl->reds[pl->nreds++] = v;
+            continue;
+        }
+        if (auto_private(body, s) && auto_dead_after(items, n, k, scope, top, s)) {
+            pl->privs[pl->nprivs++] = s;
+            continue;
+        }
+        snprintf(pl->why, sizeof pl->why, "'%s' passa de uma volta para outra", s);
+        return pl->why;
+    }
+    return NULL;
+}
+
+/* Motivo para não paralelizar o laço items[k] (NULL: pode) */
+static const char* auto_refusal(AutoPlan *pl, ASTNode **items, int n, int k, ASTNode *scope, int top) {
+    ASTNode *loop = items[k], *at;
+    Idiom ids[MAX_IDIOMS];
+    const char *why;
+    memset(pl, 0, sizeof *pl);
+    if (!counted_loop(loop)) return "a variavel ou os limites podem mudar no corpo";
+    if (idiom_loop(loop, ids)) return "ja vira memset/memcpy ou preenchimento";
+    if ((why = par_blocker(current_func, loop, &at)) != NULL) {
+        snprintf(pl->why, sizeof pl->why, "tem %s (linha %d)", why, at->line);
+        return pl->why;
+    }
+
+    auto_scan(loop->extra, pl);
+    if (pl->too_many) return "acessos demais para o teste de dependencia";
+    if (pl->writer) {
+        snprintf(pl->why, sizeof pl->why, "chama '%s', que grava memoria", pl->writer->strValue);
+        return pl->why;
+    }
+    Nest nest = { .loop = loop, .outer = loop->strValue, .inner = "" };
+    for (int a = 0; a < pl->nrefs; a++) {
+        AutoRef *x = &pl->refs[a];
+        if (x->write && pl->reader && auto_visible(x->site->strValue)) {
+            snprintf(pl->why, sizeof pl->why, "chama '%s', que pode ler '%s'", pl->reader->strValue, x->site->strValue);
+            return pl->why;
+        }
+        for (int b = a; b < pl->nrefs; b++) {
+            AutoRef *y = &pl->refs[b];
+            if ((!x->write && !y->write) || !auto_alias(x->site->strValue, y->site->strValue)) continue;
+            if (strcmp(x->site->strValue, y->site->strValue) != 0) {
+                snprintf(pl->why, sizeof pl->why, "'%s' e '%s' podem ser o mesmo array", x->site->strValue, y->site->strValue);
+                return pl->why;
+            }
+            if (x->whole || y->whole || auto_carried(&nest, x->site, y->site)) {
+                snprintf(pl->why, sizeof pl->why, "um elemento de '%s' gravado numa volta pode ser usado em outra (linha %d)",
+                         x->site->strValue, (x->write ? x->site : y->site)->line);
+                return pl->why;
+            }
+        }
+    }
+    if ((why = auto_scalars(pl, items, n, k, scope, top)) != NULL) return why;
+
+    long work = auto_work(loop->extra) + 1, trips = const_trips(loop);
+    if (trips >= 0 && (trips < 2 || trips * work < AUTO_PAR_MIN_WORK)) {
+        snprintf(pl->why, sizeof pl->why, "poucas voltas (%ld) para o trabalho do corpo", trips);
+        return pl->why;
+    }
+    pl->min = (AUTO_PAR_MIN_WORK + work - 1) / work;
+    if (pl->min < 2) pl->min = 2;
+    return NULL;
+}
+
+/* Troca o 'for' items[k] por um parallel for, se der; informa a decisão */
+static int auto_parallel_at(ASTNode **items, int n, int k, ASTNode *scope, int top) {
+    static AutoPlan pl;
+    ASTNode *loop = items[k];
+    const char *why = auto_refusal(&pl, items, n, k, scope, top);
+    printf("[OTIM] Laco %s'for %s' (linha %d) ", from_goto_loop(loop) ? "com goto em " : "", loop->strValue, loop->line);
+    if (why) {
+        printf("nao paralelizado: %s.\n", why);
+        return 0;
+    }
+
+    ASTNode *par = create_node(NODE_PARALLEL), *copy = create_node(NODE_FOR);
+    *copy = *loop;
+    par->left = copy;
+    par->line = loop->line;
+    par->minTrips = (int) pl.min;
+    for (int r = 0; r < pl.nreds; r++) par->right = create_arg_list(pl.reds[r], par->right);
+    for (int g = 0; g < ngoto_loops; g++) {
+        if (goto_loops[g] == loop) goto_loops[g] = copy;
+    }
+    *loop = *par;
+
+    printf("paralelizado automaticamente");
+    for (int r = 0; r < pl.nreds; r++) {
+        int op = pl.reds[r]->intValue;
+        printf(", reduce(%s: %s)", op == 'm' ? "min" : op == 'M' ? "max" : op == '*' ? "*" : "+", pl.reds[r]->strValue);
+    }
+    for (int p = 0; p < pl.nprivs; p++) printf("%s%s", p ? ", " : ", private(", pl.privs[p]);
+    printf("%s; threads a partir de %ld voltas.\n", pl.nprivs ? ")" : "", pl.min);
+    return 1;
+}
+
+/* Paraleliza os 'for' das listas de comandos, de fora para dentro; devolve quantos */
+static int auto_parallel(ASTNode *node, ASTNode *scope) {
+    if (!node || node->type == NODE_ACCESS || node->type == NODE_PARALLEL) return 0;
+    if (node->type != NODE_SEQ && node->type != NODE_FOR) {
+        return auto_parallel(node->left, scope) + auto_parallel(node->right, scope) + auto_parallel(node->extra, scope);
+    }
+    ASTNode **items = &node, **list = NULL;
+    int n = 1, found = 0;
+    if (node->type == NODE_SEQ) {
+        n = flatten_seq(node, &list);
+        items = list;
+    }
+    /* Lista do topo da função: depois dela ninguém lê as locais */
+    int top = node == scope || (scope->type == NODE_BLOCK && node == scope->left);
+    for (int k = 0; k < n; k++) {
+        if (items[k]->type != NODE_FOR) found += auto_parallel(items[k], scope);
+        else if (auto_parallel_at(items, n, k, scope, top)) found++;
+        else found += auto_parallel(items[k]->extra, scope);
+    }
+    free(list);
+    return found;
+}
+
+/*
+ * STRINGS
+ * Uma expressão string gera uma vista (ezc_sv) do texto, sem cópia. Texto
+ * novo (concatenação, resultado de função) vai para as temporárias 's__[k]'
+ * da função, declaradas na entrada e liberadas na saída: node->tmp = 1 + k.
+ * Cada temporária pertence a um ponto do código, então um laço reaproveita
+ * o mesmo buffer a cada volta.
+ */
+#define MAX_CONCAT 64
+
+static int ntemps = 0;       /* Temporárias string da função (ou main) sendo gerada */
+static int in_unit_def = 0;  /* Gerando os campos de uma unit: sem inicializador */
+
+static int is_concat(ASTNode *node) {
+    return node && node->type == NODE_BIN_OP && node->dataType == TYPE_STRING;
+}
+
+/* Partes de a + b + c, da esquerda para a direita (concatenadas de uma vez) */
+static void flatten_concat(ASTNode *node, ASTNode **parts, int *n) {
+    if (is_concat(node)) {
+        flatten_concat(node->left, parts, n);
+        flatten_concat(node->right, parts, n);
+        return;
+    }
+    if (*n == MAX_CONCAT) {
+        printf("ERRO (Linha %d): Concatenacao com mais de %d partes.\n", node->line, MAX_CONCAT);
+        exit(1);
+    }
+    parts[(*n)++] = node;
+}
+
+/* Parâmetro string recebido como vista (sem cópia) na função atual? */
+static int string_view_param(char *name) {
+    ASTNode *p = current_func ? find_param(current_func, name) : NULL;
+    return p && p->dataType == TYPE_STRING && p->passMode == PASS_VIEW;
+}
+
+/* String escalar do quadro da função atual e dona do texto (local ou cópia do parâmetro) */
+static int owned_local_string(char *name) {
+    if (!current_func || !is_local_name(current_func, name) || string_view_param(name)) return 0;
+    ASTNode *d = resolve_var(current_func, name);
+    return d && d->dataType == TYPE_STRING && d->kind == KIND_SCALAR;
+}
+
+static int unit_has_strings(char *unitName) {
+    UnitInfo *u = find_unit(unitName);
+    for (int i = 0; u && i < u->nfields; i++) {
+        if (u->fields[i]->dataType == TYPE_STRING) return 1;
+    }
+    return 0;
+}
+
+/*
+ * unit__copy(d, s): atribuição campo a campo; os campos string reaproveitam
+ * o texto do destino (ezc_str_set). unit__free(u): libera os campos string.
+ */
+static void gen_unit_helpers(UnitInfo *u) {
+    fprintf(f, "\n__attribute__((unused)) static void %s__copy(struct %s *d, const struct %s *s) {\n", u->name, u->name, u->name);
+    fprintf(f, "if (d == s) return;\n");
+    for (int i = 0; i < u->nfields; i++) {
+        ASTNode *fd = u->fields[i];
+        char *n = fd->strValue;
+        if (fd->dataType != TYPE_STRING) {
+            if (fd->kind == KIND_SCALAR) fprintf(f, "d->%s = s->%s;\n", n, n);
+            else fprintf(f, "memcpy(d->%s, s->%s, sizeof d->%s);\n", n, n, n);
+        } else if (fd->kind == KIND_SCALAR) {
+            fprintf(f, "ezc_str_set(&d->%s, ezc_sv_of(&s->%s));\n", n, n);
+        } else {
+            fprintf(f, "for (int i = 0; i < (int)(sizeof d->%s / sizeof(ezc_str)); i++) ", n);
+            fprintf(f, "ezc_str_set((ezc_str *) d->%s + i, ezc_sv_of((const ezc_str *) s->%s + i));\n", n, n);
+        }
+    }
+    fprintf(f, "}\n");
+    fprintf(f, "\n__attribute__((unused)) static void %s__free(struct %s *u) {\n", u->name, u->name);
+    for (int i = 0; i < u->nfields; i++) {
+        ASTNode *fd = u->fields[i];
+        if (fd->dataType != TYPE_STRING) continue;
+        if (fd->kind == KIND_SCALAR) fprintf(f, "ezc_str_free(&u->%s);\n", fd->strValue);
+        else fprintf(f, "ezc_str_free_n((ezc_str *) u->%s, (long)(sizeof u->%s / sizeof(ezc_str)));\n", fd->strValue, fd->strValue);
+    }
+    fprintf(f, "}\n");
+}
+
+/* A expressão lê a variável 'name'? */
+static int expr_uses(ASTNode *node, char *name) {
+    if (!node) return 0;
+    if (node->type == NODE_VAR && strcmp(node->strValue, name) == 0) return 1;
+    if (node->type == NODE_ACCESS) return 0;
+    return expr_uses(node->left, name) || expr_uses(node->right, name) || expr_uses(node->extra, name);
+}
+
+/* Chama função que pode realocar strings de fora dela (ver plan_string_params)? */
+static int calls_string_mutator(ASTNode *node) {
+    if (!node || node->type == NODE_ACCESS) return 0;
+    if (node->type == NODE_FUNC_CALL || node->type == NODE_PROC_CALL) {
+        FuncInfo *callee = find_func(node->strValue);
+        if (callee && callee->mutates_strings) return 1;
+    }
+    return calls_string_mutator(node->left) || calls_string_mutator(node->right) || calls_string_mutator(node->extra);
+}
+
+/*
+ * Valor de 'x := e' ou 'return e' escrito direto no destino, sem temporária:
+ * resultado de função (movido) ou concatenação montada no destino. Na
+ * concatenação x só pode aparecer como primeira parte (x := x + a vira apêndice).
+ */
+static ASTNode* direct_string_value(ASTNode *st) {
+    ASTNode *e = st->left;
+    if (!e || e->dataType != TYPE_STRING || (e->type != NODE_FUNC_CALL && !is_concat(e))) return NULL;
+    if (st->type == NODE_RETURN) return current_func ? e : NULL;
+    if (st->type != NODE_ASSIGN || is_field_assign(st)) return NULL;
+    if (e->type == NODE_FUNC_CALL) return e;
+
+    ASTNode *parts[MAX_CONCAT];
+    int n = 0;
+    flatten_concat(e, parts, &n);
+    int append = parts[0]->type == NODE_VAR && strcmp(parts[0]->strValue, st->strValue) == 0;
+    for (int i = append; i < n; i++) {
+        if (expr_uses(parts[i], st->strValue)) return NULL;
+    }
+    /* Os apêndices são feitos um a um: uma chamada nas partes veria x pela metade */
+    if (append && n > 2 && contains_call(e)) return NULL;
+    return e;
+}
+
+static void number_temps(ASTNode *node, int hazard);
+
+static void number_concat_parts(ASTNode *e, int hazard) {
+    ASTNode *parts[MAX_CONCAT];
+    int n = 0;
+    flatten_concat(e, parts, &n);
+    for (int i = 0; i < n; i++) number_temps(parts[i], hazard);
+}
+
+/*
+ * Numera as temporárias string de um trecho. 'hazard': o comando chama uma
+ * função que pode realocar strings de fora, então as vistas de strings que
+ * não são da função atual são copiadas para uma temporária ao serem lidas.
+ */
+static void number_temps(ASTNode *node, int hazard) {
+    if (!node || node->type == NODE_ACCESS) return;
+    switch (node->type) {
+        case NODE_IF:
+        case NODE_WHILE:
+            number_temps(node->left, calls_string_mutator(node->left));
+            number_temps(node->right, 0);
+            number_temps(node->extra, 0);
+            return;
+        case NODE_FOR:
+            hazard = calls_string_mutator(node->left) || calls_string_mutator(node->right);
+            number_temps(node->left, hazard);
+            number_temps(node->right, hazard);
+            number_temps(node->extra, 0);
+            return;
+        case NODE_ASSIGN:
+        case NODE_ASSIGN_IDX:
+        case NODE_PRINT:
+        case NODE_PROC_CALL:
+        case NODE_RETURN:
+        case NODE_READ:
+        case NODE_MAP_CLOSE:
+        case NODE_LOAD:
+        case NODE_STORE: {
+            hazard = calls_string_mutator(node->left) || calls_string_mutator(node->right) || calls_string_mutator(node->extra);
+            ASTNode *direct = direct_string_value(node);
+            if (direct && direct->type == NODE_FUNC_CALL) {
+                number_temps(direct->left, hazard);
+                return;
+            } else if (direct) {
+                number_concat_parts(direct, hazard);
+                return;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+
+    if (node->dataType == TYPE_STRING) {
+        if (hazard && ((node->type == NODE_VAR && node->kind == KIND_SCALAR) || node->type == NODE_ARRAY_ACCESS) && !is_local_name(current_func, node->strValue)) {
+            node->tmp = ++ntemps;
+        } else if (node->type == NODE_FUNC_CALL) {
+            node->tmp = ++ntemps;
+        } else if (is_concat(node)) {
+            node->tmp = ++ntemps;
+            number_concat_parts(node, hazard);
+            return;
+        }
+    }
+    number_temps(node->left, hazard);
+    number_temps(node->right, hazard);
+    number_temps(node->extra, hazard);
+}
+
+/* Elemento de array/matriz (v[i], m[i][j]) como lvalue */
+static void gen_indexed(ASTNode *node) {
+    gen_element(node, node->left, node->right);
+}
+
+/* String (ezc_str) que guarda o valor da expressão: variável, elemento ou campo */
+static void gen_str_lvalue(ASTNode *node) {
+    if (node->type == NODE_ACCESS) gen_access_lvalue(node);
+    else if (node->type == NODE_ARRAY_ACCESS) gen_indexed(node);
+    else fprintf(f, "%s", node->strValue);
+}
+
+static void gen_str_view(ASTNode *node);
+
+/* "n, (ezc_sv[]){ a, b, ... }" para ezc_str_catn */
+static void gen_concat_parts(ASTNode *e) {
+    ASTNode *parts[MAX_CONCAT];
+    int n = 0;
+    flatten_concat(e, parts, &n);
+    fprintf(f, "%d, (ezc_sv[]){ ", n);
+    for (int i = 0; i < n; i++) {
+        if (i) fprintf(f, ", ");
+        gen_str_view(parts[i]);
+    }
+    fprintf(f, " }");
+}
+
+/* Vista (ezc_sv) de uma expressão string */
+static void gen_str_view(ASTNode *node) {
+    switch (node->type) {
+        case NODE_CONST:
+            fprintf(f, "EZC_SV_LIT(%s)", node->strValue);
+            return;
+        case NODE_FUNC_CALL:
+            fprintf(f, "ezc_str_take(&s__[%d], ", node->tmp - 1);
+            gen_call(node, NULL);
+            fprintf(f, ")");
+            return;
+        case NODE_BIN_OP:
+            fprintf(f, "ezc_str_catn(&s__[%d], ", node->tmp - 1);
+            gen_concat_parts(node);
+            fprintf(f, ")");
+            return;
+        case NODE_BUILTIN: {
+            /* substr(s, i, n) */
+            ASTNode *args[3];
+            collect_params(node->left, args, 3);
+            fprintf(f, "ezc_sv_sub(");
+            gen_str_view(args[0]);
+            fprintf(f, ", ");
+            gen_code(args[1]);
+            fprintf(f, ", ");
+            gen_code(args[2]);
+            fprintf(f, ")");
+            return;
+        }
+        default:
+            break;
+    }
+    if (node->tmp) fprintf(f, "ezc_str_hold(&s__[%d], ", node->tmp - 1);
+    if (node->type == NODE_VAR && string_view_param(node->strValue)) {
+        fprintf(f, "%s", node->strValue);
+    } else {
+        fprintf(f, "ezc_sv_of(&");
+        gen_str_lvalue(node);
+        fprintf(f, ")");
+    }
+    if (node->tmp) fprintf(f, ")");
+}
+
+/* Nó de expressão cujo valor é a string (e não uma declaração, leitura, função...) */
+static int is_string_value(ASTNode *node) {
+    switch (node->type) {
+        case NODE_CONST:
+        case NODE_VAR:
+        case NODE_ARRAY_ACCESS:
+        case NODE_ACCESS:
+        case NODE_FUNC_CALL:
+        case NODE_BIN_OP:
+        case NODE_BUILTIN:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/* Operando de '==': variáveis donas do texto guardam o hash calculado */
+static int hashable_string(ASTNode *node) {
+    return node->type == NODE_VAR && !node->tmp && !string_view_param(node->strValue);
+}
+
+static void gen_str_equals(ASTNode *node) {
+    int hashed = hashable_string(node->left) && hashable_string(node->right);
+    fprintf(f, "ezc_sv_eq(");
+    if (hashed) fprintf(f, "ezc_str_hashed(&%s)", node->left->strValue);
+    else gen_str_view(node->left);
+    fprintf(f, ", ");
+    if (hashed) fprintf(f, "ezc_str_hashed(&%s)", node->right->strValue);
+    else gen_str_view(node->right);
+    fprintf(f, ")");
+}
+
+/* x := e para string x: move o resultado de função, monta a concatenação no lugar ou copia */
+static void gen_string_assign(ASTNode *node) {
+    char *x = node->strValue;
+    ASTNode *e = node->left;
+    if (e->type == NODE_FUNC_CALL && !e->tmp) {
+        fprintf(f, "ezc_str_move(&%s, ", x);
+        gen_call(e, NULL);
+        fprintf(f, ");\n");
+    } else if (is_concat(e) && !e->tmp) {
+        ASTNode *parts[MAX_CONCAT];
+        int n = 0;
+        flatten_concat(e, parts, &n);
+        if (parts[0]->type == NODE_VAR && strcmp(parts[0]->strValue, x) == 0) {
+            for (int i = 1; i < n; i++) {
+                fprintf(f, "ezc_str_append(&%s, ", x);
+                gen_str_view(parts[i]);
+                fprintf(f, ");\n");
+            }
+        } else {
+            fprintf(f, "ezc_str_catn(&%s, ", x);
+            gen_concat_parts(e);
+            fprintf(f, ");\n");
+        }
+    } else {
+        fprintf(f, "ezc_str_set(&%s, ", x);
+        gen_str_view(e);
+        fprintf(f, ");\n");
+    }
+}
+
+/* ezc_str ret__v com o valor devolvido por uma função string */
+static void gen_string_result(ASTNode *e) {
+    if (e->type == NODE_FUNC_CALL && !e->tmp) {
+        fprintf(f, "ezc_str ret__v = ");
+        gen_call(e, NULL);
+        fprintf(f, ";\n");
+    } else if (is_concat(e) && !e->tmp) {
+        fprintf(f, "ezc_str ret__v = {0};\nezc_str_catn(&ret__v, ");
+        gen_concat_parts(e);
+        fprintf(f, ");\n");
+    } else if (e->type == NODE_VAR && owned_local_string(e->strValue)) {
+        /* A local deixa de ser dona do texto: sem cópia */
+        fprintf(f, "ezc_str ret__v = %s;\n%s = (ezc_str){0};\n", e->strValue, e->strValue);
+    } else {
+        fprintf(f, "ezc_str ret__v = ezc_str_dup(");
+        gen_str_view(e);
+        fprintf(f, ");\n");
+    }
+}
+
+/* Caminho de arquivo para o runtime: literal direto, senão cópia terminada em '\0' */
+static void gen_c_path(ASTNode *e) {
+    if (e->type == NODE_CONST) {
+        fprintf(f, "%s", e->strValue);
+        return;
+    }
+    fprintf(f, "ezc_sv_cstr(");
+    gen_str_view(e);
+    fprintf(f, ")");
+}
+
+/* Unit com campos string passada por valor: a função recebe uma cópia rasa e copia o texto na entrada */
+static int owned_unit_param(ASTNode *p) {
+    return p->dataType == 1000 && p->unitName && p->passMode == PASS_VALUE && unit_has_strings(p->unitName);
+}
+
+static int has_string_locals(ASTNode *node) {
+    if (!node || node->type == NODE_ACCESS) return 0;
+    if (node->type == NODE_DECL && node->kind == KIND_UNIT) return !node->scalarized && unit_has_strings(node->unitName);
+    if (node->type == NODE_DECL) return node->dataType == TYPE_STRING;
+    return has_string_locals(node->left) || has_string_locals(node->right) || has_string_locals(node->extra);
+}
+
+static void gen_free_string_locals(ASTNode *node) {
+    if (!node || node->type == NODE_ACCESS) return;
+    if (node->type == NODE_DECL && node->kind == KIND_UNIT) {
+        if (!node->scalarized && unit_has_strings(node->unitName)) fprintf(f, "%s__free(&%s);\n", node->unitName, node->strValue);
+        return;
+    }
+    if (node->type == NODE_DECL) {
+        if (node->dataType != TYPE_STRING) return;
+        char *v = node->strValue;
+        if (node->left && node->kind == KIND_MATRIX) fprintf(f, "ezc_str_free_n(%s, (long) %s__r * %s__c);\n", v, v, v);
+        else if (node->left) fprintf(f, "ezc_str_free_n(%s, %s__n);\n", v, v);
+        else if (node->kind == KIND_ARRAY) fprintf(f, "ezc_str_free_n(%s, %d);\n", v, node->size1);
+        else if (node->kind == KIND_MATRIX) fprintf(f, "ezc_str_free_n(&%s[0][0], %d);\n", v, node->size1 * node->size2);
+        else fprintf(f, "ezc_str_free(&%s);\n", v);
+        return;
+    }
+    gen_free_string_locals(node->left);
+    gen_free_string_locals(node->right);
+    gen_free_string_locals(node->extra);
+}
+
+/* A função libera memória ao sair (strings temporárias, locais ou copiadas, arrays calculados)? */
+static int has_frame_cleanup(FuncInfo *fn) {
+    if (ntemps > 0 || has_string_locals(fn->def->right) || has_dynamic_arrays(fn->def->right)) return 1;
+    for (GlobalInfo *g = global_list; g != NULL; g = g->next) {
+        if (g->home == fn && g->decl->kind == KIND_UNIT && !g->decl->scalarized && unit_has_strings(g->decl->unitName)) return 1;
+    }
+    for (int i = 0; i < fn->nparams; i++) {
+        if (fn->params[i]->dataType == TYPE_STRING && fn->params[i]->passMode != PASS_VIEW) return 1;
+        if (owned_unit_param(fn->params[i])) return 1;
+    }
+    return 0;
+}
+
+/* Entrada da função (fn = NULL: main): cópias dos parâmetros string alterados, temporárias, arrays calculados */
+static void gen_frame_prologue(FuncInfo *fn, ASTNode *body) {
+    for (int i = 0; fn && i < fn->nparams; i++) {
+        ASTNode *p = fn->params[i];
+        if (p->dataType == TYPE_STRING && p->passMode != PASS_VIEW) {
+            fprintf(f, "ezc_str %s = ezc_str_dup(%s__in);\n", p->strValue, p->strValue);
+        } else if (owned_unit_param(p)) {
+            fprintf(f, "{ struct %s t__ = {0}; %s__copy(&t__, &%s); %s = t__; }\n", p->unitName, p->unitName, p->strValue, p->strValue);
+        }
+    }
+    if (ntemps > 0) fprintf(f, "ezc_str s__[%d] = {{0}};\n", ntemps);
+    gen_dynamic_array_vars(body);
+}
+
+static void gen_frame_cleanup(FuncInfo *fn) {
+    if (ntemps > 0) fprintf(f, "ezc_str_free_n(s__, %d);\n", ntemps);
+    for (int i = 0; i < fn->nparams; i++) {
+        ASTNode *p = fn->params[i];
+        if (p->dataType == TYPE_STRING && p->passMode != PASS_VIEW) fprintf(f, "ezc_str_free(&%s);\n", p->strValue);
+        else if (owned_unit_param(p)) fprintf(f, "%s__free(&%s);\n", p->unitName, p->strValue);
+    }
+    gen_free_string_locals(fn->def->right);
+    for (GlobalInfo *g = global_list; g != NULL; g = g->next) {
+        ASTNode *d = g->decl;
+        if (g->home == fn && d->kind == KIND_UNIT && !d->scalarized && unit_has_strings(d->unitName)) {
+            fprintf(f, "%s__free(&%s);\n", d->unitName, d->strValue);
+        }
+    }
+    gen_free_dynamic_arrays(fn->def->right);
+}
+
+/*
+ * return e: calcula o resultado, devolve o ref em cache ao chamador, libera
+ * a memória da função e retorna.
+ */
+static void gen_return(ASTNode *node) {
+    FuncInfo *fn = current_func;
+    fprintf(f, "{\n");
+    if (fn->ret_slot) {
+        gen_unit_store("ret__", node->left);
+    } else if (fn->def->dataType == TYPE_STRING) {
+        gen_string_result(node->left);
+    } else {
+        fprintf(f, "%s ret__v = ", map_type(fn->def->dataType));
+        gen_code(node->left);
+        fprintf(f, ";\n");
+    }
+    if (fn->ref_cache) {
+        char *r = fn->ref_cache->strValue;
+        fprintf(f, "*%s = %s__v;\n", r, r);
+    }
+    gen_frame_cleanup(fn);
+    fprintf(f, fn->ret_slot ? "return;\n}\n" : "return ret__v;\n}\n");
+}
 
 /*
- * Função Auxiliar: map_type
- * Traduz os tipos internos da linguagem (TYPE_INT, etc.) para os tipos da linguagem C.
- * Exemplo: TYPE_STRING torna-se "char*" (ponteiro de caracteres).
+ * Cabeçalho de uma função: "tipo nome(parametros)".
+ * 'suffix' é acrescentado ao nome (usado para o corpo das funções memoizadas).
  */
-const char* map_type(int type) {
-    switch (type) {
-        case TYPE_INT:      return "int";
-        case TYPE_FLOAT:    return "float";
-        case TYPE_CHAR:     return "char";
-        case TYPE_STRING:   return "char*"; // String em C é tratada como ponteiro
-		case TYPE_ARRAY:    return "int*";
-        default:            return "int";   // Fallback de segurança
+static void gen_func_signature(ASTNode *node, const char *suffix) {
+    FuncInfo *fn = find_func(node->strValue);
+    if (fn && fn->ret_slot) {
+        /* Unit devolvida no espaço do chamador */
+        fprintf(f, "void %s%s(struct %s *ret__%s", node->strValue, suffix, node->unitName, node->left ? ", " : "");
+        gen_code(node->left);
+        fprintf(f, ")");
+        return;
+    }
+
+    /* Verifica se o retorno é uma Struct (unitName não nulo) */
+    if (node->dataType == 1000 && node->unitName != NULL) {
+        fprintf(f, "struct %s %s%s(", node->unitName, node->strValue, suffix);
+    } else {
+        /* Retorno primitivo (int, float, etc) */
+        fprintf(f, "%s %s%s(", map_type(node->dataType), node->strValue, suffix);
+    }
+    gen_code(node->left); // Gera os parâmetros
+    fprintf(f, ")");
+}
+
+/*
+ * Declara, no início do corpo, as globais promovidas para esta função
+ * (fn = NULL: main). No main elas começam com zero, como a global começava.
+ */
+static void gen_promoted_locals(FuncInfo *fn) {
+    for (GlobalInfo *g = global_list; g != NULL; g = g->next) {
+        ASTNode *d = g->decl;
+        if (fn ? g->home != fn : !g->home_main) continue;
+
+        if (d->kind == KIND_UNIT && d->scalarized) {
+            gen_scalarized_decl(d, !fn);
+            continue;
+        } else if (d->kind == KIND_UNIT) {
+            fprintf(f, "struct %s %s", d->unitName, d->strValue);
+            if (!fn || unit_has_strings(d->unitName)) fprintf(f, " = {0}");
+        } else {
+            fprintf(f, "%s %s", map_type(d->dataType), d->strValue);
+            if (!fn) fprintf(f, " = 0");
+        }
+        fprintf(f, ";\n");
+    }
+}
+
+/*
+ * Chamadas a 'name' que sobram no C gerado: 'x := construtor(args)' é
+ * expandido campo a campo (gen_builder_assign) e não chama a função.
+ */
+static int live_calls(ASTNode *node, char *name) {
+    if (!node) return 0;
+    if (node->type == NODE_ASSIGN && !is_field_assign(node) && node->kind == KIND_SCALAR &&
+        node->left && node->left->type == NODE_FUNC_CALL && strcmp(node->left->strValue, name) == 0) {
+        FuncInfo *callee = find_func(name);
+        ASTNode *args[MAX_PARAMS];
+        int nargs = collect_params(node->left->left, args, MAX_PARAMS);
+        if (callee && callee->build_exprs && builder_args_ok(callee, args, nargs)) {
+            return live_calls(node->left->left, name);
+        }
+    }
+    int n = 0;
+    if ((node->type == NODE_FUNC_CALL || node->type == NODE_PROC_CALL) && strcmp(node->strValue, name) == 0) n = 1;
+    if (node->type == NODE_ACCESS) return n;
+    return n + live_calls(node->left, name) + live_calls(node->right, name) + live_calls(node->extra, name);
+}
+
+/*
+ * 'static', e '__attribute__((unused))' quando nenhuma outra função nem o
+ * main chama a função (chamar só a si mesma não conta): sem isso o gcc -Wall
+ * avisa de funções declaradas e nunca usadas.
+ */
+static void gen_static(ASTNode *node) {
+    int calls = live_calls(main_body, node->strValue);
+    for (FuncInfo *g = func_list; g && !calls; g = g->next) {
+        if (g->def != node) calls = live_calls(g->def->right, node->strValue);
+    }
+    fprintf(f, calls ? "static " : "static __attribute__((unused)) ");
+}
+
+/*
+ * Todas as funções do usuário são 'static' (só o main é visível fora do ficheiro).
+ * As classes const/pure da análise de efeitos viram atributos do gcc, que
+ * então pode eliminar chamadas redundantes e mover chamadas para fora de loops.
+ */
+static void gen_func_specifiers(ASTNode *node) {
+    FuncInfo *fn = find_func(node->strValue);
+    gen_static(node);
+    if (!fn) return;
+
+    /* No C gerado, escrever em ret__ é efeito e ler por ponteiro deixa de ser const.
+       Strings devolvidas são donas de memória nova: duas chamadas não podem virar uma. */
+    if (fn->ret_slot || fn->def->dataType == TYPE_STRING) return;
+    int effect = fn->effect;
+    for (int i = 0; i < fn->nparams; i++) {
+        if (fn->params[i]->passMode == PASS_CONST_PTR && effect == EFFECT_CONST) effect = EFFECT_PURE;
+    }
+
+    if (effect == EFFECT_CONST) fprintf(f, "__attribute__((const)) ");
+    else if (effect == EFFECT_PURE) fprintf(f, "__attribute__((pure)) ");
+}
+
+/*
+ * MEMOIZAÇÃO
+ * O corpo original vira 'nome__impl' e 'nome' passa a ser um invólucro que
+ * consulta a cache na entrada e a preenche no retorno. As chamadas recursivas
+ * do corpo continuam chamando 'nome', então também passam pela cache.
+ *
+ * Cache: tabela de acesso direto quando todos os argumentos são inteiros e
+ * caem no intervalo da tabela (1 parâmetro: [0, 65536); 2 parâmetros: [0, 256)²),
+ * e tabela hash (runtime ezc_memo) para os demais casos.
+ *
+ * Funções memoizadas não recebem atributos const/pure: a cache e os
+ * contadores são estado que o gcc não pode ignorar.
+ */
+static void gen_memo_function(ASTNode *node) {
+    char *name = node->strValue;
+    const char *ret = map_type(node->dataType);
+    ASTNode *params[MAX_PARAMS];
+    int n = collect_params(node->left, params, MAX_PARAMS);
+
+    int direct = (n <= 2) ? n : 0;
+    for (int i = 0; i < n; i++) {
+        if (params[i]->dataType == TYPE_FLOAT) direct = 0;
+    }
+    const char *dim = (direct == 1) ? "EZC_MEMO_DIRECT1" : "EZC_MEMO_DIRECT2";
+
+    /* Protótipo do invólucro (o corpo chama a si mesmo através dele) */
+    fprintf(f, "\n");
+    gen_static(node);
+    gen_func_signature(node, "");
+    fprintf(f, ";\n");
+
+    fprintf(f, "\nstatic ");
+    gen_func_signature(node, "__impl");
+    fprintf(f, " {\n");
+    gen_promoted_locals(current_func);
+    gen_frame_prologue(current_func, node->right);
+    gen_code(node->right);
+    fprintf(f, "}\n");
+
+    fprintf(f, "\nstatic ezc_memo %s__memo = { .name = \"%s\", .nkeys = %d };\n", name, name, n);
+    if (direct == 1) {
+        fprintf(f, "static %s %s__memo_val[%s];\n", ret, name, dim);
+        fprintf(f, "static unsigned char %s__memo_has[%s];\n", name, dim);
+    } else if (direct == 2) {
+        fprintf(f, "static %s %s__memo_val[%s][%s];\n", ret, name, dim, dim);
+        fprintf(f, "static unsigned char %s__memo_has[%s][%s];\n", name, dim, dim);
+    }
+
+    gen_static(node);
+    gen_func_signature(node, "");
+    fprintf(f, " {\n");
+    fprintf(f, "%s r__;\n", ret);
+
+    if (direct) {
+        /* Caminho rápido: índice direto na tabela */
+        fprintf(f, "if (");
+        for (int i = 0; i < n; i++) {
+            fprintf(f, "%s%s >= 0 && %s < %s", i ? " && " : "", params[i]->strValue, params[i]->strValue, dim);
+        }
+        fprintf(f, ") {\n");
+        fprintf(f, "if (%s__memo_has", name);
+        for (int i = 0; i < n; i++) fprintf(f, "[%s]", params[i]->strValue);
+        fprintf(f, ") {\n%s__memo.hits++;\nreturn %s__memo_val", name, name);
+        for (int i = 0; i < n; i++) fprintf(f, "[%s]", params[i]->strValue);
+        fprintf(f, ";\n}\n");
+        fprintf(f, "ezc_memo_miss(&%s__memo);\n", name);
+        fprintf(f, "r__ = %s__impl(", name);
+        for (int i = 0; i < n; i++) fprintf(f, "%s%s", i ? ", " : "", params[i]->strValue);
+        fprintf(f, ");\n");
+        fprintf(f, "%s__memo_has", name);
+        for (int i = 0; i < n; i++) fprintf(f, "[%s]", params[i]->strValue);
+        fprintf(f, " = 1;\n%s__memo_val", name);
+        for (int i = 0; i < n; i++) fprintf(f, "[%s]", params[i]->strValue);
+        fprintf(f, " = r__;\nreturn r__;\n}\n");
+    }
+
+    /* Caminho geral: tabela hash indexada pelo vetor de argumentos */
+    fprintf(f, "long long k__[%d] = { ", n);
+    for (int i = 0; i < n; i++) {
+        if (params[i]->dataType == TYPE_FLOAT) {
+            fprintf(f, "%sezc_memo_fkey(%s)", i ? ", " : "", params[i]->strValue);
+        } else {
+            fprintf(f, "%s%s", i ? ", " : "", params[i]->strValue);
+        }
+    }
+    fprintf(f, " };\n");
+    fprintf(f, "double v__;\n");
+    fprintf(f, "if (ezc_memo_get(&%s__memo, k__, &v__)) {\n%s__memo.hits++;\nreturn (%s) v__;\n}\n", name, name, ret);
+    fprintf(f, "ezc_memo_miss(&%s__memo);\n", name);
+    fprintf(f, "r__ = %s__impl(", name);
+    for (int i = 0; i < n; i++) fprintf(f, "%s%s", i ? ", " : "", params[i]->strValue);
+    fprintf(f, ");\n");
+    fprintf(f, "ezc_memo_put(&%s__memo, k__, r__);\n", name);
+    fprintf(f, "return r__;\n}\n");
+}
+
+/* Verifica se alguma função do programa usa memoização (para emitir o runtime) */
+static int program_uses_memo(void) {
+    for (FuncInfo *fn = func_list; fn != NULL; fn = fn->next) {
+        if (fn->def->memo) return 1;
+    }
+    return 0;
+}
+
+/* Valores string além de literais (que echo e os caminhos de arquivo usam direto)? */
+static int uses_strings(ASTNode *node) {
+    if (!node) return 0;
+    if (node->dataType == TYPE_STRING && node->type != NODE_CONST) return 1;
+    if (node->type == NODE_BIN_OP && node->left && node->left->dataType == TYPE_STRING) return 1;
+    return uses_strings(node->left) || uses_strings(node->right) || uses_strings(node->extra);
+}
+
+/* Algum nó do tipo dado na árvore? (decide quais trechos do runtime emitir) */
+static int uses_node(ASTNode *node, NodeType type) {
+    if (!node) return 0;
+    if (node->type == type) return 1;
+    return uses_node(node->left, type) || uses_node(node->right, type) || uses_node(node->extra, type);
+}
+
+/*
+ * Nomes declarados pelos cabeçalhos POSIX que o runtime inclui (unistd.h,
+ * fcntl.h, sys/mman.h, sys/stat.h e o time.h/sched.h que pthread.h traz).
+ * Uma global ou função do programa com um desses nomes não compilaria
+ * ('int write;' contra 'ssize_t write(...)') ou, ligada, tomaria o lugar da
+ * função da libc que o runtime chama.
+ */
+static const char *posix_names[] = {
+    "access", "alarm", "brk", "chdir", "chown", "close", "dup", "dup2", "environ",
+    "execl", "execle", "execlp", "execv", "execve", "execvp", "fchdir", "fchown",
+    "fdatasync", "fork", "fpathconf", "fsync", "ftruncate", "getcwd", "getegid",
+    "geteuid", "getgid", "getgroups", "gethostname", "getlogin", "getopt", "getpgid",
+    "getpgrp", "getpid", "getppid", "getsid", "getuid", "isatty", "lchown", "link",
+    "lockf", "lseek", "nice", "optarg", "opterr", "optind", "optopt", "pathconf",
+    "pause", "pipe", "pread", "pwrite", "readlink", "rmdir", "sbrk", "setgid",
+    "setpgid", "setsid", "setuid", "sleep", "swab", "symlink", "sync", "sysconf",
+    "tcgetpgrp", "tcsetpgrp", "truncate", "ttyname", "unlink", "usleep", "write",
+    "creat", "fcntl", "open", "openat",
+    "madvise", "mlock", "mlockall", "mmap", "mprotect", "msync", "munlock", "munlockall", "munmap",
+    "chmod", "fchmod", "fstat", "lstat", "mkdir", "mkfifo", "mknod", "stat", "umask",
+    "asctime", "clock", "ctime", "daylight", "difftime", "gmtime", "localtime", "mktime",
+    "nanosleep", "strftime", "time", "timezone", "tzname", "tzset", "sched_yield",
+    NULL
+};
+
+/* Alguma declaração (variável, parâmetro ou função) com esse nome? */
+static int declares_name(ASTNode *node, const char *name) {
+    if (!node) return 0;
+    if ((node->type == NODE_DECL || node->type == NODE_FUNC_DEF) && node->strValue && strcmp(node->strValue, name) == 0) return 1;
+    return declares_name(node->left, name) || declares_name(node->right, name) || declares_name(node->extra, name);
+}
+
+/*
+ * Renomeia, depois do runtime, os nomes do programa que colidem com
+ * posix_names: o runtime já foi compilado com os da libc, e daqui em diante
+ * o pré-processador troca 'write' por 'write__ezc' em declarações e usos.
+ */
+static void gen_posix_renames(ASTNode *root) {
+    int any = 0;
+    for (int i = 0; posix_names[i]; i++) {
+        if (!declares_name(root, posix_names[i])) continue;
+        if (!any) fprintf(f, "\n");
+        fprintf(f, "#define %s %s__ezc\n", posix_names[i], posix_names[i]);
+        any = 1;
+    }
+}
+
+/*
+ * echo() pelo runtime de saída. Sem strings, o tamanho máximo de cada valor é
+ * conhecido: reserva o espaço de todos de uma vez e escreve sem verificar.
+ * A ordem de impressão é a mesma da geração com printf.
+ */
+static void gen_print_buffered(ASTNode *node) {
+    int total = 0, has_str = 0;
+    for (ASTNode *arg = node->left; arg != NULL; arg = (arg->type == NODE_ARG_LIST) ? arg->right : NULL) {
+        ASTNode *val = (arg->type == NODE_ARG_LIST) ? arg->left : arg;
+        if (val->dataType == TYPE_STRING) has_str = 1;
+        else total += (val->dataType == TYPE_FLOAT) ? 19 : 12;
+    }
+    int reserved = !has_str && node->left && node->left->type == NODE_ARG_LIST;
+    if (reserved) fprintf(f, "ezc_out_reserve(%d);\n", total);
+
+    for (ASTNode *arg = node->left; arg != NULL; arg = (arg->type == NODE_ARG_LIST) ? arg->right : NULL) {
+        ASTNode *val = (arg->type == NODE_ARG_LIST) ? arg->left : arg;
+        if (val->dataType == TYPE_STRING && val->type == NODE_CONST) {
+            fprintf(f, "ezc_out_str(%s);\n", val->strValue);
+            continue;
+        }
+        if (val->dataType == TYPE_STRING) fprintf(f, "ezc_out_sv(");
+        else if (val->dataType == TYPE_FLOAT) fprintf(f, reserved ? "ezc_put_float(" : "ezc_out_float(");
+        else fprintf(f, reserved ? "ezc_put_int(" : "ezc_out_int(");
+        gen_code(val);
+        fprintf(f, ");\n");
+    }
+}
+
+/* Dimensão lida em tempo de execução precisa caber no tamanho declarado ('limit' NULL: desconhecido) */
+static void gen_dim_check(const char *var, const char *limit, ASTNode *node) {
+    fprintf(f, "if (%s < 0", var);
+    if (limit) fprintf(f, " || %s > %s", var, limit);
+    fprintf(f, ") ezc_fail(\"ERRO (Linha %d): dimensao %%d invalida para '%s'.\\n\", %s);\n",
+            node->line, node->strValue, var);
+}
+
+/*
+ * read/echo do container inteiro: um laço sobre os elementos (linha a linha
+ * nas matrizes), com o conversor do runtime inline no corpo.
+ */
+static void gen_bulk_io(ASTNode *node) {
+    int is_matrix = node->kind == KIND_MATRIX;
+    int is_float = node->dataType == TYPE_FLOAT;
+    char *v = node->strValue;
+    int dynamic = dynamic_array(v) != NULL;
+
+    /* Limites: tamanho declarado, ou as variáveis de tamanho do array calculado */
+    char rows[300], cols[300];
+    int has_rows = 1, has_cols = 1;
+    if (dynamic) {
+        snprintf(rows, sizeof rows, is_matrix ? "%s__r" : "%s__n", v);
+        snprintf(cols, sizeof cols, "%s__c", v);
+    } else {
+        snprintf(rows, sizeof rows, "%d", node->size1);
+        snprintf(cols, sizeof cols, "%d", node->size2);
+        has_rows = node->size1 > 0;
+        has_cols = node->size2 > 0;
+    }
+
+    fprintf(f, "{\nint r__n = ");
+    gen_code(node->left);
+    fprintf(f, ";\n");
+    if (node->left->type != NODE_CONST || dynamic) gen_dim_check("r__n", has_rows ? rows : NULL, node);
+    if (is_matrix) {
+        fprintf(f, "int c__n = ");
+        gen_code(node->right);
+        fprintf(f, ";\n");
+        if (node->right->type != NODE_CONST || dynamic) gen_dim_check("c__n", has_cols ? cols : NULL, node);
+    }
+
+    char elem[700];
+    if (is_matrix && dynamic) snprintf(elem, sizeof elem, "%s[i__ * %s__c + j__]", v, v);
+    else if (is_matrix) snprintf(elem, sizeof elem, "%s[i__][j__]", v);
+    else snprintf(elem, sizeof elem, "%s[i__]", v);
+
+    fprintf(f, "for (int i__ = 0; i__ < r__n; i__++)\n");
+    if (is_matrix) fprintf(f, "for (int j__ = 0; j__ < c__n; j__++)\n");
+
+    if (node->type == NODE_READ_ALL) {
+        if (!opt_stdio) {
+            fprintf(f, "%s = %s(%s);\n", elem, is_float ? "ezc_read_float" : "ezc_read_int", elem);
+        } else {
+            const char *fmt = is_float ? "%f" : (node->dataType == TYPE_CHAR ? "%hhd" : "%d");
+            fprintf(f, "scanf(\"%s\", &%s);\n", fmt, elem);
+        }
+    } else {
+        if (!opt_stdio) fprintf(f, "%s(%s);\n", is_float ? "ezc_out_float" : "ezc_out_int", elem);
+        else fprintf(f, "printf(\"%s\\n\", %s);\n", is_float ? "%f" : "%d", elem);
+    }
+    fprintf(f, "}\n");
+}
+
+/* Destino de um read(): variável, elemento de array ou de matriz */
+static void gen_read_target(ASTNode *node) {
+    if (node->kind == KIND_ARRAY || node->kind == KIND_MATRIX) {
+        gen_element(node, node->left, node->kind == KIND_MATRIX ? node->right : NULL);
+    } else {
+        gen_var_name(node->strValue);
     }
 }
 
@@ -33,6 +3884,12 @@ const char* map_type(int type) {
 void gen_code(ASTNode *node) {
     if (!node) return;
 
+    /* Valores string viram vistas do runtime de strings */
+    if (node->dataType == TYPE_STRING && is_string_value(node)) {
+        gen_str_view(node);
+        return;
+    }
+
     switch (node->type) {
         /* * NODE_SEQ: Sequenciamento
          * A estrutura da AST para listas de comandos é geralmente:
@@ -51,23 +3908,42 @@ void gen_code(ASTNode *node) {
          */
         case NODE_UNIT_DEF:
             fprintf(f, "struct %s {\n", node->strValue);
+            in_unit_def = 1;
             gen_code(node->left); /* Gera as declarações dos campos internos */
+            in_unit_def = 0;
             fprintf(f, "};\n");
+            if (unit_has_strings(node->strValue)) gen_unit_helpers(find_unit(node->strValue));
             break;
 
         /* * NODE_DECL: Declaração de Variáveis
          * Trata casos especiais como Strings e Arrays.
          */
         case NODE_DECL:
-             if (node->kind == KIND_UNIT) {
+             /* Array de tamanho calculado: o ponteiro já foi declarado na entrada */
+             if (node->left) {
+                 gen_dynamic_alloc(node);
+                 break;
+             }
+             /* Globais promovidas a locais são declaradas dentro da função/main */
+             if (current_func == NULL && find_global(node) != NULL) {
+                 GlobalInfo *g = find_global(node);
+                 if (g->home || g->home_main) break;
+             }
+             if (node->kind == KIND_UNIT && node->scalarized) {
+                gen_scalarized_decl(node, 0);
+             } else if (node->kind == KIND_UNIT) {
                 /* Declaração de instância de struct: struct Ponto p; */
-                fprintf(f, "struct %s %s;\n", node->unitName, node->strValue);
-            } else if (node->dataType == TYPE_STRING && node->kind == KIND_SCALAR) {
-				/* Nota:
-                 * Em C, declarar 'char *s;' não aloca memória para o texto.
-                 * Aqui, forçamos 'char s[256];' para garantir espaço buffer.
-                 */
-				fprintf(f, "char %s[256];\n", node->strValue);
+                fprintf(f, "struct %s %s", node->unitName, node->strValue);
+                /* Campos string locais começam vazios (nunca lixo) */
+                if (current_func && unit_has_strings(node->unitName)) fprintf(f, " = {0}");
+                fprintf(f, ";\n");
+            } else if (node->dataType == TYPE_STRING) {
+				/* Strings do runtime começam vazias; o texto fica no heap ou na própria struct */
+				fprintf(f, "ezc_str %s", node->strValue);
+				if (node->kind == KIND_ARRAY) fprintf(f, "[%d]", node->size1);
+				else if (node->kind == KIND_MATRIX) fprintf(f, "[%d][%d]", node->size1, node->size2);
+				if (!in_unit_def) fprintf(f, node->kind == KIND_SCALAR ? " = {0}" : " = {{0}}");
+				fprintf(f, ";\n");
 			}
 			else {
                 /* Declaração Padrão (int, float...) */
@@ -85,7 +3961,7 @@ void gen_code(ASTNode *node) {
 
         /* Acesso a campos: p1.x */
         case NODE_ACCESS:
-            fprintf(f, "%s.%s", node->strValue, node->extra->strValue);
+            gen_access_lvalue(node);
             break;
 
         /* * NODE_PARAM_LIST: Lista de Parâmetros de Função
@@ -99,8 +3975,19 @@ void gen_code(ASTNode *node) {
 			if (node->left) { 
 				 ASTNode *p = node->left; 
 				 /* Se for Unit (struct), escreve "struct Nome var" */
-				 if (p->dataType == 1000 && p->unitName != NULL) {
+				 if (p->dataType == 1000 && p->unitName != NULL && p->passMode == PASS_CONST_PTR) {
+					 fprintf(f, "const struct %s *%s", p->unitName, p->strValue);
+				 } else if (p->dataType == 1000 && p->unitName != NULL && p->passMode == PASS_REF) {
+					 fprintf(f, "struct %s *%s", p->unitName, p->strValue);
+				 } else if (is_array_param(p)) {
+					 gen_array_param(p);
+				 } else if (p->passMode == PASS_REF) {
+					 fprintf(f, "%s *%s", map_type(p->dataType), p->strValue);
+				 } else if (p->dataType == 1000 && p->unitName != NULL) {
 					 fprintf(f, "struct %s %s", p->unitName, p->strValue);
+				 } else if (p->dataType == TYPE_STRING) {
+					 /* Vista do texto do chamador; a cópia (se houver) é feita na entrada */
+					 fprintf(f, "ezc_sv %s%s", p->strValue, p->passMode == PASS_VIEW ? "" : "__in");
 				 } else {
 					 /* Caso contrario, usa o tipo primitivo */
 					 fprintf(f, "%s %s", map_type(p->dataType), p->strValue); 
@@ -119,13 +4006,46 @@ void gen_code(ASTNode *node) {
          * Verifica se é uma atribuição normal ou em um campo de struct.
          */
         case NODE_ASSIGN:
-            if (node->left && node->left->type == NODE_ACCESS) {
+            if (is_field_assign(node) && node->right->dataType == TYPE_STRING) {
+                 fprintf(f, "ezc_str_set(&");
+                 gen_access_lvalue(node->left);
+                 fprintf(f, ", ");
+                 gen_str_view(node->right);
+                 fprintf(f, ");\n");
+            } else if (is_field_assign(node)) {
                  gen_code(node->left); // Gera o lado esquerdo (ex: p1.x)
                  fprintf(f, " = ");
                  gen_code(node->right);
                  fprintf(f, ";\n");
+            } else if (node->kind != KIND_SCALAR) {
+                 gen_array_assign(node);
+            } else if (node->left->dataType == TYPE_STRING) {
+                 gen_string_assign(node);
+            } else if (gen_builder_assign(node->strValue, node->left)) {
+                 /* Construtor expandido campo a campo */
+            } else if (scalarized_unit(node->strValue)) {
+                 /* Unit substituída: desmonta o valor struct nos escalares */
+                 ASTNode *d = scalarized_unit(node->strValue);
+                 UnitInfo *u = find_unit(d->unitName);
+                 fprintf(f, "{\nstruct %s t__;\n", u->name);
+                 gen_unit_store("&t__", node->left);
+                 for (int k = 0; k < u->nfields; k++) {
+                     fprintf(f, "%s__%s = t__.%s;\n", node->strValue, u->fields[k]->strValue, u->fields[k]->strValue);
+                 }
+                 fprintf(f, "}\n");
+            } else if (slot_call(node->left)) {
+                 /* O resultado é escrito direto na variável de destino */
+                 char dest[300];
+                 snprintf(dest, sizeof dest, unit_ptr_param(node->strValue) ? "%s" : "&%s", node->strValue);
+                 gen_unit_store(dest, node->left);
+            } else if (unit_of(current_func, node->strValue) && unit_has_strings(unit_of(current_func, node->strValue))) {
+                 char dest[300];
+                 snprintf(dest, sizeof dest, unit_ptr_param(node->strValue) ? "%s" : "&%s", node->strValue);
+                 gen_unit_copy(dest, node->left, unit_of(current_func, node->strValue));
             } else {
-                 fprintf(f, "%s = ", node->strValue);
+                 if (unit_ptr_param(node->strValue)) fprintf(f, "(*%s)", node->strValue);
+                 else gen_var_name(node->strValue);
+                 fprintf(f, " = ");
                  gen_code(node->left);
                  fprintf(f, ";\n");
             }
@@ -133,23 +4053,45 @@ void gen_code(ASTNode *node) {
 
         /* Atribuição em Arrays/Matrizes: v[0] = 10 */
         case NODE_ASSIGN_IDX:
-            fprintf(f, "%s[", node->strValue);
-            gen_code(node->left); // Índice 1
-            fprintf(f, "]");
-            if (node->right) { // Índice 2 (se for matriz)
-                fprintf(f, "[");
-                gen_code(node->right);
-                fprintf(f, "]");
+            if (node->extra->dataType == TYPE_STRING) {
+                fprintf(f, "ezc_str_set(&");
+                gen_indexed(node);
+                fprintf(f, ", ");
+                gen_str_view(node->extra);
+                fprintf(f, ");\n");
+                break;
             }
+            gen_element(node, node->left, node->right); // Índice 2 só nas matrizes
             fprintf(f, " = ");
             gen_code(node->extra); // Valor a atribuir
             fprintf(f, ";\n");
             break;
 
         /* Uso de Variável simples */
-        case NODE_VAR:
-            fprintf(f, "%s", node->strValue);
+        case NODE_VAR: {
+            Subst *arg = subst_find(node->strValue);
+            ASTNode *d;
+            if (arg) {
+                gen_subst_arg(arg);
+            } else if (gen_unrolled_var(node->strValue)) {
+                /* Variável de laço desenrolado: constante ou 'i + k' */
+            } else if (unit_ptr_param(node->strValue)) {
+                fprintf(f, "(*%s)", node->strValue);
+            } else if (scalar_ref_param(node->strValue)) {
+                gen_var_name(node->strValue);
+            } else if ((d = scalarized_unit(node->strValue)) != NULL) {
+                /* Unit usada inteira: remonta o valor a partir dos escalares */
+                UnitInfo *u = find_unit(d->unitName);
+                fprintf(f, "((struct %s){ ", u->name);
+                for (int k = 0; k < u->nfields; k++) {
+                    fprintf(f, "%s.%s = %s__%s", k ? ", " : "", u->fields[k]->strValue, node->strValue, u->fields[k]->strValue);
+                }
+                fprintf(f, " })");
+            } else {
+                fprintf(f, "%s", node->strValue);
+            }
             break;
+        }
 
         /* Literais (Números ou Strings fixas no código) */
         case NODE_CONST:
@@ -169,7 +4111,13 @@ void gen_code(ASTNode *node) {
          * Nota: A potência '^' não existe em C, então convertemos para a função 'pow()'.
          */
         case NODE_BIN_OP:
-            if (strcmp(node->strValue, "^") == 0) {
+            if (node->left->dataType == TYPE_STRING) {
+                gen_str_equals(node);
+            }
+            else if (checked_op(node)) {
+                gen_checked_op(node);
+            }
+            else if (strcmp(node->strValue, "^") == 0) {
                 fprintf(f, "pow(");
                 gen_code(node->left);
                 fprintf(f, ", ");
@@ -208,14 +4156,37 @@ void gen_code(ASTNode *node) {
             fprintf(f, "}\n");
             break;
 
-        case NODE_FOR:
-            fprintf(f, "for (%s = ", node->strValue);
+        case NODE_FOR: {
+            if (gen_idiom_loop(node)) break;
+            if (plan_loop_nest(node)) {
+                gen_tiled_nest(node);
+                break;
+            }
+            int unroll = plan_unroll(node);
+            if (unroll) {
+                gen_unrolled_loop(node, unroll);
+                break;
+            }
+            if (opt_bounds_check || opt_checked_arith) enter_loop(node);
+            fprintf(f, "for (");
+            gen_var_name(node->strValue);
+            fprintf(f, " = ");
             gen_code(node->left); // Valor Inicial
-            fprintf(f, "; %s <= ", node->strValue);
+            fprintf(f, "; ");
+            gen_var_name(node->strValue);
+            fprintf(f, " <= ");
             gen_code(node->right); // Condição de paragem
-            fprintf(f, "; %s++) {\n", node->strValue);
+            fprintf(f, "; ");
+            gen_var_name(node->strValue);
+            fprintf(f, "++) {\n");
             gen_code(node->extra); // Corpo do loop
             fprintf(f, "}\n");
+            if (opt_bounds_check || opt_checked_arith) leave_loop();
+            break;
+        }
+
+        case NODE_PARALLEL:
+            gen_parallel(node);
             break;
 		
 		/* Gera: goto label; */
@@ -232,6 +4203,17 @@ void gen_code(ASTNode *node) {
             break;
 		
         case NODE_RETURN:
+            if (current_func && (current_func->ref_cache || current_func->def->dataType == TYPE_STRING || has_frame_cleanup(current_func))) {
+                gen_return(node);
+                break;
+            }
+            if (current_func && current_func->ret_slot) {
+                /* Escreve o resultado no espaço do chamador */
+                fprintf(f, "{\n");
+                gen_unit_store("ret__", node->left);
+                fprintf(f, "return;\n}\n");
+                break;
+            }
             fprintf(f, "return ");
             gen_code(node->left);
             fprintf(f, ";\n");
@@ -239,24 +4221,43 @@ void gen_code(ASTNode *node) {
         
         /* Definição de Funções */
         case NODE_FUNC_DEF:
-            /* Verifica se o retorno é uma Struct (unitName não nulo) */
-            if (node->dataType == 1000 && node->unitName != NULL) {
-                fprintf(f, "\nstruct %s %s(", node->unitName, node->strValue);
+            current_func = find_func(node->strValue);
+            ntemps = 0;
+            number_temps(node->right, 0);
+            if (node->memo) {
+                gen_memo_function(node);
             } else {
-                /* Retorno primitivo (int, float, etc) */
-                fprintf(f, "\n%s %s(", map_type(node->dataType), node->strValue);
+                fprintf(f, "\n");
+                gen_func_specifiers(node);
+                gen_func_signature(node, "");
+                fprintf(f, " {\n");
+                gen_promoted_locals(current_func);
+                if (current_func && current_func->ref_cache) {
+                    ASTNode *r = current_func->ref_cache;
+                    fprintf(f, "%s %s__v = *%s;\n", map_type(r->dataType), r->strValue, r->strValue);
+                }
+                gen_frame_prologue(current_func, node->right);
+                gen_code(node->right); // Gera o corpo
+                if (current_func) gen_frame_cleanup(current_func);
+                if (current_func && current_func->ref_cache) {
+                    char *r = current_func->ref_cache->strValue;
+                    fprintf(f, "*%s = %s__v;\n", r, r);
+                }
+                fprintf(f, "}\n");
             }
-            
-            gen_code(node->left); // Gera os parâmetros
-            fprintf(f, ") {\n");
-            gen_code(node->right); // Gera o corpo
-            fprintf(f, "}\n");
+            current_func = NULL;
             break;
         
         case NODE_FUNC_CALL:
-            fprintf(f, "%s(", node->strValue);
-            gen_code(node->left); // Argumentos
-            fprintf(f, ")");
+            if (slot_call(node)) {
+                /* Unit devolvida usada como valor: temporário numa expressão-comando (gcc) */
+                char *un = find_func(node->strValue)->def->unitName;
+                fprintf(f, "({ struct %s t__%s; ", un, unit_has_strings(un) ? " = {0}" : "");
+                gen_call(node, "&t__");
+                fprintf(f, "; t__; })");
+            } else {
+                gen_call(node, NULL);
+            }
             break;
         
         /* Cast Explícito gerado pelo Parser (ex: int para float) */
@@ -276,21 +4277,32 @@ void gen_code(ASTNode *node) {
             break;
 
         case NODE_ARRAY_ACCESS:
-            fprintf(f, "%s[", node->strValue);
-            gen_code(node->left);
-            fprintf(f, "]");
-            if (node->right) {
-                fprintf(f, "[");
-                gen_code(node->right);
-                fprintf(f, "]");
-            }
+            gen_element(node, node->left, node->right);
             break;
 
-        case NODE_PROC_CALL:
-            fprintf(f, "%s(", node->strValue);
-            gen_code(node->left);
-            fprintf(f, ");\n"); 
+        /* Vista passada a um parâmetro 'arr[]' (só o ponteiro) */
+        case NODE_SLICE:
+            gen_slice_ptr(node);
+            break;
+
+        case NODE_PROC_CALL: {
+            FuncInfo *callee = find_func(node->strValue);
+            if (callee && callee->ret_slot) {
+                /* Resultado ignorado, mas a função precisa de um destino */
+                fprintf(f, "{\nstruct %s t__;\n", callee->def->unitName);
+                gen_call(node, "&t__");
+                fprintf(f, ";\n}\n");
+            } else if (callee && callee->def->dataType == TYPE_STRING) {
+                /* String devolvida e descartada */
+                fprintf(f, "{\nezc_str t__ = ");
+                gen_call(node, NULL);
+                fprintf(f, ";\nezc_str_free(&t__);\n}\n");
+            } else {
+                gen_call(node, NULL);
+                fprintf(f, ";\n");
+            }
             break;
+        }
 
         /* * NODE_READ: Comando de Leitura (scanf)
          * O scanf precisa de:
@@ -298,52 +4310,118 @@ void gen_code(ASTNode *node) {
          * 2. O endereço da variável (&var), exceto se for string (que já é ponteiro).
          */
         case NODE_READ: {
-            char *fmt = "%d";
-            if (node->dataType == TYPE_FLOAT) fmt = "%f";
-            else if (node->dataType == TYPE_STRING) fmt = "%255s"; // Limite de segurança
-            
-            /* Lógica do '&': Inteiros e Floats precisam, Strings/Arrays não */
+            if (!opt_stdio) {
+                /* Runtime de entrada: x = ezc_read_int(x) mantém x se não houver número */
+                if (node->dataType == TYPE_STRING) {
+                    fprintf(f, "ezc_read_str(&");
+                    gen_read_target(node);
+                    fprintf(f, ");\n");
+                } else {
+                    const char *fn = node->dataType == TYPE_FLOAT ? "ezc_read_float" : "ezc_read_int";
+                    gen_read_target(node);
+                    fprintf(f, " = %s(", fn);
+                    gen_read_target(node);
+                    fprintf(f, ");\n");
+                }
+                break;
+            }
+
             if (node->dataType == TYPE_STRING) {
-				fprintf(f, "scanf(\"%s\", %s", fmt, node->strValue);
-			} else {
-				fprintf(f, "scanf(\"%s\", &%s", fmt, node->strValue);
-			}
-            
-            /* Adiciona índices de Array/Matriz se necessário */
-            if (node->kind == KIND_ARRAY) {
-                fprintf(f, "[");
-                gen_code(node->left);
-                fprintf(f, "]");
-            } 
-            else if (node->kind == KIND_MATRIX) {
-                fprintf(f, "[");
-                gen_code(node->left); 
-                fprintf(f, "][");
-                gen_code(node->right); 
-                fprintf(f, "]");
+                /* Palavra de qualquer tamanho (scanf aloca) copiada para a string */
+                fprintf(f, "ezc_str_scan(&");
+                gen_read_target(node);
+                fprintf(f, ");\n");
+                break;
             }
 
+            char *fmt = "%d";
+            if (node->dataType == TYPE_FLOAT) fmt = "%f";
+            
+            /* Lógica do '&': Inteiros e Floats precisam */
+            fprintf(f, "scanf(\"%s\", &", fmt);
+            gen_read_target(node);
             fprintf(f, ");\n");
             break;
         }
 
+        /* read(v, n) / echo(A, linhas, colunas): array ou matriz inteiro de uma vez */
+        case NODE_READ_ALL:
+        case NODE_PRINT_ALL:
+            gen_bulk_io(node);
+            break;
+
+        /* Arquivos binários (runtime de arquivos) */
+        case NODE_MAP_OPEN:
+            fprintf(f, "ezc_open_map(");
+            gen_c_path(node->left);
+            fprintf(f, ", %d)", node->line);
+            break;
+
+        case NODE_MAP_CLOSE:
+            fprintf(f, "ezc_close_map(");
+            gen_code(node->left);
+            fprintf(f, ", %d);\n", node->line);
+            break;
+
+        case NODE_LOAD:
+            /* sizeof do array declarado = size1 [x size2] elementos */
+            fprintf(f, "ezc_load(%s, sizeof(%s), ", node->strValue, node->strValue);
+            gen_code(node->left);
+            fprintf(f, ", ");
+            if (node->right) gen_code(node->right);
+            else fprintf(f, "0");
+            fprintf(f, ", \"%s\", %d);\n", node->strValue, node->line);
+            break;
+
+        case NODE_STORE:
+            fprintf(f, "ezc_store(");
+            gen_c_path(node->left);
+            fprintf(f, ", %s, sizeof(%s), %d);\n", node->strValue, node->strValue, node->line);
+            break;
+
+        case NODE_MATRIX_OP:
+            gen_matrix_op(node);
+            break;
+
+        /* len(s): o tamanho fica guardado na string (substr é um valor string, ver gen_str_view);
+           len(v), rows(m), cols(m): tamanho declarado ou as variáveis de tamanho;
+           reduções: ver gen_reduction */
+        case NODE_BUILTIN: {
+            ASTNode *arg = node->left->left;
+            if (is_reduction(node)) {
+                gen_reduction(node);
+            } else if (arg->type == NODE_SLICE) {
+                gen_slice_len(arg);
+            } else if (arg->type == NODE_VAR && arg->kind != KIND_SCALAR) {
+                gen_dim(arg->strValue, strcmp(node->strValue, "cols") == 0);
+            } else if (arg->type == NODE_VAR && !arg->tmp) {
+                fprintf(f, "%s.len", arg->strValue);
+            } else {
+                fprintf(f, "(");
+                gen_str_view(arg);
+                fprintf(f, ").len");
+            }
+            break;
+        }
+
         /* * NODE_PRINT: Comando de Escrita (printf)
          * Itera sobre a lista de argumentos para imprimir.
          */
         case NODE_PRINT: {
+            if (!opt_stdio) {
+                gen_print_buffered(node);
+                break;
+            }
             ASTNode *arg = node->left;
             while (arg != NULL) {
                 ASTNode *val = (arg->type == NODE_ARG_LIST) ? arg->left : arg;
                 
                 /* Seleciona o printf correto baseado no tipo da expressão */
-                if (val->dataType == TYPE_STRING) {
-                    fprintf(f, "printf(\"%%s\\n\", ");
-                    
-                    if (val->type == NODE_CONST) {
-                         fprintf(f, "%s", val->strValue);
-                    } else {
-                         gen_code(val);
-                    }
+                if (val->dataType == TYPE_STRING && val->type == NODE_CONST) {
+                    fprintf(f, "printf(\"%%s\\n\", %s", val->strValue);
+                } else if (val->dataType == TYPE_STRING) {
+                    fprintf(f, "ezc_sv_print(");
+                    gen_str_view(val);
                 } else if (val->dataType == TYPE_FLOAT) {
                     fprintf(f, "printf(\"%%f\\n\", ");
                     gen_code(val);
@@ -394,6 +4472,30 @@ void generate_c_code(ASTNode *root, char *input_filename) {
 	fprintf(f, "#include <string.h>\n");
     fprintf(f, "\n// Codigo gerado pelo compilador\n\n");
 
+    /* Análises do programa inteiro (decidem o que o runtime precisa) */
+    analyze_program(root);
+    int fills = plan_idioms();
+    if (program_uses_memo()) emit_runtime_memo(f);
+    int buffered_out = !opt_stdio && (uses_node(root, NODE_PRINT) || uses_node(root, NODE_PRINT_ALL));
+    if (buffered_out) emit_runtime_output(f);
+    if (needs_fail_runtime(root)) emit_runtime_fail(f);
+    if (uses_strings(root)) emit_runtime_string(f);
+    if (has_dynamic_arrays(root)) emit_runtime_array(f);
+    if (opt_bounds_check) emit_runtime_bounds(f);
+    if (opt_checked_arith) emit_runtime_arith(f);
+    if (uses_reduction(root)) emit_runtime_reduce(f);
+    if (uses_node(root, NODE_MATRIX_OP)) emit_runtime_matrix(f);
+    if (fills) emit_runtime_fill(f);
+    if (!opt_stdio && (uses_node(root, NODE_READ) || uses_node(root, NODE_READ_ALL))) emit_runtime_input(f);
+    if (uses_node(root, NODE_MAP_OPEN) || uses_node(root, NODE_LOAD) || uses_node(root, NODE_STORE)) emit_runtime_files(f);
+    if (uses_node(root, NODE_PARALLEL) && !opt_openmp) emit_runtime_parallel(f);
+    gen_posix_renames(root);
+
+    /* Com o runtime de threads, o programa vai antes para um temporário: os
+       protótipos das funções dos blocos, contadas ao gerá-lo, vêm primeiro */
+    FILE *out = f;
+    if (uses_node(root, NODE_PARALLEL) && !opt_openmp) f = par_tmpfile();
+
     /* 4. Gera o corpo do programa */
     if (root->type == NODE_SEQ) {
         /*
@@ -404,6 +4506,11 @@ void generate_c_code(ASTNode *root, char *input_filename) {
         gen_code(root->left); 
         
         fprintf(f, "\nint main() {\n");
+        if (buffered_out) fprintf(f, "atexit(ezc_out_flush);\n");
+        gen_promoted_locals(NULL);
+        ntemps = 0;
+        number_temps(root->right, 0);
+        gen_frame_prologue(NULL, root->right);
         
         /* Gera o código dentro do main */
         if (root->right && root->right->type == NODE_BLOCK) {
@@ -411,16 +4518,43 @@ void generate_c_code(ASTNode *root, char *input_filename) {
         } else {
              gen_code(root->right);
         }
+        gen_free_dynamic_arrays(root->right);
         
         fprintf(f, "\nreturn 0;\n");
         fprintf(f, "}\n");
     } else {
         /* Caso simples: apenas main */
         fprintf(f, "int main() {\n");
+        if (buffered_out) fprintf(f, "atexit(ezc_out_flush);\n");
+        ntemps = 0;
+        number_temps(root, 0);
+        gen_frame_prologue(NULL, root);
         gen_code(root);
+        gen_free_dynamic_arrays(root);
         fprintf(f, "return 0;\n}\n");
     }
 
+    /* Funções dos parallel for: protótipos, o programa e depois as definições */
+    if (f != out) {
+        FILE *body = f;
+        f = out;
+        fprintf(f, "\n");
+        for (int k = 0; k < npar; k++) fprintf(f, "static void ezc_par_%d(void **, int, int);\n", k);
+        append_tmp(body);
+    }
+    if (par_out) {
+        append_tmp(par_out);
+        par_out = NULL;
+    }
+
     fclose(f);
+    if (opt_bounds_check) {
+        printf("[OTIM] Limites: %d indices; %d provados seguros, %d checados antes do laco, %d checagens restantes.\n",
+               checks_total, checks_proven, checks_hoisted, checks_total - checks_proven - checks_hoisted);
+    }
+    if (opt_checked_arith) {
+        printf("[OTIM] Aritmetica: %d operacoes inteiras; %d provadas seguras, %d conferidas.\n",
+               arith_total, arith_proven, arith_total - arith_proven);
+    }
     printf("Compilacao concluida! Gerado: '%s'\n", output_filename);
 }
\ No newline at end of file
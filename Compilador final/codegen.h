@@ -0,0 +1,19 @@
+#ifndef CODEGEN_H
+#define CODEGEN_H
+
+#include "ast.h"
+
+/*
+ * Opções de linha de comando do compilador.
+ * São preenchidas pelo main (parser.y) antes da geração de código.
+ */
+extern int opt_memo_auto;   /* --memo-auto: memoiza funções recursivas puras sem anotação */
+extern int opt_stdio;       /* --stdio: read()/echo() com scanf/printf em vez do runtime de E/S */
+extern int opt_bounds_check; /* --bounds-check: índices de array conferidos em tempo de execução */
+extern int opt_checked_arith; /* --checked-arith: estouro de int e divisão por zero conferidos */
+extern int opt_openmp;       /* --openmp: parallel for vira '#pragma omp parallel for' em vez do runtime de threads */
+extern int opt_auto_par;     /* --auto-par: 'for' sem dependências entre as voltas vira parallel for */
+
+void generate_c_code(ASTNode *root, char *input_filename);
+
+#endif
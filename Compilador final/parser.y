@@ -4,13 +4,30 @@
   #include <string.h>
   #include "symbol_table.h"
   #include "ast.h"
+  #include "analysis.h"
+  #include "codegen.h"
 
   /* Variável externa contada pelo Flex */
   extern int yylineno;
 
-  void generate_c_code(ASTNode *root, char *filename);
   int yylex(void);
   void yyerror(char *msg);
+  ASTNode* make_bulk_io(NodeType type, char *name, ASTNode *rows, ASTNode *cols);
+  ASTNode* make_print(ASTNode *args);
+  ASTNode* make_file_io(NodeType type, char *name, ASTNode *src, ASTNode *offset);
+  ASTNode* make_builtin(char *name, ASTNode *args);
+  void check_elem_assign(Symbol *sym, ASTNode *value, char *name);
+  ASTNode* make_array_decl(int type, char *name, ASTNode *rows, ASTNode *cols);
+  void check_static_decls(ASTNode *list, const char *where);
+  ASTNode* make_array_param(int type, int kind, char *name);
+  ASTNode* make_slice(char *name, ASTNode *row, ASTNode *start, ASTNode *end);
+  ASTNode* make_array_assign(Symbol *sym, char *name, ASTNode *value);
+  ASTNode* make_matrix_op(char *name, ASTNode *args);
+  void add_par_clause(ASTNode *par, char *name, char *op, ASTNode *items);
+  ASTNode* make_parallel(ASTNode *par, char *var, ASTNode *start, ASTNode *end, ASTNode *body);
+
+  /* Declarações estáticas feitas entre os comandos do main (viram globais) */
+  ASTNode *late_globals = NULL;
 
   ASTNode *root = NULL;
 
@@ -36,8 +53,9 @@
 %token <sValue> STRING_LITERAL 
 %token <fValue> FLOAT_LITERAL
 
-%token UNIT DOT
-%token WHILE DO IF THEN ELSE ELIF FOR TO
+%token UNIT DOT MEMO REF
+%token OPEN_MAP CLOSE_MAP LOAD STORE
+%token WHILE DO IF THEN ELSE ELIF FOR TO PARALLEL
 %token BLOCK_BEGIN BLOCK_END
 %token ASSIGN SEMI RETURN PRINT READ
 %token AND OR POWER
@@ -50,11 +68,13 @@
 %token TYPE_INT TYPE_ARRAY TYPE_CHAR TYPE_STRING TYPE_FLOAT
 
 /* Tipos dos Nós */
-%type <node> program stmt_list stmt expr
+%type <node> program main_list stmt_list stmt expr
 %type <node> globals global_item func_def unit_def unit_feature
 %type <node> declarations declaration
 %type <node> params param_list param
 %type <node> args arg_list
+%type <node> par_clauses par_items par_item
+%type <sValue> par_op
 %type <typeValue> type 
 
 /* Precedência */
@@ -70,11 +90,12 @@
 %%
 
 program:
-    globals stmt_list
+    globals main_list
     {
         ASTNode *mainBlock = create_node(NODE_BLOCK);
         mainBlock->left = $2; 
         
+        if (late_globals != NULL) $1 = ($1 != NULL) ? create_seq($1, late_globals) : late_globals;
         if ($1 != NULL) {
             root = create_seq($1, mainBlock);
         } else {
@@ -101,8 +122,27 @@ globals:
   | /* vazio */ { $$ = NULL; }
   ;
 
+/*
+ * Comandos do main. Declarações podem aparecer depois de comandos: as de
+ * tamanho constante continuam globais; arrays com tamanho calculado
+ * (int v := [n];) são alocados naquele ponto do main.
+ */
+main_list:
+    main_list stmt { $$ = create_seq($1, $2); }
+  | main_list declaration
+    {
+        if ($2->left != NULL) {
+            $$ = create_seq($1, $2);
+        } else {
+            late_globals = (late_globals != NULL) ? create_seq(late_globals, $2) : $2;
+            $$ = $1;
+        }
+    }
+  | stmt { $$ = $1; }
+  ;
+
 global_item:
-    declaration { $$ = $1; }
+    declaration { check_static_decls($1, "global"); $$ = $1; }
   | func_def    { $$ = $1; }
   | unit_def    { $$ = $1; }
   | unit_feature { $$ = $1; } 
@@ -111,6 +151,7 @@ global_item:
 unit_def:
     UNIT ID BLOCK_BEGIN declarations BLOCK_END
     {
+        check_static_decls($4, "campo de unit");
         $$ = create_unit_def($2, $4);
         free($2);
     }
@@ -165,18 +206,16 @@ declaration:
         $$ = create_decl($2, $1, KIND_SCALAR, 0, 0);
         free($2); 
     }
-  /* Caso 2: Array (int v := [10];) */
-  | type ID ASSIGN '[' NUMBER ']' SEMI
+  /* Caso 2: Array (int v := [10]; ou int v := [n];) */
+  | type ID ASSIGN '[' expr ']' SEMI
     {
-        install_symbol($2, $1, KIND_ARRAY, $5, 0);
-        $$ = create_decl($2, $1, KIND_ARRAY, $5, 0);
+        $$ = make_array_decl($1, $2, $5, NULL);
         free($2);
     }
-  /* Caso 3: Matriz (int m := [10][10];) */
-  | type ID ASSIGN '[' NUMBER ']' '[' NUMBER ']' SEMI
+  /* Caso 3: Matriz (int m := [10][10]; ou int m := [r][c];) */
+  | type ID ASSIGN '[' expr ']' '[' expr ']' SEMI
     {
-        install_symbol($2, $1, KIND_MATRIX, $5, $8);
-        $$ = create_decl($2, $1, KIND_MATRIX, $5, $8);
+        $$ = make_array_decl($1, $2, $5, $8);
         free($2);
     }
   ;
@@ -231,6 +270,16 @@ func_def:
         exit_scope(); exit_scope();
         free($2); free($3);
     }
+  /* Função memoizada: memo int fib(int n) begin ... end */
+  | MEMO func_def
+    {
+        if (!memo_signature_ok($2)) {
+            printf("ERRO (Linha %d): Funcao memo '%s' deve retornar int/float/char e receber apenas parametros int/float/char.\n", yylineno, $2->strValue);
+            exit(1);
+        }
+        $2->memo = 1;
+        $$ = $2;
+    }
   ;
 
 params:
@@ -255,6 +304,17 @@ param:
         $$->dataType = $1; /* IMPORTANTE: Salva o tipo para o Codegen usar */
         free($2);
     }
+  /* Array ou matriz com tipo e tamanho: int[] v / float[][] m (o tamanho vem junto do ponteiro) */
+  | type '[' ']' ID
+    {
+        $$ = make_array_param($1, KIND_ARRAY, $4);
+        free($4);
+    }
+  | type '[' ']' '[' ']' ID
+    {
+        $$ = make_array_param($1, KIND_MATRIX, $6);
+        free($6);
+    }
   | UNIT ID ID
     {
         /* Ex: unit rational_r r1 */
@@ -266,8 +326,67 @@ param:
         free($2);
         free($3);
     }
+  /* Parâmetro por referência: ref int r (escritas em r alteram a variável do chamador) */
+  | REF type ID
+    {
+        if ($2 == TYPE_ARRAY || $2 == TYPE_STRING) {
+            printf("ERRO (Linha %d): Parametro ref '%s' deve ser int, float, char ou unit.\n", yylineno, $3);
+            exit(1);
+        }
+        install_symbol($3, $2, KIND_SCALAR, 0, 0);
+        $$ = create_var($3);
+        $$->dataType = $2;
+        $$->passMode = PASS_REF;
+        free($3);
+    }
+  | REF UNIT ID ID
+    {
+        install_symbol($4, 1000, KIND_SCALAR, 0, 0);
+        $$ = create_var($4);
+        $$->dataType = 1000;
+        $$->unitName = strdup($3);
+        $$->passMode = PASS_REF;
+        free($3);
+        free($4);
+    }
     ;
 
+/* Cláusulas do parallel for: reduce(+: s, t), private(x), schedule(dynamic, 64) */
+par_clauses:
+    par_clauses ID '(' par_items ')'
+    {
+        add_par_clause($1, $2, NULL, $4);
+        free($2);
+        $$ = $1;
+    }
+  | par_clauses ID '(' par_op COLON par_items ')'
+    {
+        add_par_clause($1, $2, $4, $6);
+        free($2);
+        free($4);
+        $$ = $1;
+    }
+  | /* vazio */ { $$ = create_node(NODE_PARALLEL); }
+  ;
+
+par_op:
+    '+' { $$ = strdup("+"); }
+  | '-' { $$ = strdup("-"); }
+  | '*' { $$ = strdup("*"); }
+  | '/' { $$ = strdup("/"); }
+  | ID  { $$ = $1; }
+  ;
+
+par_items:
+    par_item               { $$ = create_arg_list($1, NULL); }
+  | par_items ',' par_item { $$ = create_arg_list($3, $1); }
+  ;
+
+par_item:
+    ID     { $$ = create_var($1); free($1); }
+  | NUMBER { $$ = create_const($1); }
+  ;
+
 /* Regra Auxiliar para resolver conflito Shift/Reduce e abrir escopo */
 block_start:
     BLOCK_BEGIN { enter_scope(); }
@@ -295,6 +414,11 @@ stmt:
         }
         $$ = create_for($2, $4, $6, $8); free($2); 
     }
+  | PARALLEL FOR ID ASSIGN expr TO expr par_clauses DO stmt
+    {
+        $$ = make_parallel($8, $3, $5, $7, $10);
+        free($3);
+    }
   | block_start stmt_list BLOCK_END 
     { 
         /* block_start abriu escopo, aqui fechamos */
@@ -308,15 +432,21 @@ stmt:
   | ID '(' args ')' SEMI
     {
         Symbol *sym = lookup_symbol($1);
-        if (!sym || sym->kind != KIND_FUNCTION) { 
+        ASTNode *op = (!sym || sym->kind != KIND_FUNCTION) ? make_matrix_op($1, $3) : NULL;
+        if (op) {
+            $$ = op;
+            free($1);
+        }
+        else if (!sym || sym->kind != KIND_FUNCTION) { 
             printf("ERRO (Linha %d): '%s' nao e uma funcao.\n", yylineno, $1); 
             exit(1); 
         }
-        
-        ASTNode *node = create_node(NODE_PROC_CALL); 
-        node->strValue = $1;
-        node->left = $3; /* args */
-        $$ = node;
+        else {
+            ASTNode *node = create_node(NODE_PROC_CALL); 
+            node->strValue = $1;
+            node->left = $3; /* args */
+            $$ = node;
+        }
     }
   | ID ASSIGN expr SEMI
     {
@@ -325,11 +455,21 @@ stmt:
             printf("ERRO (Linha %d): Variavel '%s' nao declarada.\n", yylineno, $1); 
             exit(1); 
         }
-        if (sym->kind != KIND_SCALAR && sym->kind != KIND_UNIT) { 
-             printf("ERRO (Linha %d): '%s' nao e variavel escalar ou unit.\n", yylineno, $1); 
-             exit(1); 
+        if (sym->kind == KIND_ARRAY || sym->kind == KIND_MATRIX) {
+             /* Array inteiro: 'c := a + b * 2;' */
+             $$ = make_array_assign(sym, $1, $3);
+        }
+        else {
+             if (sym->kind != KIND_SCALAR && sym->kind != KIND_UNIT) { 
+                  printf("ERRO (Linha %d): '%s' nao e variavel escalar ou unit.\n", yylineno, $1); 
+                  exit(1); 
+             }
+             if ((sym->type == TYPE_STRING) != ($3->dataType == TYPE_STRING)) {
+                  printf("ERRO (Linha %d): Atribuicao incompativel para '%s' (string e numero).\n", yylineno, $1);
+                  exit(1);
+             }
+             $$ = create_assign($1, $3);
         }
-        $$ = create_assign($1, $3);
         free($1);
     }
   | ID '[' expr ']' ASSIGN expr SEMI
@@ -339,6 +479,7 @@ stmt:
             printf("ERRO (Linha %d): '%s' nao e um array.\n", yylineno, $1); 
             exit(1); 
         }
+        check_elem_assign(sym, $6, $1);
         $$ = create_assign_idx($1, $3, NULL, $6);
         free($1);
     }
@@ -349,10 +490,11 @@ stmt:
             printf("ERRO (Linha %d): '%s' nao e uma matriz.\n", yylineno, $1); 
             exit(1); 
         }
+        check_elem_assign(sym, $9, $1);
         $$ = create_assign_idx($1, $3, $6, $9);
         free($1);
     }
-  | PRINT '(' args ')' SEMI { $$ = create_print($3); }
+  | PRINT '(' args ')' SEMI { $$ = make_print($3); }
   | READ '(' ID ')' SEMI 
     {
         Symbol *sym = lookup_symbol($3);
@@ -395,6 +537,42 @@ stmt:
         $$ = create_read_matrix($3, $5, $8, sym->type);
         free($3);
     }
+  /* Leitura do container inteiro: read(v, n) e read(A, linhas, colunas) */
+  | READ '(' ID ',' expr ')' SEMI
+    {
+        $$ = make_bulk_io(NODE_READ_ALL, $3, $5, NULL);
+        free($3);
+    }
+  | READ '(' ID ',' expr ',' expr ')' SEMI
+    {
+        $$ = make_bulk_io(NODE_READ_ALL, $3, $5, $7);
+        free($3);
+    }
+  /* Arquivos binários: load(X, h [, deslocamento]), store(X, caminho), close_map(h) */
+  | LOAD '(' ID ',' expr ')' SEMI
+    {
+        $$ = make_file_io(NODE_LOAD, $3, $5, NULL);
+        free($3);
+    }
+  | LOAD '(' ID ',' expr ',' expr ')' SEMI
+    {
+        $$ = make_file_io(NODE_LOAD, $3, $5, $7);
+        free($3);
+    }
+  | STORE '(' ID ',' expr ')' SEMI
+    {
+        $$ = make_file_io(NODE_STORE, $3, $5, NULL);
+        free($3);
+    }
+  | CLOSE_MAP '(' expr ')' SEMI
+    {
+        if ($3->dataType != TYPE_INT) {
+            printf("ERRO (Linha %d): close_map espera o handle devolvido por open_map.\n", yylineno);
+            exit(1);
+        }
+        $$ = create_node(NODE_MAP_CLOSE);
+        $$->left = $3;
+    }
   | ID DOT ID ASSIGN expr SEMI
     {
          ASTNode *acc = create_access($1, $3);
@@ -503,13 +681,17 @@ expr:
     /* --- OPERADORES ARITMÉTICOS (SOMA) --- */
   | expr '+' expr 
     { 
-        /* 1. Verifica Erro de String */
-        if ($1->dataType == TYPE_STRING || $3->dataType == TYPE_STRING) {
+        /* 1. Concatenação de strings; string com número é erro */
+        if ($1->dataType == TYPE_STRING && $3->dataType == TYPE_STRING) {
+             $$ = create_bin_op("+", $1, $3);
+             $$->dataType = TYPE_STRING;
+        }
+        else if ($1->dataType == TYPE_STRING || $3->dataType == TYPE_STRING) {
             printf("ERRO (Linha %d): Nao pode somar um número a uma string", yylineno); exit(1);
         }
         
         /* 2. Coerção: INT + FLOAT -> FLOAT */
-        if ($1->dataType == TYPE_INT && $3->dataType == TYPE_FLOAT) {
+        else if ($1->dataType == TYPE_INT && $3->dataType == TYPE_FLOAT) {
              $$ = create_bin_op("+", create_cast($1, TYPE_FLOAT), $3);
              $$->dataType = TYPE_FLOAT;
         }
@@ -608,6 +790,9 @@ expr:
     { 
         $$ = create_access($1, $3);
         $$->dataType = TYPE_INT; 
+        /* Os campos das units ficam na tabela de símbolos: strings precisam do tipo certo */
+        Symbol *field = lookup_symbol($3);
+        if (field && field->type == TYPE_STRING) $$->dataType = TYPE_STRING;
         free($1); free($3);
     }
   | ID 
@@ -617,41 +802,72 @@ expr:
             printf("ERRO (Linha %d): Variavel '%s' nao encontrada.\n", yylineno, $1);
             exit(1); 
         }
-        if (sym->kind == KIND_MATRIX) { 
-            printf("ERRO (Linha %d): '%s' e matriz, use [][] para acessar.\n", yylineno, $1);
-            exit(1); 
-        }
-
         $$ = create_var($1);
         $$->dataType = sym->type;
         if (sym->kind == KIND_UNIT) $$->kind = KIND_UNIT;
         
         /* Adicionamos isso para o CodeGen saber que é um array sendo passado */
         if (sym->kind == KIND_ARRAY) $$->kind = KIND_ARRAY; 
+        /* Matriz inteira só vale em echo(A, linhas, colunas): a análise rejeita os outros usos */
+        if (sym->kind == KIND_MATRIX) $$->kind = KIND_MATRIX;
 
         free($1);
     }
+  | OPEN_MAP '(' expr ')'
+    {
+        if ($3->dataType != TYPE_STRING) {
+            printf("ERRO (Linha %d): open_map espera o caminho do arquivo (string).\n", yylineno);
+            exit(1);
+        }
+        $$ = create_node(NODE_MAP_OPEN);
+        $$->left = $3;
+        $$->dataType = TYPE_INT;
+    }
   /* Chamada de funcao dentro de expressao (x = f()) - Retorna Valor */
   | ID '(' args ')'
     {
         Symbol *sym = lookup_symbol($1);
-        if (!sym || sym->kind != KIND_FUNCTION) { 
+        ASTNode *builtin = (!sym || sym->kind != KIND_FUNCTION) ? make_builtin($1, $3) : NULL;
+        if (builtin) {
+            $$ = builtin;
+            free($1);
+        }
+        else if (!sym || sym->kind != KIND_FUNCTION) { 
             printf("ERRO (Linha %d): '%s' nao e funcao.\n", yylineno, $1); 
             exit(1); 
         }
-        $$ = create_func_call($1, $3);
-        $$->dataType = sym->type;
-        free($1);
+        else {
+            $$ = create_func_call($1, $3);
+            $$->dataType = sym->type;
+            free($1);
+        }
     }
   | ID '[' expr ']'
     {
         Symbol *sym = lookup_symbol($1);
-        if (!sym || sym->kind != KIND_ARRAY) { 
-            printf("ERRO (Linha %d): '%s' nao e um array.\n", yylineno, $1); 
-            exit(1); 
+        if (sym && sym->kind == KIND_MATRIX) {
+            /* Linha inteira da matriz: vista m[i] */
+            $$ = make_slice($1, $3, NULL, NULL);
+            free($1);
+        } else {
+            if (!sym || sym->kind != KIND_ARRAY) { 
+                printf("ERRO (Linha %d): '%s' nao e um array.\n", yylineno, $1); 
+                exit(1); 
+            }
+            $$ = create_array_access($1, $3, NULL);
+            $$->dataType = sym->type; 
+            free($1);
         }
-        $$ = create_array_access($1, $3, NULL);
-        $$->dataType = sym->type; 
+    }
+  /* Vistas (sem cópia): v[a:b] e m[i][a:b] */
+  | ID '[' expr COLON expr ']'
+    {
+        $$ = make_slice($1, NULL, $3, $5);
+        free($1);
+    }
+  | ID '[' expr ']' '[' expr COLON expr ']'
+    {
+        $$ = make_slice($1, $3, $6, $8);
         free($1);
     }
   | ID '[' expr ']' '[' expr ']'
@@ -683,16 +899,577 @@ void yyerror(char *msg) {
     fprintf(stderr, "Erro de sintaxe na linha %d: %s\n", yylineno, msg);
 }
 
+/*
+ * Declaração de array/matriz. Tamanhos constantes fazem o array estático de
+ * sempre; com alguma expressão, o tamanho é calculado ao executar a
+ * declaração (left/right do nó guardam as expressões) e a memória vem do
+ * heap num bloco único. size1/size2 = 0: tamanho desconhecido na compilação.
+ */
+ASTNode* make_array_decl(int type, char *name, ASTNode *rows, ASTNode *cols) {
+    int kind = cols ? KIND_MATRIX : KIND_ARRAY;
+    if (rows->dataType != TYPE_INT || (cols && cols->dataType != TYPE_INT)) {
+        printf("ERRO (Linha %d): Tamanho de '%s' deve ser inteiro.\n", yylineno, name);
+        exit(1);
+    }
+    int fixed = rows->type == NODE_CONST && (!cols || cols->type == NODE_CONST);
+    if (fixed) {
+        int s1 = rows->intValue, s2 = cols ? cols->intValue : 0;
+        install_symbol(name, type, kind, s1, s2);
+        return create_decl(name, type, kind, s1, s2);
+    }
+    install_symbol(name, type, kind, 0, 0);
+    ASTNode *node = create_decl(name, type, kind, 0, 0);
+    node->left = rows;
+    node->right = cols;
+    return node;
+}
+
+/* Globais e campos de unit precisam de tamanho conhecido na compilação */
+void check_static_decls(ASTNode *list, const char *where) {
+    if (!list) return;
+    if (list->type == NODE_SEQ) {
+        check_static_decls(list->left, where);
+        check_static_decls(list->right, where);
+        return;
+    }
+    if (list->type == NODE_DECL && list->left != NULL) {
+        printf("ERRO (Linha %d): Array %s '%s' precisa de tamanho constante (declare-o depois dos comandos que calculam o tamanho).\n",
+               list->line, where, list->strValue);
+        exit(1);
+    }
+}
+
+/*
+ * Parâmetro array/matriz tipado: o nó guarda o tipo do elemento e o kind,
+ * como um array de tamanho calculado (o tamanho chega com o argumento).
+ */
+ASTNode* make_array_param(int type, int kind, char *name) {
+    if (type != TYPE_INT && type != TYPE_FLOAT && type != TYPE_CHAR) {
+        printf("ERRO (Linha %d): Parametro array '%s' deve ser de int, float ou char.\n", yylineno, name);
+        exit(1);
+    }
+    install_symbol(name, type, kind, 0, 0);
+    ASTNode *node = create_var(name);
+    node->dataType = type;
+    node->kind = kind;
+    return node;
+}
+
+/* Índice de vista constante fora de [0, limite] ('limit' 0: tamanho desconhecido) */
+static void check_slice_bound(ASTNode *e, int limit, char *name) {
+    if (e->dataType != TYPE_INT && e->dataType != TYPE_CHAR) {
+        printf("ERRO (Linha %d): Indices da vista de '%s' devem ser inteiros.\n", yylineno, name);
+        exit(1);
+    }
+    if (e->type == NODE_CONST && (e->intValue < 0 || (limit > 0 && e->intValue > limit))) {
+        printf("ERRO (Linha %d): Indice %d fora de '%s' (tamanho %d).\n", yylineno, e->intValue, name, limit);
+        exit(1);
+    }
+}
+
+/*
+ * Vista de parte de um array, sem cópia: v[a:b] são os elementos a..b-1,
+ * m[i] é a linha i e m[i][a:b] um trecho dela. Só pode ser passada a
+ * parâmetros array e a len (ver check_whole_uses). Índices constantes são
+ * conferidos com o tamanho declarado na tabela de símbolos.
+ */
+ASTNode* make_slice(char *name, ASTNode *row, ASTNode *start, ASTNode *end) {
+    Symbol *sym = lookup_symbol(name);
+    if (!sym || sym->kind != (row ? KIND_MATRIX : KIND_ARRAY)) {
+        printf("ERRO (Linha %d): '%s' nao e %s.\n", yylineno, name, row ? "uma matriz" : "um array");
+        exit(1);
+    }
+    if (sym->type != TYPE_INT && sym->type != TYPE_FLOAT && sym->type != TYPE_CHAR) {
+        printf("ERRO (Linha %d): Vista de '%s' precisa de um array de int, float ou char com tamanho conhecido.\n", yylineno, name);
+        exit(1);
+    }
+    if (row) {
+        check_slice_bound(row, sym->size1, name);
+        if (row->type == NODE_CONST && sym->size1 > 0 && row->intValue == sym->size1) {
+            printf("ERRO (Linha %d): Linha %d fora de '%s' (%d linhas).\n", yylineno, row->intValue, name, sym->size1);
+            exit(1);
+        }
+    }
+    if (start) {
+        int limit = row ? sym->size2 : sym->size1;
+        check_slice_bound(start, limit, name);
+        check_slice_bound(end, limit, name);
+        if (start->type == NODE_CONST && end->type == NODE_CONST && start->intValue > end->intValue) {
+            printf("ERRO (Linha %d): Vista %s[%d:%d] com inicio depois do fim.\n", yylineno, name, start->intValue, end->intValue);
+            exit(1);
+        }
+        /* Os limites aparecem no ponteiro, no tamanho e na checagem: não podem ter efeitos */
+        if (contains_call(start) || contains_call(end)) {
+            printf("ERRO (Linha %d): Limites da vista de '%s' nao podem chamar funcoes.\n", yylineno, name);
+            exit(1);
+        }
+    }
+    ASTNode *node = create_slice(name, row, start, end);
+    node->dataType = sym->type;
+    node->kind = KIND_ARRAY;
+    return node;
+}
+
+/*
+ * Operando de 'v := expr' com v array/matriz: devolve 1 (e marca o nó com o
+ * kind de v) se o valor varia por elemento. Arrays do lado direito precisam
+ * ter a mesma forma de v; tamanhos constantes diferentes são erro aqui, os
+ * calculados são conferidos ao executar.
+ */
+static int elementwise_operand(ASTNode *e, Symbol *dst, char *name) {
+    if (e->type == NODE_VAR && (e->kind == KIND_ARRAY || e->kind == KIND_MATRIX)) {
+        Symbol *sym = lookup_symbol(e->strValue);
+        if (sym->kind != dst->kind) {
+            printf("ERRO (Linha %d): '%s' e '%s' tem formas diferentes (array e matriz).\n", yylineno, e->strValue, name);
+            exit(1);
+        }
+        if (sym->type != TYPE_INT && sym->type != TYPE_FLOAT && sym->type != TYPE_CHAR) {
+            printf("ERRO (Linha %d): '%s' precisa ser array de int, float ou char com tamanho conhecido.\n", yylineno, e->strValue);
+            exit(1);
+        }
+        if ((sym->size1 > 0 && dst->size1 > 0 && sym->size1 != dst->size1) ||
+            (sym->size2 > 0 && dst->size2 > 0 && sym->size2 != dst->size2)) {
+            printf("ERRO (Linha %d): '%s' e '%s' tem tamanhos diferentes.\n", yylineno, e->strValue, name);
+            exit(1);
+        }
+        return 1;
+    }
+    if (e->type == NODE_CAST && elementwise_operand(e->left, dst, name)) {
+        e->kind = dst->kind;
+        return 1;
+    }
+    if (e->type != NODE_BIN_OP) return 0;
+    int l = elementwise_operand(e->left, dst, name);
+    int r = elementwise_operand(e->right, dst, name);
+    if (!l && !r) return 0;
+    if (strcmp(e->strValue, "+") != 0 && strcmp(e->strValue, "-") != 0 &&
+        strcmp(e->strValue, "*") != 0 && strcmp(e->strValue, "/") != 0) {
+        printf("ERRO (Linha %d): Operador '%s' nao vale entre arrays (use + - * /).\n", yylineno, e->strValue);
+        exit(1);
+    }
+    e->kind = dst->kind;
+    return 1;
+}
+
+/*
+ * Atribuição do array/matriz inteiro, elemento a elemento: 'c := a + b * 2;'
+ * ou 'm := m * s;'. Operandos escalares valem para todos os elementos.
+ */
+ASTNode* make_array_assign(Symbol *sym, char *name, ASTNode *value) {
+    if (sym->type != TYPE_INT && sym->type != TYPE_FLOAT && sym->type != TYPE_CHAR) {
+        printf("ERRO (Linha %d): Atribuicao a '%s' inteiro precisa de array de int, float ou char com tamanho conhecido.\n", yylineno, name);
+        exit(1);
+    }
+    if (value->dataType == TYPE_STRING) {
+        printf("ERRO (Linha %d): Atribuicao incompativel para '%s' (string e numero).\n", yylineno, name);
+        exit(1);
+    }
+    elementwise_operand(value, sym, name);
+    ASTNode *node = create_assign(name, value);
+    node->kind = sym->kind;
+    return node;
+}
+
+/* Elemento de array/matriz de strings só recebe string (e os numéricos, só números) */
+void check_elem_assign(Symbol *sym, ASTNode *value, char *name) {
+    if ((sym->type == TYPE_STRING) != (value->dataType == TYPE_STRING)) {
+        printf("ERRO (Linha %d): Atribuicao incompativel para '%s' (string e numero).\n", yylineno, name);
+        exit(1);
+    }
+}
+
+/* Dimensão de E/S em bloco: inteira e, se constante, dentro do tamanho declarado */
+static void check_bulk_dim(ASTNode *e, int declared, char *name) {
+    if (e->dataType != TYPE_INT && e->dataType != TYPE_CHAR) {
+        printf("ERRO (Linha %d): Dimensao de '%s' deve ser inteira.\n", yylineno, name);
+        exit(1);
+    }
+    if (e->type == NODE_CONST && (e->intValue < 0 || (declared > 0 && e->intValue > declared))) {
+        printf("ERRO (Linha %d): Dimensao %d invalida para '%s' (declarado %d).\n", yylineno, e->intValue, name, declared);
+        exit(1);
+    }
+}
+
+/* read/echo do container inteiro: v com n elementos ou A com linhas x colunas */
+ASTNode* make_bulk_io(NodeType type, char *name, ASTNode *rows, ASTNode *cols) {
+    Symbol *sym = lookup_symbol(name);
+    if (!sym) {
+        printf("ERRO (Linha %d): Variavel '%s' nao declarada.\n", yylineno, name);
+        exit(1);
+    }
+    if (cols == NULL && sym->kind != KIND_ARRAY) {
+        printf("ERRO (Linha %d): '%s' nao e um array (uso: %s(v, n)).\n", yylineno, name, type == NODE_READ_ALL ? "read" : "echo");
+        exit(1);
+    }
+    if (cols != NULL && sym->kind != KIND_MATRIX) {
+        printf("ERRO (Linha %d): '%s' nao e uma matriz (uso: %s(A, linhas, colunas)).\n", yylineno, name, type == NODE_READ_ALL ? "read" : "echo");
+        exit(1);
+    }
+    if (sym->type == TYPE_STRING) {
+        printf("ERRO (Linha %d): E/S em bloco nao aceita arrays de string ('%s').\n", yylineno, name);
+        exit(1);
+    }
+    check_bulk_dim(rows, sym->size1, name);
+    if (cols) check_bulk_dim(cols, sym->size2, name);
+
+    /* Parâmetro 'arr[]' é um ponteiro para int sem tamanho conhecido */
+    int elem = (sym->type == TYPE_ARRAY) ? TYPE_INT : sym->type;
+    return create_bulk_io(type, name, elem, sym->kind, sym->size1, sym->size2, rows, cols);
+}
+
+/*
+ * load/store de array ou matriz com tamanho declarado (o arquivo binário tem
+ * exatamente a representação em memória: size1 [x size2] elementos).
+ */
+ASTNode* make_file_io(NodeType type, char *name, ASTNode *src, ASTNode *offset) {
+    const char *op = type == NODE_LOAD ? "load" : "store";
+    Symbol *sym = lookup_symbol(name);
+    if (!sym) {
+        printf("ERRO (Linha %d): Variavel '%s' nao declarada.\n", yylineno, name);
+        exit(1);
+    }
+    if ((sym->kind != KIND_ARRAY && sym->kind != KIND_MATRIX) || sym->size1 <= 0 || sym->type == TYPE_STRING) {
+        printf("ERRO (Linha %d): %s precisa de um array ou matriz de int/float/char com tamanho declarado ('%s').\n", yylineno, op, name);
+        exit(1);
+    }
+    if (type == NODE_LOAD && src->dataType != TYPE_INT) {
+        printf("ERRO (Linha %d): load espera o handle devolvido por open_map.\n", yylineno);
+        exit(1);
+    }
+    if (type == NODE_STORE && src->dataType != TYPE_STRING) {
+        printf("ERRO (Linha %d): store espera o caminho do arquivo (string).\n", yylineno);
+        exit(1);
+    }
+    if (offset && offset->dataType != TYPE_INT) {
+        printf("ERRO (Linha %d): Deslocamento de load deve ser inteiro (bytes).\n", yylineno);
+        exit(1);
+    }
+    return create_bulk_io(type, name, sym->type, sym->kind, sym->size1, sym->size2, src, offset);
+}
+
+/* Operando de sum/min/max/dot/count: array, matriz ou vista de int/float. Devolve o tipo do elemento */
+static int reduction_operand(ASTNode *e, char *name) {
+    int whole = (e->type == NODE_VAR || e->type == NODE_SLICE) && (e->kind == KIND_ARRAY || e->kind == KIND_MATRIX);
+    if (!whole) {
+        printf("ERRO (Linha %d): %s espera um array, matriz ou vista.\n", yylineno, name);
+        exit(1);
+    }
+    if (e->dataType == TYPE_ARRAY) {
+        printf("ERRO (Linha %d): Tamanho de '%s' desconhecido (declare o parametro como int[]).\n", yylineno, e->strValue);
+        exit(1);
+    }
+    if (e->dataType != TYPE_INT && e->dataType != TYPE_FLOAT) {
+        printf("ERRO (Linha %d): %s espera array de int ou float.\n", yylineno, name);
+        exit(1);
+    }
+    return e->dataType;
+}
+
+static int is_comparison(ASTNode *e) {
+    return e->type == NODE_BIN_OP && (strcmp(e->strValue, "==") == 0 || e->strValue[0] == '<' || e->strValue[0] == '>');
+}
+
+/*
+ * Funções embutidas chamadas como funções comuns. Só valem quando o programa
+ * não define uma função com o mesmo nome (devolve NULL nesse caso e para
+ * nomes que não são embutidos).
+ *   len(s)            tamanho da string (O(1))
+ *   substr(s, i, n)   n caracteres a partir de i (vista, sem cópia)
+ */
+ASTNode* make_builtin(char *name, ASTNode *args) {
+    ASTNode *items[MAX_PARAMS];
+    int n = collect_params(args, items, MAX_PARAMS);
+    ASTNode *node = NULL;
+
+    if (strcmp(name, "len") == 0) {
+        /* len(v): elementos do array; len(s): tamanho da string */
+        int array = n == 1 && (items[0]->type == NODE_VAR || items[0]->type == NODE_SLICE) && items[0]->kind == KIND_ARRAY;
+        if (n != 1 || (!array && (items[0]->dataType != TYPE_STRING || items[0]->kind != KIND_SCALAR))) {
+            printf("ERRO (Linha %d): len espera uma string ou um array.\n", yylineno);
+            exit(1);
+        }
+        if (array && items[0]->dataType == TYPE_ARRAY) {
+            printf("ERRO (Linha %d): Tamanho de '%s' desconhecido (declare o parametro como int[]).\n", yylineno, items[0]->strValue);
+            exit(1);
+        }
+        node = create_node(NODE_BUILTIN);
+        node->dataType = TYPE_INT;
+    } else if (strcmp(name, "rows") == 0 || strcmp(name, "cols") == 0) {
+        if (n != 1 || items[0]->type != NODE_VAR || items[0]->kind != KIND_MATRIX) {
+            printf("ERRO (Linha %d): %s espera uma matriz.\n", yylineno, name);
+            exit(1);
+        }
+        node = create_node(NODE_BUILTIN);
+        node->dataType = TYPE_INT;
+    } else if (strcmp(name, "substr") == 0) {
+        if (n != 3 || items[0]->dataType != TYPE_STRING || items[1]->dataType != TYPE_INT || items[2]->dataType != TYPE_INT) {
+            printf("ERRO (Linha %d): substr espera (string, int inicio, int tamanho).\n", yylineno);
+            exit(1);
+        }
+        node = create_node(NODE_BUILTIN);
+        node->dataType = TYPE_STRING;
+    } else if (strcmp(name, "sum") == 0 || strcmp(name, "min") == 0 || strcmp(name, "max") == 0 ||
+               strcmp(name, "argmin") == 0 || strcmp(name, "argmax") == 0) {
+        /* Reduções: valor (tipo do elemento) ou índice do extremo (plano nas matrizes) */
+        if (n != 1) {
+            printf("ERRO (Linha %d): %s espera um array, matriz ou vista.\n", yylineno, name);
+            exit(1);
+        }
+        int type = reduction_operand(items[0], name);
+        node = create_node(NODE_BUILTIN);
+        node->dataType = strncmp(name, "arg", 3) == 0 ? TYPE_INT : type;
+    } else if (strcmp(name, "dot") == 0) {
+        if (n != 2) {
+            printf("ERRO (Linha %d): dot espera dois arrays.\n", yylineno);
+            exit(1);
+        }
+        int type = reduction_operand(items[0], name);
+        if (reduction_operand(items[1], name) != type) {
+            printf("ERRO (Linha %d): dot espera arrays do mesmo tipo.\n", yylineno);
+            exit(1);
+        }
+        node = create_node(NODE_BUILTIN);
+        node->dataType = type;
+    } else if (strcmp(name, "count") == 0) {
+        /* count(v == x): quantos elementos satisfazem a comparação com o escalar */
+        if (n != 1 || !is_comparison(items[0])) {
+            printf("ERRO (Linha %d): count espera uma comparacao, como count(v == x).\n", yylineno);
+            exit(1);
+        }
+        int type = reduction_operand(items[0]->left, name);
+        ASTNode *x = items[0]->right;
+        if (x->kind != KIND_SCALAR || (x->dataType != TYPE_INT && x->dataType != TYPE_CHAR && x->dataType != TYPE_FLOAT) ||
+            (type == TYPE_INT && x->dataType == TYPE_FLOAT)) {
+            printf("ERRO (Linha %d): count compara o array com um numero do mesmo tipo.\n", yylineno);
+            exit(1);
+        }
+        node = create_node(NODE_BUILTIN);
+        node->dataType = TYPE_INT;
+    } else {
+        return NULL;
+    }
+    node->strValue = strdup(name);
+    node->left = args;
+    return node;
+}
+
+/*
+ * matmul/transpose/fill/copy (ver MatrixOp em analysis.h). Dimensões
+ * constantes e matrizes de tamanho constante são conferidas aqui; as
+ * outras, ao executar.
+ */
+ASTNode* make_matrix_op(char *name, ASTNode *args) {
+    const MatrixOp *op = find_matrix_op(name);
+    if (!op) return NULL;
+    ASTNode *items[MAX_PARAMS];
+    Symbol *mats[MAX_MATRIX_DIMS];
+    int n = collect_params(args, items, MAX_PARAMS);
+    int fixed = op->nmats + op->has_value;
+    if (n != fixed && n != fixed + op->ndims) {
+        printf("ERRO (Linha %d): %s espera %d matriz(es)%s e, opcional, %d dimensoes.\n", yylineno, name, op->nmats,
+               op->has_value ? ", um valor" : "", op->ndims);
+        exit(1);
+    }
+    for (int i = 0; i < op->nmats; i++) {
+        ASTNode *e = items[i];
+        if (e->type != NODE_VAR || e->kind != KIND_MATRIX) {
+            printf("ERRO (Linha %d): %s espera matrizes (argumento %d).\n", yylineno, name, i + 1);
+            exit(1);
+        }
+        mats[i] = lookup_symbol(e->strValue);
+        if (e->dataType != TYPE_INT && e->dataType != TYPE_FLOAT) {
+            printf("ERRO (Linha %d): %s espera matrizes de int ou float.\n", yylineno, name);
+            exit(1);
+        }
+        if (e->dataType != items[0]->dataType) {
+            printf("ERRO (Linha %d): %s espera matrizes do mesmo tipo.\n", yylineno, name);
+            exit(1);
+        }
+    }
+    if (op->has_value) {
+        ASTNode *x = items[op->nmats];
+        if (x->kind != KIND_SCALAR || (x->dataType != TYPE_INT && x->dataType != TYPE_FLOAT && x->dataType != TYPE_CHAR)) {
+            printf("ERRO (Linha %d): %s espera um valor numerico.\n", yylineno, name);
+            exit(1);
+        }
+    }
+    for (int d = 0; d < op->ndims; d++) {
+        ASTNode *e = n > fixed ? items[fixed + d] : NULL;
+        if (e && e->dataType != TYPE_INT && e->dataType != TYPE_CHAR) {
+            printf("ERRO (Linha %d): Dimensoes de %s devem ser inteiras.\n", yylineno, name);
+            exit(1);
+        }
+        /* Sem dimensões: o primeiro tamanho da lista, se constante */
+        const int *first = op->limits[d][0];
+        int value = e ? (e->type == NODE_CONST ? e->intValue : -1) : (first[1] ? mats[first[0]]->size2 : mats[first[0]]->size1);
+        if (e && e->type == NODE_CONST && value < 0) {
+            printf("ERRO (Linha %d): Dimensao %d invalida em %s.\n", yylineno, value, name);
+            exit(1);
+        }
+        for (int k = 0; k < 2 && value > 0; k++) {
+            const int *lim = op->limits[d][k];
+            if (lim[0] < 0) break;
+            int size = lim[1] ? mats[lim[0]]->size2 : mats[lim[0]]->size1;
+            if (size > 0 && (e ? value > size : value != size)) {
+                printf("ERRO (Linha %d): Dimensoes incompativeis em %s ('%s' tem %d %s, precisa de %d).\n", yylineno, name,
+                       items[lim[0]]->strValue, size, lim[1] ? "colunas" : "linhas", value);
+                exit(1);
+            }
+        }
+    }
+    ASTNode *node = create_node(NODE_MATRIX_OP);
+    node->strValue = strdup(name);
+    node->left = args;
+    node->dataType = items[0]->dataType;
+    return node;
+}
+
+/*
+ * Cláusulas do parallel for. reduce(op: vars) com op +, *, min ou max sobre
+ * escalares int/float; private(vars) dá a cada thread a sua cópia (sem
+ * valor inicial, e a variável de fora não muda); schedule(static) divide o
+ * intervalo em um bloco por thread (com tamanho, blocos alternados entre as
+ * threads), schedule(dynamic [, bloco]) entrega blocos a quem termina primeiro.
+ */
+void add_par_clause(ASTNode *par, char *name, char *op, ASTNode *items) {
+    ASTNode *list[MAX_PARAMS];
+    int n = collect_params(items, list, MAX_PARAMS);
+    if (strcmp(name, "schedule") == 0) {
+        ASTNode *kind = list[0];
+        int ok = !op && n <= 2 && kind->type == NODE_VAR &&
+                 (strcmp(kind->strValue, "static") == 0 || strcmp(kind->strValue, "dynamic") == 0);
+        if (ok && n == 2) ok = list[1]->type == NODE_CONST && list[1]->intValue > 0;
+        if (!ok) {
+            printf("ERRO (Linha %d): Use schedule(static) ou schedule(dynamic), com o tamanho do bloco opcional: schedule(dynamic, 64).\n", yylineno);
+            exit(1);
+        }
+        par->intValue = kind->strValue[0] == 'd';
+        par->size1 = n == 2 ? list[1]->intValue : 0;
+        return;
+    }
+
+    int code;
+    if (strcmp(name, "private") == 0 && !op) {
+        code = 0;
+    } else if (strcmp(name, "reduce") == 0 && op) {
+        if (strcmp(op, "+") == 0 || strcmp(op, "*") == 0) code = op[0];
+        else if (strcmp(op, "min") == 0) code = 'm';
+        else if (strcmp(op, "max") == 0) code = 'M';
+        else {
+            printf("ERRO (Linha %d): Operacao '%s' invalida em reduce (use +, *, min ou max).\n", yylineno, op);
+            exit(1);
+        }
+    } else {
+        printf("ERRO (Linha %d): Clausula '%s' invalida no parallel for (use reduce(op: vars), private(vars) ou schedule(...)).\n", yylineno, name);
+        exit(1);
+    }
+    for (int i = 0; i < n; i++) {
+        ASTNode *v = list[i];
+        Symbol *sym = v->type == NODE_VAR ? lookup_symbol(v->strValue) : NULL;
+        if (!sym || sym->kind != KIND_SCALAR || (code && sym->type != TYPE_INT && sym->type != TYPE_FLOAT) ||
+            (!code && sym->type != TYPE_INT && sym->type != TYPE_FLOAT && sym->type != TYPE_CHAR)) {
+            printf("ERRO (Linha %d): '%s' em %s precisa ser variavel escalar %s.\n", yylineno,
+                   v->type == NODE_VAR ? v->strValue : "?", name, code ? "int ou float" : "int, float ou char");
+            exit(1);
+        }
+        for (ASTNode *c = par->right; c; c = c->right) {
+            if (strcmp(c->left->strValue, v->strValue) == 0) {
+                printf("ERRO (Linha %d): '%s' aparece em mais de uma clausula do parallel for.\n", yylineno, v->strValue);
+                exit(1);
+            }
+        }
+        v->dataType = sym->type;
+        v->intValue = code;
+        par->right = create_arg_list(v, par->right);
+    }
+}
+
+ASTNode* make_parallel(ASTNode *par, char *var, ASTNode *start, ASTNode *end, ASTNode *body) {
+    Symbol *s = lookup_symbol(var);
+    if (!s || s->kind != KIND_SCALAR || s->type != TYPE_INT) {
+        printf("ERRO (Linha %d): O iterador '%s' do parallel for precisa ser variavel int.\n", yylineno, var);
+        exit(1);
+    }
+    for (ASTNode *c = par->right; c; c = c->right) {
+        if (strcmp(c->left->strValue, var) == 0) {
+            printf("ERRO (Linha %d): O iterador '%s' ja e privado de cada thread; tire-o das clausulas.\n", yylineno, var);
+            exit(1);
+        }
+    }
+    par->left = create_for(var, start, end, body);
+    par->left->line = par->line = yylineno;
+    return par;
+}
+
+/*
+ * echo(...) comum, ou echo(v, n) / echo(A, linhas, colunas) quando o primeiro
+ * argumento é um array ou matriz inteiro. A lista vem invertida: o último
+ * argumento está na cabeça.
+ */
+ASTNode* make_print(ASTNode *args) {
+    ASTNode *items[3];
+    int n = 0;
+    for (ASTNode *a = args; a != NULL && n < 4; a = a->right) {
+        if (n < 3) items[n] = a->left;
+        n++;
+    }
+    ASTNode *first = (n >= 1 && n <= 3) ? items[n - 1] : NULL;
+
+    if (first && first->type == NODE_VAR && first->kind == KIND_ARRAY && n == 2) {
+        return make_bulk_io(NODE_PRINT_ALL, first->strValue, items[0], NULL);
+    }
+    if (first && first->type == NODE_VAR && first->kind == KIND_MATRIX && n == 3) {
+        return make_bulk_io(NODE_PRINT_ALL, first->strValue, items[1], items[0]);
+    }
+    return create_print(args);
+}
+
 extern FILE *yyin;
+
+static void usage(char *prog) {
+    printf("Uso: %s [opcoes] <arquivo_entrada>\n", prog);
+    printf("Opcoes:\n");
+    printf("  --memo-auto    Memoiza automaticamente funcoes recursivas puras\n");
+    printf("  --stdio        Usa scanf/printf em read()/echo() em vez do runtime de E/S\n");
+    printf("  --bounds-check Confere os indices de arrays ao executar (exceto os provados seguros)\n");
+    printf("  --checked-arith Confere estouro de int e divisao por zero ao executar\n");
+    printf("  --openmp       Gera parallel for com OpenMP (compile com gcc -fopenmp) em vez do runtime de threads\n");
+    printf("  --auto-par     Divide entre as threads os for cujas voltas sao independentes\n");
+}
+
 int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        printf("Uso: %s <arquivo_entrada>\n", argv[0]);
+    char *input = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--memo-auto") == 0) {
+            opt_memo_auto = 1;
+        } else if (strcmp(argv[i], "--stdio") == 0) {
+            opt_stdio = 1;
+        } else if (strcmp(argv[i], "--bounds-check") == 0) {
+            opt_bounds_check = 1;
+        } else if (strcmp(argv[i], "--checked-arith") == 0) {
+            opt_checked_arith = 1;
+        } else if (strcmp(argv[i], "--openmp") == 0) {
+            opt_openmp = 1;
+        } else if (strcmp(argv[i], "--auto-par") == 0) {
+            opt_auto_par = 1;
+        } else if (argv[i][0] == '-') {
+            printf("Opcao desconhecida: %s\n", argv[i]);
+            usage(argv[0]);
+            return 1;
+        } else {
+            input = argv[i];
+        }
+    }
+
+    if (input == NULL) {
+        usage(argv[0]);
         return 1;
     }
 
-    FILE *myfile = fopen(argv[1], "r");
+    FILE *myfile = fopen(input, "r");
     if (!myfile) {
-        printf("Erro ao abrir arquivo: %s\n", argv[1]);
+        printf("Erro ao abrir arquivo: %s\n", input);
         return 1;
     }
 
@@ -702,7 +1479,7 @@ int main(int argc, char *argv[]) {
     yyparse();
     
     if (root != NULL) {
-        generate_c_code(root, argv[1]);
+        generate_c_code(root, input);
     }
     
     fclose(myfile);
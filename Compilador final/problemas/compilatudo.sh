@@ -1 +1 @@
-for f in *.c; do gcc "$f" -o "${f%.c}" -lm && echo "SUCESSO: Executável criado: ./$f"; done #compila todos os .c
\ No newline at end of file
+for f in *.c; do gcc "$f" -o "${f%.c}" -lm -pthread && echo "SUCESSO: Executável criado: ./$f"; done #compila todos os .c
\ No newline at end of file
@@ -0,0 +1,46 @@
+#!/bin/bash
+# Testes de regressao: cada teste.ezc e compilado com ../../compilador, executado
+# (com teste.entrada na entrada padrao, se existir) e comparado com teste.esperado:
+# as linhas [OTIM]/[AVISO]/ERRO do compilador (e o codigo de saida dele, se falhar),
+# a saida do programa (stdout e stderr) e o codigo de saida.
+# Opcoes do compilador e variaveis de ambiente vem de comentarios no teste:
+#   /* opcoes: --bounds-check */    /* ambiente: EZC_THREADS=4 */
+# uso: ./rodatestes.sh [teste ...]        ATUALIZA=1 ./rodatestes.sh  (regrava .esperado)
+cd "$(dirname "$0")" || exit 1
+COMP="$(pwd)/../../compilador"
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+if [ $# -gt 0 ]; then testes="$*"; else testes=$(ls *.ezc | sed 's/\.ezc$//'); fi
+falhas=0
+total=0
+for t in $testes; do
+    t=${t%.ezc}
+    total=$((total + 1))
+    opcoes=$(sed -n 's|.*/\* opcoes: \(.*\) \*/.*|\1|p' "$t.ezc" | head -1)
+    ambiente=$(sed -n 's|.*/\* ambiente: \(.*\) \*/.*|\1|p' "$t.ezc" | head -1)
+    entrada=/dev/null
+    [ -f "$t.entrada" ] && entrada="$(pwd)/$t.entrada"
+    cp "$t.ezc" "$TMP/"
+    {
+        (cd "$TMP" && "$COMP" $opcoes "$t.ezc") > "$TMP/$t.log"
+        compilou=$?
+        grep -E '^ *(\[OTIM\]|\[AVISO\]|ERRO)' "$TMP/$t.log" | sed 's/^ *//'
+        if [ $compilou -ne 0 ]; then
+            echo "compilador: $compilou"
+        elif gcc -O2 -w "$TMP/$t.c" -o "$TMP/$t" -lm -pthread; then
+            (cd "$TMP" && env $ambiente timeout 20 "./$t" < "$entrada" 2>&1)
+            echo "saida: $?"
+        fi
+    } > "$TMP/$t.obtido"
+    rm -f "$TMP/$t.c" "$TMP/$t" "$TMP/$t.log"
+    if [ -n "$ATUALIZA" ]; then
+        cp "$TMP/$t.obtido" "$t.esperado"
+    elif ! diff -u "$t.esperado" "$TMP/$t.obtido" > "$TMP/$t.diff" 2>&1; then
+        echo "FALHOU: $t"
+        cat "$TMP/$t.diff"
+        falhas=$((falhas + 1))
+    fi
+done
+echo "$((total - falhas))/$total testes passaram"
+[ $falhas -eq 0 ]
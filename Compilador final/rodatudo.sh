@@ -1,4 +1,4 @@
 rm lex.yy.c y.tab.c y.tab.h
 bison -dy parser.y
 flex lexer.l
-gcc lex.yy.c y.tab.c symbol_table.c ast.c codegen.c -o compilador
\ No newline at end of file
+gcc lex.yy.c y.tab.c symbol_table.c ast.c codegen.c analysis.c runtime.c -o compilador
\ No newline at end of file
@@ -0,0 +1,1112 @@
+#include "runtime.h"
+
+/*
+ * Os trechos ficam como strings para serem copiados literalmente no .c gerado.
+ * Todos os nomes começam com 'ezc_' para não colidir com identificadores do usuário.
+ */
+
+/*
+ * Memoização: tabela hash de endereçamento aberto (sondagem linear).
+ * A chave é o vetor de argumentos (long long por parâmetro) e o valor é guardado
+ * como double, que representa exatamente qualquer int ou float.
+ * Com EZC_MEMO_STATS definido no ambiente, imprime acertos/falhas ao sair.
+ */
+static const char *RUNTIME_MEMO =
+"/* --- Runtime: memoizacao --- */\n"
+"#define EZC_MEMO_DIRECT1 65536\n"
+"#define EZC_MEMO_DIRECT2 256\n"
+"typedef struct ezc_memo {\n"
+"    const char *name;\n"
+"    int nkeys;\n"
+"    long cap, count;\n"
+"    long long *keys;\n"
+"    double *vals;\n"
+"    unsigned char *used;\n"
+"    long long hits, misses;\n"
+"    struct ezc_memo *next;\n"
+"} ezc_memo;\n"
+"\n"
+"static ezc_memo *ezc_memo_all = NULL;\n"
+"\n"
+"static void ezc_memo_report(void) {\n"
+"    if (!getenv(\"EZC_MEMO_STATS\")) return;\n"
+"    for (ezc_memo *m = ezc_memo_all; m != NULL; m = m->next)\n"
+"        fprintf(stderr, \"[memo] %s: %lld acertos, %lld falhas\\n\", m->name, m->hits, m->misses);\n"
+"}\n"
+"\n"
+"static void ezc_memo_register(ezc_memo *m) {\n"
+"    if (ezc_memo_all == NULL) atexit(ezc_memo_report);\n"
+"    m->next = ezc_memo_all;\n"
+"    ezc_memo_all = m;\n"
+"}\n"
+"\n"
+"/* A tabela entra no relatorio na primeira falha */\n"
+"static void ezc_memo_miss(ezc_memo *m) {\n"
+"    if (m->misses++ == 0) ezc_memo_register(m);\n"
+"}\n"
+"\n"
+"__attribute__((unused)) static long long ezc_memo_fkey(float x) {\n"
+"    int bits;\n"
+"    memcpy(&bits, &x, sizeof bits);\n"
+"    return bits;\n"
+"}\n"
+"\n"
+"static unsigned long ezc_memo_hash(const long long *k, int n) {\n"
+"    unsigned long long h = 1469598103934665603ULL;\n"
+"    for (int i = 0; i < n; i++) {\n"
+"        h ^= (unsigned long long) k[i];\n"
+"        h *= 1099511628211ULL;\n"
+"        h ^= h >> 29;\n"
+"    }\n"
+"    return (unsigned long) h;\n"
+"}\n"
+"\n"
+"static long ezc_memo_slot(const ezc_memo *m, const long long *k) {\n"
+"    unsigned long mask = (unsigned long) m->cap - 1;\n"
+"    unsigned long i = ezc_memo_hash(k, m->nkeys) & mask;\n"
+"    while (m->used[i] && memcmp(&m->keys[i * m->nkeys], k, m->nkeys * sizeof(long long)) != 0)\n"
+"        i = (i + 1) & mask;\n"
+"    return (long) i;\n"
+"}\n"
+"\n"
+"static int ezc_memo_get(const ezc_memo *m, const long long *k, double *v) {\n"
+"    if (m->cap == 0) return 0;\n"
+"    long i = ezc_memo_slot(m, k);\n"
+"    if (!m->used[i]) return 0;\n"
+"    *v = m->vals[i];\n"
+"    return 1;\n"
+"}\n"
+"\n"
+"static void ezc_memo_put(ezc_memo *m, const long long *k, double v) {\n"
+"    if ((m->count + 1) * 2 > m->cap) {\n"
+"        ezc_memo old = *m;\n"
+"        m->cap = old.cap ? old.cap * 2 : 1024;\n"
+"        m->count = 0;\n"
+"        m->keys = malloc(m->cap * m->nkeys * sizeof(long long));\n"
+"        m->vals = malloc(m->cap * sizeof(double));\n"
+"        m->used = calloc(m->cap, 1);\n"
+"        if (!m->keys || !m->vals || !m->used) { fprintf(stderr, \"memo: sem memoria\\n\"); exit(1); }\n"
+"        for (long i = 0; i < old.cap; i++)\n"
+"            if (old.used[i]) ezc_memo_put(m, &old.keys[i * old.nkeys], old.vals[i]);\n"
+"        free(old.keys); free(old.vals); free(old.used);\n"
+"    }\n"
+"    long i = ezc_memo_slot(m, k);\n"
+"    if (!m->used[i]) {\n"
+"        m->used[i] = 1;\n"
+"        m->count++;\n"
+"        memcpy(&m->keys[i * m->nkeys], k, m->nkeys * sizeof(long long));\n"
+"    }\n"
+"    m->vals[i] = v;\n"
+"}\n"
+"\n";
+
+/*
+ * Entrada: buffer grande lido com read(2) e conversores escritos à mão.
+ * Cada leitura devolve o valor antigo da variável quando não há número
+ * (fim da entrada ou caractere inválido), como o scanf que não atribui.
+ * Antes de bloquear esperando entrada, a saída pendente é descarregada
+ * (o prompt precisa aparecer antes da leitura).
+ */
+static const char *RUNTIME_INPUT =
+"/* --- Runtime: entrada bufferizada --- */\n"
+"#include <unistd.h>\n"
+"#define EZC_IN_SIZE (1 << 16)\n"
+"static char ezc_in_buf[EZC_IN_SIZE];\n"
+"static int ezc_in_pos = 0, ezc_in_len = 0, ezc_in_eof = 0;\n"
+"\n"
+"/* Garante pelo menos 'need' bytes no buffer (menos se a entrada acabar) */\n"
+"static int ezc_in_ensure(int need) {\n"
+"    if (ezc_in_len - ezc_in_pos >= need || ezc_in_eof) return ezc_in_len - ezc_in_pos;\n"
+"#ifdef EZC_OUT_SIZE\n"
+"    ezc_out_flush();\n"
+"#else\n"
+"    fflush(stdout);\n"
+"#endif\n"
+"    memmove(ezc_in_buf, ezc_in_buf + ezc_in_pos, ezc_in_len - ezc_in_pos);\n"
+"    ezc_in_len -= ezc_in_pos;\n"
+"    ezc_in_pos = 0;\n"
+"    while (ezc_in_len < need && !ezc_in_eof) {\n"
+"        ssize_t r = read(0, ezc_in_buf + ezc_in_len, EZC_IN_SIZE - ezc_in_len);\n"
+"        if (r <= 0) ezc_in_eof = 1;\n"
+"        else ezc_in_len += (int) r;\n"
+"    }\n"
+"    return ezc_in_len - ezc_in_pos;\n"
+"}\n"
+"\n"
+"static inline int ezc_in_peek(void) {\n"
+"    if (ezc_in_pos < ezc_in_len || ezc_in_ensure(1) > 0) return (unsigned char) ezc_in_buf[ezc_in_pos];\n"
+"    return -1;\n"
+"}\n"
+"\n"
+"static inline int ezc_in_space(int c) {\n"
+"    return c == ' ' || c == '\\n' || c == '\\t' || c == '\\r' || c == '\\v' || c == '\\f';\n"
+"}\n"
+"\n"
+"static inline void ezc_in_skip(void) {\n"
+"    int c;\n"
+"    while ((c = ezc_in_peek()) >= 0 && ezc_in_space(c)) ezc_in_pos++;\n"
+"}\n"
+"\n"
+"__attribute__((unused)) static int ezc_read_int(int old) {\n"
+"    ezc_in_skip();\n"
+"    int c = ezc_in_peek(), neg = 0;\n"
+"    if (c == '-' || c == '+') { neg = (c == '-'); ezc_in_pos++; c = ezc_in_peek(); }\n"
+"    if (c < '0' || c > '9') return old;\n"
+"    unsigned v = 0;\n"
+"    while (c >= '0' && c <= '9') { v = v * 10 + (unsigned)(c - '0'); ezc_in_pos++; c = ezc_in_peek(); }\n"
+"    return (int)(neg ? 0u - v : v);\n"
+"}\n"
+"\n"
+"/*\n"
+" * Caminho rápido: mantissa < 2^24 e expoente decimal até 10 são exatos em\n"
+" * float, e uma única multiplicação/divisão arredonda corretamente.\n"
+" * O resto (muitos dígitos, inf, nan, hexadecimal) vai para strtof.\n"
+" * A palavra é analisada no que já está no buffer; só se ela chega ao fim\n"
+" * do buffer é que se lê mais (uma entrada interativa não fica esperando).\n"
+" */\n"
+"__attribute__((unused)) static float ezc_read_float(float old) {\n"
+"    static const float p10[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};\n"
+"    ezc_in_skip();\n"
+"    int len = 0;\n"
+"    for (;;) {\n"
+"        while (ezc_in_pos + len < ezc_in_len && len < 127 && !ezc_in_space((unsigned char) ezc_in_buf[ezc_in_pos + len])) len++;\n"
+"        if (ezc_in_pos + len < ezc_in_len || len >= 127 || ezc_in_ensure(len + 1) <= len) break;\n"
+"    }\n"
+"    if (len == 0) return old;\n"
+"    char *s = ezc_in_buf + ezc_in_pos, *end = s + len, *p = s;\n"
+"    int neg = 0, digits = 0, frac = 0, ex = 0;\n"
+"    unsigned long long m = 0;\n"
+"    if (p < end && (*p == '-' || *p == '+')) neg = (*p++ == '-');\n"
+"    while (p < end && *p >= '0' && *p <= '9') { m = m * 10 + (unsigned)(*p++ - '0'); digits++; }\n"
+"    if (p < end && *p == '.') {\n"
+"        p++;\n"
+"        while (p < end && *p >= '0' && *p <= '9') { m = m * 10 + (unsigned)(*p++ - '0'); digits++; frac++; }\n"
+"    }\n"
+"    int fast = digits > 0 && digits <= 18 && m < (1ull << 24);\n"
+"    if (fast && p < end && (*p == 'e' || *p == 'E')) {\n"
+"        char *q = p + 1;\n"
+"        int eneg = 0, ed = 0;\n"
+"        if (q < end && (*q == '-' || *q == '+')) eneg = (*q++ == '-');\n"
+"        while (q < end && *q >= '0' && *q <= '9' && ed < 4) { ex = ex * 10 + (*q++ - '0'); ed++; }\n"
+"        if (ed == 0) fast = 0;\n"
+"        else { if (eneg) ex = -ex; p = q; }\n"
+"    }\n"
+"    ex -= frac;\n"
+"    if (fast && p < end && ((*p >= '0' && *p <= '9') || *p == 'x' || *p == 'X' || *p == '.')) fast = 0;\n"
+"    if (fast && ex >= -10 && ex <= 10) {\n"
+"        float v = (float) m;\n"
+"        v = ex < 0 ? v / p10[-ex] : v * p10[ex];\n"
+"        ezc_in_pos += (int)(p - s);\n"
+"        return neg ? -v : v;\n"
+"    }\n"
+"    char tmp[128];\n"
+"    int n = 0;\n"
+"    while (s + n < end && n < 127 && !ezc_in_space((unsigned char) s[n])) { tmp[n] = s[n]; n++; }\n"
+"    tmp[n] = '\\0';\n"
+"    char *e;\n"
+"    float v = strtof(tmp, &e);\n"
+"    if (e == tmp) return old;\n"
+"    ezc_in_pos += (int)(e - tmp);\n"
+"    return v;\n"
+"}\n"
+"\n"
+"#ifdef EZC_STR_SSO\n"
+"/* Palavra até o próximo espaço, de qualquer tamanho (copiada do buffer em blocos) */\n"
+"__attribute__((unused)) static void ezc_read_str(ezc_str *dst) {\n"
+"    ezc_in_skip();\n"
+"    if (ezc_in_peek() < 0) return;\n"
+"    dst->len = 0;\n"
+"    for (;;) {\n"
+"        int start = ezc_in_pos;\n"
+"        while (ezc_in_pos < ezc_in_len && !ezc_in_space((unsigned char) ezc_in_buf[ezc_in_pos])) ezc_in_pos++;\n"
+"        ezc_sv part = { ezc_in_buf + start, ezc_in_pos - start, 0 };\n"
+"        ezc_str_append(dst, part);\n"
+"        if (ezc_in_pos < ezc_in_len || ezc_in_ensure(1) <= 0) break;\n"
+"    }\n"
+"}\n"
+"#endif\n"
+"\n";
+
+/*
+ * Saída: buffer de 64 KB descarregado com write(2) quando enche e ao sair
+ * (atexit registrado no início do main). ezc_put_* não verificam espaço:
+ * quem chama reserva antes (um echo com vários valores reserva uma vez só).
+ *
+ * Floats reproduzem o "%f" do printf. Um valor que é float exato com
+ * |v| < 1e9 vezes 1e6 cabe exatamente num double (24 + 14 bits de mantissa),
+ * então rint() dá o mesmo arredondamento do printf; o resto usa snprintf.
+ */
+static const char *RUNTIME_OUTPUT =
+"/* --- Runtime: saida bufferizada --- */\n"
+"#include <unistd.h>\n"
+"#define EZC_OUT_SIZE (1 << 16)\n"
+"static char ezc_out_buf[EZC_OUT_SIZE];\n"
+"static int ezc_out_len = 0;\n"
+"\n"
+"static void ezc_out_flush(void) {\n"
+"    int off = 0;\n"
+"    while (off < ezc_out_len) {\n"
+"        ssize_t w = write(1, ezc_out_buf + off, ezc_out_len - off);\n"
+"        if (w <= 0) break;\n"
+"        off += (int) w;\n"
+"    }\n"
+"    ezc_out_len = 0;\n"
+"}\n"
+"\n"
+"static inline void ezc_out_reserve(int n) {\n"
+"    if (EZC_OUT_SIZE - ezc_out_len < n) ezc_out_flush();\n"
+"}\n"
+"\n"
+"/* Inteiro + '\\n' (até 12 bytes) */\n"
+"static inline void ezc_put_int(int v) {\n"
+"    char tmp[12];\n"
+"    char *p = tmp + 12;\n"
+"    unsigned u = v < 0 ? 0u - (unsigned) v : (unsigned) v;\n"
+"    do { *--p = (char)('0' + u % 10); u /= 10; } while (u);\n"
+"    if (v < 0) *--p = '-';\n"
+"    int n = (int)(tmp + 12 - p);\n"
+"    memcpy(ezc_out_buf + ezc_out_len, p, n);\n"
+"    ezc_out_len += n;\n"
+"    ezc_out_buf[ezc_out_len++] = '\\n';\n"
+"}\n"
+"\n"
+"/* Float + '\\n' no formato %f (caminho rápido: até 19 bytes) */\n"
+"__attribute__((unused)) static void ezc_put_float(double v) {\n"
+"    if ((double)(float) v == v && fabs(v) < 1e9) {\n"
+"        double q = rint(fabs(v) * 1e6);\n"
+"        long long n = (long long) q;\n"
+"        long long ip = n / 1000000;\n"
+"        int fp = (int)(n % 1000000);\n"
+"        char tmp[24];\n"
+"        char *p = tmp + 24;\n"
+"        *--p = '\\n';\n"
+"        for (int i = 0; i < 6; i++) { *--p = (char)('0' + fp % 10); fp /= 10; }\n"
+"        *--p = '.';\n"
+"        do { *--p = (char)('0' + ip % 10); ip /= 10; } while (ip);\n"
+"        if (signbit(v)) *--p = '-';\n"
+"        int len = (int)(tmp + 24 - p);\n"
+"        memcpy(ezc_out_buf + ezc_out_len, p, len);\n"
+"        ezc_out_len += len;\n"
+"        return;\n"
+"    }\n"
+"    char tmp[400];\n"
+"    int len = snprintf(tmp, sizeof tmp, \"%f\\n\", v);\n"
+"    if (len < 0) return;\n"
+"    if (len >= (int) sizeof tmp) len = (int) sizeof tmp - 1;\n"
+"    ezc_out_reserve(len);\n"
+"    memcpy(ezc_out_buf + ezc_out_len, tmp, len);\n"
+"    ezc_out_len += len;\n"
+"}\n"
+"\n"
+"static inline void ezc_out_int(int v) { ezc_out_reserve(12); ezc_put_int(v); }\n"
+"static inline void ezc_out_float(double v) { ezc_out_reserve(19); ezc_put_float(v); }\n"
+"\n"
+"__attribute__((unused)) static void ezc_out_str(const char *s) {\n"
+"    int n = (int) strlen(s);\n"
+"    if (n + 1 > EZC_OUT_SIZE) {\n"
+"        ezc_out_flush();\n"
+"        ezc_out_len = 0;\n"
+"        while (n > 0) { ssize_t w = write(1, s, n); if (w <= 0) break; s += w; n -= (int) w; }\n"
+"        ezc_out_buf[ezc_out_len++] = '\\n';\n"
+"        return;\n"
+"    }\n"
+"    ezc_out_reserve(n + 1);\n"
+"    memcpy(ezc_out_buf + ezc_out_len, s, n);\n"
+"    ezc_out_len += n;\n"
+"    ezc_out_buf[ezc_out_len++] = '\\n';\n"
+"}\n"
+"\n";
+
+/*
+ * Arquivos binários: open_map mapeia o arquivo inteiro (somente leitura) e
+ * devolve um handle; load copia de lá para o array, conferindo que o arquivo
+ * tem bytes suficientes; store grava a memória do array com pwrite.
+ */
+static const char *RUNTIME_FILES =
+"/* --- Runtime: arquivos binarios --- */\n"
+"#include <unistd.h>\n"
+"#include <fcntl.h>\n"
+"#include <sys/mman.h>\n"
+"#include <sys/stat.h>\n"
+"typedef struct { const char *base; size_t size; } ezc_map;\n"
+"static ezc_map *ezc_maps = NULL;\n"
+"static int ezc_nmaps = 0;\n"
+"\n"
+"__attribute__((unused)) static int ezc_open_map(const char *path, int line) {\n"
+"    int fd = open(path, O_RDONLY);\n"
+"    struct stat st;\n"
+"    if (fd < 0 || fstat(fd, &st) < 0) ezc_fail(\"ERRO (Linha %d): nao foi possivel abrir '%s'.\\n\", line, path);\n"
+"    const char *base = NULL;\n"
+"    if (st.st_size > 0) {\n"
+"        void *p = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);\n"
+"        if (p == MAP_FAILED) ezc_fail(\"ERRO (Linha %d): falha ao mapear '%s'.\\n\", line, path);\n"
+"        madvise(p, (size_t) st.st_size, MADV_SEQUENTIAL);\n"
+"        base = (const char *) p;\n"
+"    }\n"
+"    close(fd);\n"
+"    ezc_maps = realloc(ezc_maps, (ezc_nmaps + 1) * sizeof(ezc_map));\n"
+"    ezc_maps[ezc_nmaps].base = base;\n"
+"    ezc_maps[ezc_nmaps].size = (size_t) st.st_size;\n"
+"    return ezc_nmaps++;\n"
+"}\n"
+"\n"
+"__attribute__((unused)) static void ezc_map_check(int h, int line) {\n"
+"    if (h < 0 || h >= ezc_nmaps || (ezc_maps[h].base == NULL && ezc_maps[h].size > 0)) {\n"
+"        ezc_fail(\"ERRO (Linha %d): handle de arquivo invalido (%d).\\n\", line, h);\n"
+"    }\n"
+"}\n"
+"\n"
+"__attribute__((unused)) static void ezc_load(void *dst, size_t bytes, int h, long long off, const char *name, int line) {\n"
+"    ezc_map_check(h, line);\n"
+"    if (off < 0 || (size_t) off > ezc_maps[h].size || ezc_maps[h].size - (size_t) off < bytes) {\n"
+"        ezc_fail(\"ERRO (Linha %d): arquivo com %zu bytes nao tem %zu bytes para '%s' a partir de %lld.\\n\",\n"
+"                 line, ezc_maps[h].size, bytes, name, off);\n"
+"    }\n"
+"    memcpy(dst, ezc_maps[h].base + off, bytes);\n"
+"}\n"
+"\n"
+"__attribute__((unused)) static void ezc_close_map(int h, int line) {\n"
+"    ezc_map_check(h, line);\n"
+"    if (ezc_maps[h].base) munmap((void *) ezc_maps[h].base, ezc_maps[h].size);\n"
+"    ezc_maps[h].base = NULL;\n"
+"    ezc_maps[h].size = 1; /* Marca como fechado */\n"
+"}\n"
+"\n"
+"__attribute__((unused)) static void ezc_store(const char *path, const void *src, size_t bytes, int line) {\n"
+"    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);\n"
+"    if (fd < 0) ezc_fail(\"ERRO (Linha %d): nao foi possivel criar '%s'.\\n\", line, path);\n"
+"    size_t done = 0;\n"
+"    while (done < bytes) {\n"
+"        ssize_t w = pwrite(fd, (const char *) src + done, bytes - done, (off_t) done);\n"
+"        if (w <= 0) ezc_fail(\"ERRO (Linha %d): falha ao gravar '%s'.\\n\", line, path);\n"
+"        done += (size_t) w;\n"
+"    }\n"
+"    close(fd);\n"
+"}\n"
+"\n";
+
+/*
+ * Strings: 'ezc_str' é dona do texto (tamanho, capacidade, hash em cache e
+ * até 15 caracteres guardados na própria struct; acima disso, no heap).
+ * Expressões produzem 'ezc_sv', uma vista (ponteiro + tamanho) que não copia:
+ * variáveis, literais e substr() são vistas do texto original.
+ * O texto de uma ezc_str termina sempre em '\0'.
+ */
+static const char *RUNTIME_STRING =
+"/* --- Runtime: strings --- */\n"
+"#define EZC_STR_SSO 15\n"
+"typedef struct { const char *p; int len; unsigned h; } ezc_sv;\n"
+"typedef struct { int len, cap; unsigned hash; char *heap; char sso[EZC_STR_SSO + 1]; } ezc_str;\n"
+"#define EZC_SV_LIT(lit) ((ezc_sv){ lit, (int)(sizeof(lit) - 1), 0 })\n"
+"\n"
+"static inline char *ezc_str_data(ezc_str *s) { return s->heap ? s->heap : s->sso; }\n"
+"static inline ezc_sv ezc_sv_of(const ezc_str *s) {\n"
+"    ezc_sv v = { s->heap ? s->heap : s->sso, s->len, s->hash };\n"
+"    return v;\n"
+"}\n"
+"\n"
+"static void ezc_str_reserve(ezc_str *s, int need) {\n"
+"    int cap = s->heap ? s->cap : EZC_STR_SSO;\n"
+"    if (need <= cap) return;\n"
+"    int ncap = cap * 2 > need ? cap * 2 : need;\n"
+"    char *p = s->heap ? realloc(s->heap, (size_t) ncap + 1) : malloc((size_t) ncap + 1);\n"
+"    if (!p) { fprintf(stderr, \"string: sem memoria\\n\"); exit(1); }\n"
+"    if (!s->heap) memcpy(p, s->sso, (size_t) s->len + 1);\n"
+"    s->heap = p;\n"
+"    s->cap = ncap;\n"
+"}\n"
+"\n"
+"/* A vista pode apontar para dentro do próprio destino (s := substr(s, ...)) */\n"
+"__attribute__((unused)) static void ezc_str_set(ezc_str *s, ezc_sv v) {\n"
+"    char *d = ezc_str_data(s);\n"
+"    if (v.p >= d && v.p <= d + s->len) {\n"
+"        memmove(d, v.p, (size_t) v.len);\n"
+"    } else {\n"
+"        ezc_str_reserve(s, v.len);\n"
+"        d = ezc_str_data(s);\n"
+"        memcpy(d, v.p, (size_t) v.len);\n"
+"    }\n"
+"    d[v.len] = '\\0';\n"
+"    s->len = v.len;\n"
+"    s->hash = v.h;\n"
+"}\n"
+"\n"
+"__attribute__((unused)) static void ezc_str_append(ezc_str *s, ezc_sv v) {\n"
+"    char *d = ezc_str_data(s);\n"
+"    long off = (v.p >= d && v.p <= d + s->len) ? (long)(v.p - d) : -1;\n"
+"    ezc_str_reserve(s, s->len + v.len);\n"
+"    d = ezc_str_data(s);\n"
+"    memcpy(d + s->len, off >= 0 ? d + off : v.p, (size_t) v.len);\n"
+"    s->len += v.len;\n"
+"    d[s->len] = '\\0';\n"
+"    s->hash = 0;\n"
+"}\n"
+"\n"
+"/* Concatenação de n partes numa string (temporária ou destino), com uma só alocação */\n"
+"__attribute__((unused)) static ezc_sv ezc_str_catn(ezc_str *s, int n, const ezc_sv *parts) {\n"
+"    int total = 0;\n"
+"    for (int i = 0; i < n; i++) total += parts[i].len;\n"
+"    ezc_str_reserve(s, total);\n"
+"    char *d = ezc_str_data(s);\n"
+"    int len = 0;\n"
+"    for (int i = 0; i < n; i++) { memcpy(d + len, parts[i].p, (size_t) parts[i].len); len += parts[i].len; }\n"
+"    d[len] = '\\0';\n"
+"    s->len = len;\n"
+"    s->hash = 0;\n"
+"    return ezc_sv_of(s);\n"
+"}\n"
+"\n"
+"__attribute__((unused)) static void ezc_str_free(ezc_str *s) {\n"
+"    free(s->heap);\n"
+"    s->heap = NULL;\n"
+"    s->len = 0;\n"
+"    s->hash = 0;\n"
+"    s->sso[0] = '\\0';\n"
+"}\n"
+"\n"
+"__attribute__((unused)) static void ezc_str_free_n(ezc_str *s, long n) {\n"
+"    for (long i = 0; i < n; i++) ezc_str_free(&s[i]);\n"
+"}\n"
+"\n"
+"/* Assume o valor devolvido por uma função (sem copiar o texto) */\n"
+"__attribute__((unused)) static void ezc_str_move(ezc_str *dst, ezc_str v) {\n"
+"    free(dst->heap);\n"
+"    *dst = v;\n"
+"}\n"
+"\n"
+"__attribute__((unused)) static ezc_sv ezc_str_take(ezc_str *tmp, ezc_str v) {\n"
+"    ezc_str_move(tmp, v);\n"
+"    return ezc_sv_of(tmp);\n"
+"}\n"
+"\n"
+"/* Cópia numa temporária: a vista original pode ser realocada antes do uso */\n"
+"__attribute__((unused)) static ezc_sv ezc_str_hold(ezc_str *tmp, ezc_sv v) {\n"
+"    ezc_str_set(tmp, v);\n"
+"    return ezc_sv_of(tmp);\n"
+"}\n"
+"\n"
+"__attribute__((unused)) static ezc_str ezc_str_dup(ezc_sv v) {\n"
+"    ezc_str s = {0};\n"
+"    ezc_str_set(&s, v);\n"
+"    return s;\n"
+"}\n"
+"\n"
+"/* FNV-1a; 0 fica reservado para 'ainda não calculado' */\n"
+"static unsigned ezc_hash(const char *p, int n) {\n"
+"    unsigned h = 2166136261u;\n"
+"    for (int i = 0; i < n; i++) { h ^= (unsigned char) p[i]; h *= 16777619u; }\n"
+"    return h ? h : 1;\n"
+"}\n"
+"\n"
+"__attribute__((unused)) static ezc_sv ezc_str_hashed(ezc_str *s) {\n"
+"    if (!s->hash) s->hash = ezc_hash(ezc_str_data(s), s->len);\n"
+"    return ezc_sv_of(s);\n"
+"}\n"
+"\n"
+"static inline int ezc_sv_eq(ezc_sv a, ezc_sv b) {\n"
+"    if (a.len != b.len) return 0;\n"
+"    if (a.h && b.h && a.h != b.h) return 0;\n"
+"    return a.p == b.p || memcmp(a.p, b.p, (size_t) a.len) == 0;\n"
+"}\n"
+"\n"
+"/* substr(s, inicio, n): vista sem cópia, com os limites ajustados ao texto */\n"
+"static inline ezc_sv ezc_sv_sub(ezc_sv v, int i, int n) {\n"
+"    if (i < 0) i = 0;\n"
+"    if (i > v.len) i = v.len;\n"
+"    if (n < 0) n = 0;\n"
+"    if (n > v.len - i) n = v.len - i;\n"
+"    ezc_sv r = { v.p + i, n, 0 };\n"
+"    return r;\n"
+"}\n"
+"\n"
+"/* Cópia terminada em '\\0' para chamadas do sistema (caminhos de arquivo) */\n"
+"__attribute__((unused)) static const char *ezc_sv_cstr(ezc_sv v) {\n"
+"    static char buf[4096];\n"
+"    int n = v.len < (int) sizeof buf - 1 ? v.len : (int) sizeof buf - 1;\n"
+"    memcpy(buf, v.p, (size_t) n);\n"
+"    buf[n] = '\\0';\n"
+"    return buf;\n"
+"}\n"
+"\n"
+"__attribute__((unused)) static void ezc_sv_print(ezc_sv v) {\n"
+"    printf(\"%.*s\\n\", v.len, v.p);\n"
+"}\n"
+"\n"
+"__attribute__((unused)) static void ezc_str_scan(ezc_str *s) {\n"
+"    char *tmp = NULL;\n"
+"    if (scanf(\"%ms\", &tmp) == 1) {\n"
+"        ezc_sv v = { tmp, (int) strlen(tmp), 0 };\n"
+"        ezc_str_set(s, v);\n"
+"        free(tmp);\n"
+"    }\n"
+"}\n"
+"\n"
+"#ifdef EZC_OUT_SIZE\n"
+"__attribute__((unused)) static void ezc_out_sv(ezc_sv v) {\n"
+"    if (v.len + 1 > EZC_OUT_SIZE) {\n"
+"        ezc_out_flush();\n"
+"        const char *p = v.p;\n"
+"        int n = v.len;\n"
+"        while (n > 0) { ssize_t w = write(1, p, n); if (w <= 0) break; p += w; n -= (int) w; }\n"
+"        ezc_out_buf[ezc_out_len++] = '\\n';\n"
+"        return;\n"
+"    }\n"
+"    ezc_out_reserve(v.len + 1);\n"
+"    memcpy(ezc_out_buf + ezc_out_len, v.p, (size_t) v.len);\n"
+"    ezc_out_len += v.len;\n"
+"    ezc_out_buf[ezc_out_len++] = '\\n';\n"
+"}\n"
+"#endif\n"
+"\n";
+
+/*
+ * Arrays com tamanho calculado em tempo de execução: um bloco contíguo e
+ * zerado, alinhado a 64 bytes (linha de cache), com um cabeçalho de 64 bytes
+ * antes dos dados. A partir de 2 MB o bloco vem direto do mmap (já zerado)
+ * e o kernel é avisado de que pode usar páginas grandes.
+ */
+static const char *RUNTIME_ARRAY =
+"/* --- Runtime: arrays dinamicos --- */\n"
+"#include <sys/mman.h>\n"
+"#define EZC_ARRAY_HUGE (1L << 21)\n"
+"typedef struct { size_t bytes; int mapped; char pad[64 - sizeof(size_t) - sizeof(int)]; } ezc_array_hdr;\n"
+"\n"
+"static void ezc_array_free(void *p) {\n"
+"    if (!p) return;\n"
+"    ezc_array_hdr *h = (ezc_array_hdr *) p - 1;\n"
+"    if (h->mapped) munmap(h, h->bytes + sizeof *h);\n"
+"    else free(h);\n"
+"}\n"
+"\n"
+"/* Novo bloco de linhas x colunas elementos (o anterior, se houver, é liberado) */\n"
+"static void *ezc_array_new(void *old, long rows, long cols, size_t elem, const char *name, int line) {\n"
+"    size_t count, bytes;\n"
+"    if (rows < 0 || cols < 0 || __builtin_mul_overflow((size_t) rows, (size_t) cols, &count) ||\n"
+"        __builtin_mul_overflow(count, elem, &bytes)) {\n"
+"        ezc_fail(\"ERRO (Linha %d): tamanho invalido para '%s' (%ld x %ld).\\n\", line, name, rows, cols);\n"
+"    }\n"
+"    ezc_array_free(old);\n"
+"    ezc_array_hdr *h = NULL;\n"
+"    int mapped = bytes >= (size_t) EZC_ARRAY_HUGE;\n"
+"    if (mapped) {\n"
+"        void *m = mmap(NULL, bytes + sizeof *h, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);\n"
+"        if (m != MAP_FAILED) {\n"
+"            h = m;\n"
+"#ifdef MADV_HUGEPAGE\n"
+"            madvise(m, bytes + sizeof *h, MADV_HUGEPAGE);\n"
+"#endif\n"
+"        }\n"
+"    } else {\n"
+"        void *m = NULL;\n"
+"        if (posix_memalign(&m, 64, bytes + sizeof *h) == 0) {\n"
+"            h = m;\n"
+"            memset(h + 1, 0, bytes);\n"
+"        }\n"
+"    }\n"
+"    if (!h) {\n"
+"        ezc_fail(\"ERRO (Linha %d): sem memoria para '%s' (%zu bytes).\\n\", line, name, bytes);\n"
+"    }\n"
+"    h->bytes = bytes;\n"
+"    h->mapped = mapped;\n"
+"    return h + 1;\n"
+"}\n"
+"\n";
+
+/*
+ * Erros em tempo de execução (ERRO (Linha n): ...). A saída bufferizada é
+ * descarregada antes da mensagem: o que o programa já escreveu com echo
+ * aparece inteiro e antes do erro. Vem depois do runtime de saída.
+ */
+static const char *RUNTIME_FAIL =
+"/* --- Runtime: erros em tempo de execucao --- */\n"
+"#include <stdarg.h>\n"
+"__attribute__((cold, noreturn, unused, format(printf, 1, 2))) static void ezc_fail(const char *fmt, ...) {\n"
+"#ifdef EZC_OUT_SIZE\n"
+"    ezc_out_flush();\n"
+"#else\n"
+"    fflush(stdout);\n"
+"#endif\n"
+"    va_list ap;\n"
+"    va_start(ap, fmt);\n"
+"    vfprintf(stderr, fmt, ap);\n"
+"    va_end(ap);\n"
+"    exit(1);\n"
+"}\n"
+"\n";
+
+/*
+ * Checagem de limites (--bounds-check). ezc_idx devolve o próprio índice,
+ * então a checagem fica dentro da expressão de acesso; um único teste sem
+ * sinal cobre i < 0 e i >= n. A falha fica fora do caminho quente (cold).
+ */
+static const char *RUNTIME_BOUNDS =
+"/* --- Runtime: checagem de limites --- */\n"
+"__attribute__((cold, noreturn)) static void ezc_bounds_fail(long i, long n, const char *name, int line) {\n"
+"    ezc_fail(\"ERRO (Linha %d): indice %ld fora de '%s' (tamanho %ld).\\n\", line, i, name, n);\n"
+"}\n"
+"\n"
+"static inline int ezc_idx(int i, int n, const char *name, int line) {\n"
+"    if (__builtin_expect((unsigned) i >= (unsigned) n, 0)) ezc_bounds_fail(i, n, name, line);\n"
+"    return i;\n"
+"}\n"
+"\n"
+"/* Vista [a, b) dentro de [0, n]: devolve a */\n"
+"static inline int ezc_span(int a, int b, int n, const char *name, int line) {\n"
+"    if (__builtin_expect(a < 0 || a > b, 0)) ezc_bounds_fail(a, n, name, line);\n"
+"    if (__builtin_expect(b > n, 0)) ezc_bounds_fail(b, n, name, line);\n"
+"    return a;\n"
+"}\n"
+"\n";
+
+/*
+ * Aritmética inteira conferida (--checked-arith). Cada operação usa os
+ * __builtin_*_overflow do gcc (uma instrução e um salto no caminho comum);
+ * o relato do erro fica fora do caminho quente (cold) e informa a linha.
+ */
+static const char *RUNTIME_ARITH =
+"/* --- Runtime: aritmetica conferida --- */\n"
+"#include <limits.h>\n"
+"__attribute__((cold, noreturn)) static void ezc_arith_fail(const char *what, int line) {\n"
+"    ezc_fail(\"ERRO (Linha %d): %s.\\n\", line, what);\n"
+"}\n"
+"\n"
+"static inline int ezc_add(int a, int b, int line) {\n"
+"    int r;\n"
+"    if (__builtin_expect(__builtin_add_overflow(a, b, &r), 0)) ezc_arith_fail(\"estouro em soma\", line);\n"
+"    return r;\n"
+"}\n"
+"\n"
+"static inline int ezc_sub(int a, int b, int line) {\n"
+"    int r;\n"
+"    if (__builtin_expect(__builtin_sub_overflow(a, b, &r), 0)) ezc_arith_fail(\"estouro em subtracao\", line);\n"
+"    return r;\n"
+"}\n"
+"\n"
+"static inline int ezc_mul(int a, int b, int line) {\n"
+"    int r;\n"
+"    if (__builtin_expect(__builtin_mul_overflow(a, b, &r), 0)) ezc_arith_fail(\"estouro em multiplicacao\", line);\n"
+"    return r;\n"
+"}\n"
+"\n"
+"static inline int ezc_div(int a, int b, int line) {\n"
+"    if (__builtin_expect(b == 0, 0)) ezc_arith_fail(\"divisao por zero\", line);\n"
+"    if (__builtin_expect(b == -1 && a == INT_MIN, 0)) ezc_arith_fail(\"estouro em divisao\", line);\n"
+"    return a / b;\n"
+"}\n"
+"\n"
+"/* Soma/produto de reducao (long long) de volta para int */\n"
+"static inline int ezc_narrow(long long x, int line) {\n"
+"    if (__builtin_expect(x < INT_MIN || x > INT_MAX, 0)) ezc_arith_fail(\"estouro em reducao\", line);\n"
+"    return (int) x;\n"
+"}\n"
+"\n"
+"/* a ^ b inteiro, por quadrados sucessivos; expoente negativo trunca como (int) pow() */\n"
+"static inline int ezc_pow(int a, int b, int line) {\n"
+"    if (b < 0) {\n"
+"        if (a == 0) ezc_arith_fail(\"divisao por zero\", line);\n"
+"        if (a == 1) return 1;\n"
+"        if (a == -1) return (b & 1) ? -1 : 1;\n"
+"        return 0;\n"
+"    }\n"
+"    int r = 1;\n"
+"    while (b) {\n"
+"        if ((b & 1) && __builtin_mul_overflow(r, a, &r)) ezc_arith_fail(\"estouro em potencia\", line);\n"
+"        b >>= 1;\n"
+"        if (b && __builtin_mul_overflow(a, a, &a)) ezc_arith_fail(\"estouro em potencia\", line);\n"
+"    }\n"
+"    return r;\n"
+"}\n"
+"\n";
+
+/*
+ * Reduções (sum, min, max, argmin, argmax, dot, count). Cada laço usa
+ * EZC_LANES acumuladores independentes, então não há dependência de uma
+ * volta para a seguinte e o gcc vetoriza sem -ffast-math. A soma de floats
+ * fica associada por faixa (pode diferir do laço sequencial no último bit).
+ * Somas e produtos de int acumulam em long long.
+ */
+static const char *RUNTIME_REDUCE =
+"/* --- Runtime: reducoes --- */\n"
+"#define EZC_LANES 8\n"
+"\n"
+"__attribute__((cold, noreturn)) static void ezc_reduce_fail(const char *what, int line) {\n"
+"    ezc_fail(\"ERRO (Linha %d): %s.\\n\", line, what);\n"
+"}\n"
+"\n"
+"/* Soma com EZC_LANES acumuladores independentes (o gcc junta em registradores SIMD) */\n"
+"#define EZC_SUM(name, T, A) \\\n"
+"__attribute__((unused)) static A name(const T *v, int n) { \\\n"
+"    A acc[EZC_LANES] = { 0 }; \\\n"
+"    int i = 0; \\\n"
+"    for (; i + EZC_LANES <= n; i += EZC_LANES) \\\n"
+"        for (int k = 0; k < EZC_LANES; k++) acc[k] += v[i + k]; \\\n"
+"    for (; i < n; i++) acc[0] += v[i]; \\\n"
+"    A s = 0; \\\n"
+"    for (int k = 0; k < EZC_LANES; k++) s += acc[k]; \\\n"
+"    return s; \\\n"
+"}\n"
+"EZC_SUM(ezc_sum_i, int, long long)\n"
+"EZC_SUM(ezc_sum_f, float, float)\n"
+"\n"
+"#define EZC_DOT(name, T, A) \\\n"
+"__attribute__((unused)) static A name(const T *a, int na, const T *b, int nb, int line) { \\\n"
+"    if (na != nb) ezc_reduce_fail(\"dot com tamanhos diferentes\", line); \\\n"
+"    A acc[EZC_LANES] = { 0 }; \\\n"
+"    int i = 0; \\\n"
+"    for (; i + EZC_LANES <= na; i += EZC_LANES) \\\n"
+"        for (int k = 0; k < EZC_LANES; k++) acc[k] += (A) a[i + k] * b[i + k]; \\\n"
+"    for (; i < na; i++) acc[0] += (A) a[i] * b[i]; \\\n"
+"    A s = 0; \\\n"
+"    for (int k = 0; k < EZC_LANES; k++) s += acc[k]; \\\n"
+"    return s; \\\n"
+"}\n"
+"EZC_DOT(ezc_dot_i, int, long long)\n"
+"EZC_DOT(ezc_dot_f, float, float)\n"
+"\n"
+"/* min/max: o primeiro elemento inicia todas as faixas; argmin/argmax e o primeiro indice do extremo */\n"
+"#define EZC_BEST(what, T, s, op) \\\n"
+"__attribute__((unused)) static T ezc_##what##_##s(const T *v, int n, int line) { \\\n"
+"    if (n <= 0) ezc_reduce_fail(\"reducao sobre array vazio\", line); \\\n"
+"    T acc[EZC_LANES]; \\\n"
+"    for (int k = 0; k < EZC_LANES; k++) acc[k] = v[0]; \\\n"
+"    int i = 0; \\\n"
+"    for (; i + EZC_LANES <= n; i += EZC_LANES) \\\n"
+"        for (int k = 0; k < EZC_LANES; k++) acc[k] = v[i + k] op acc[k] ? v[i + k] : acc[k]; \\\n"
+"    for (; i < n; i++) acc[0] = v[i] op acc[0] ? v[i] : acc[0]; \\\n"
+"    T m = acc[0]; \\\n"
+"    for (int k = 1; k < EZC_LANES; k++) m = acc[k] op m ? acc[k] : m; \\\n"
+"    return m; \\\n"
+"} \\\n"
+"__attribute__((unused)) static int ezc_arg##what##_##s(const T *v, int n, int line) { \\\n"
+"    T m = ezc_##what##_##s(v, n, line); \\\n"
+"    for (int i = 0; i < n; i++) \\\n"
+"        if (v[i] == m) return i; \\\n"
+"    return 0; \\\n"
+"}\n"
+"EZC_BEST(min, int, i, <)\n"
+"EZC_BEST(max, int, i, >)\n"
+"EZC_BEST(min, float, f, <)\n"
+"EZC_BEST(max, float, f, >)\n"
+"\n"
+"/* count(v op x): cada comparacao soma 0 ou 1 na sua faixa */\n"
+"#define EZC_COUNT(name, T, op) \\\n"
+"__attribute__((unused)) static int name(const T *v, int n, T x) { \\\n"
+"    int acc[EZC_LANES] = { 0 }; \\\n"
+"    int i = 0; \\\n"
+"    for (; i + EZC_LANES <= n; i += EZC_LANES) \\\n"
+"        for (int k = 0; k < EZC_LANES; k++) acc[k] += v[i + k] op x; \\\n"
+"    for (; i < n; i++) acc[0] += v[i] op x; \\\n"
+"    int c = 0; \\\n"
+"    for (int k = 0; k < EZC_LANES; k++) c += acc[k]; \\\n"
+"    return c; \\\n"
+"}\n"
+"EZC_COUNT(ezc_count_eq_i, int, ==)\n"
+"EZC_COUNT(ezc_count_lt_i, int, <)\n"
+"EZC_COUNT(ezc_count_le_i, int, <=)\n"
+"EZC_COUNT(ezc_count_gt_i, int, >)\n"
+"EZC_COUNT(ezc_count_ge_i, int, >=)\n"
+"EZC_COUNT(ezc_count_eq_f, float, ==)\n"
+"EZC_COUNT(ezc_count_lt_f, float, <)\n"
+"EZC_COUNT(ezc_count_le_f, float, <=)\n"
+"EZC_COUNT(ezc_count_gt_f, float, >)\n"
+"EZC_COUNT(ezc_count_ge_f, float, >=)\n"
+"\n";
+
+/*
+ * Operações de matriz (matmul, transpose, fill, copy), uma versão para int
+ * e outra para float. Cada matriz chega como primeiro elemento e passo da
+ * linha (colunas declaradas), então o mesmo núcleo serve matrizes fixas,
+ * calculadas e blocos n x m menores que a declaração. Destino igual a uma
+ * entrada é calculado num bloco temporário.
+ */
+static const char *RUNTIME_MATRIX =
+"/* --- Runtime: operacoes de matriz --- */\n"
+"#define EZC_TILE 64\n"
+"\n"
+"/* Bloco temporario para destino que tambem e entrada */\n"
+"static void *ezc_matrix_tmp(size_t bytes) {\n"
+"    void *p = malloc(bytes ? bytes : 1);\n"
+"    if (!p) {\n"
+"        ezc_fail(\"ERRO: sem memoria para matriz temporaria (%zu bytes).\\n\", bytes);\n"
+"    }\n"
+"    return p;\n"
+"}\n"
+"\n"
+"/*\n"
+" * R = A * B por blocos de EZC_TILE em k e j (o bloco de B fica na cache) e\n"
+" * quatro linhas de R por vez (cada B[k][j] lido serve as quatro). O laço\n"
+" * interno em j e contiguo e vetoriza. Para cada R[i][j] os termos somam na\n"
+" * ordem de k, como no laco i-j-k.\n"
+" */\n"
+"#define EZC_MATRIX_OPS(s, T) \\\n"
+"static void ezc_matmul_tiles_##s(T *restrict r, int sr, const T *restrict a, int sa, const T *restrict b, int sb, int n, int m, int p) { \\\n"
+"    for (int i = 0; i < n; i++) \\\n"
+"        for (int j = 0; j < p; j++) r[(long) i * sr + j] = 0; \\\n"
+"    for (int kk = 0; kk < m; kk += EZC_TILE) { \\\n"
+"        int k1 = kk + EZC_TILE < m ? kk + EZC_TILE : m; \\\n"
+"        for (int jj = 0; jj < p; jj += EZC_TILE) { \\\n"
+"            int j1 = jj + EZC_TILE < p ? jj + EZC_TILE : p; \\\n"
+"            int i = 0; \\\n"
+"            for (; i + 4 <= n; i += 4) { \\\n"
+"                T *r0 = r + (long) i * sr, *r1 = r0 + sr, *r2 = r1 + sr, *r3 = r2 + sr; \\\n"
+"                const T *a0 = a + (long) i * sa, *a1 = a0 + sa, *a2 = a1 + sa, *a3 = a2 + sa; \\\n"
+"                for (int k = kk; k < k1; k++) { \\\n"
+"                    const T *bk = b + (long) k * sb; \\\n"
+"                    T x0 = a0[k], x1 = a1[k], x2 = a2[k], x3 = a3[k]; \\\n"
+"                    for (int j = jj; j < j1; j++) { \\\n"
+"                        T y = bk[j]; \\\n"
+"                        r0[j] += x0 * y; \\\n"
+"                        r1[j] += x1 * y; \\\n"
+"                        r2[j] += x2 * y; \\\n"
+"                        r3[j] += x3 * y; \\\n"
+"                    } \\\n"
+"                } \\\n"
+"            } \\\n"
+"            for (; i < n; i++) { \\\n"
+"                T *ri = r + (long) i * sr; \\\n"
+"                for (int k = kk; k < k1; k++) { \\\n"
+"                    const T *bk = b + (long) k * sb; \\\n"
+"                    T x = a[(long) i * sa + k]; \\\n"
+"                    for (int j = jj; j < j1; j++) ri[j] += x * bk[j]; \\\n"
+"                } \\\n"
+"            } \\\n"
+"        } \\\n"
+"    } \\\n"
+"} \\\n"
+"\\\n"
+"__attribute__((unused)) static void ezc_matmul_##s(T *r, int sr, const T *a, int sa, const T *b, int sb, int n, int m, int p) { \\\n"
+"    if (r != a && r != b) { \\\n"
+"        ezc_matmul_tiles_##s(r, sr, a, sa, b, sb, n, m, p); \\\n"
+"        return; \\\n"
+"    } \\\n"
+"    T *t = ezc_matrix_tmp((size_t) n * p * sizeof(T)); \\\n"
+"    ezc_matmul_tiles_##s(t, p, a, sa, b, sb, n, m, p); \\\n"
+"    for (int i = 0; i < n; i++) memcpy(r + (long) i * sr, t + (long) i * p, (size_t) p * sizeof(T)); \\\n"
+"    free(t); \\\n"
+"} \\\n"
+"\\\n"
+"/* T[m][n] = A[n][m] transposta, em ladrilhos (leitura e escrita ficam na cache) */ \\\n"
+"static void ezc_transpose_tiles_##s(T *restrict t, int st, const T *restrict a, int sa, int n, int m) { \\\n"
+"    for (int ii = 0; ii < n; ii += EZC_TILE) \\\n"
+"        for (int jj = 0; jj < m; jj += EZC_TILE) { \\\n"
+"            int i1 = ii + EZC_TILE < n ? ii + EZC_TILE : n; \\\n"
+"            int j1 = jj + EZC_TILE < m ? jj + EZC_TILE : m; \\\n"
+"            for (int i = ii; i < i1; i++) \\\n"
+"                for (int j = jj; j < j1; j++) t[(long) j * st + i] = a[(long) i * sa + j]; \\\n"
+"        } \\\n"
+"} \\\n"
+"\\\n"
+"__attribute__((unused)) static void ezc_transpose_##s(T *t, int st, const T *a, int sa, int n, int m) { \\\n"
+"    if (t != a) { \\\n"
+"        ezc_transpose_tiles_##s(t, st, a, sa, n, m); \\\n"
+"        return; \\\n"
+"    } \\\n"
+"    T *w = ezc_matrix_tmp((size_t) m * n * sizeof(T)); \\\n"
+"    ezc_transpose_tiles_##s(w, n, a, sa, n, m); \\\n"
+"    for (int j = 0; j < m; j++) memcpy(t + (long) j * st, w + (long) j * n, (size_t) n * sizeof(T)); \\\n"
+"    free(w); \\\n"
+"} \\\n"
+"\\\n"
+"__attribute__((unused)) static void ezc_fill_##s(T *restrict a, int sa, T x, int n, int m) { \\\n"
+"    for (int i = 0; i < n; i++) { \\\n"
+"        T *ai = a + (long) i * sa; \\\n"
+"        for (int j = 0; j < m; j++) ai[j] = x; \\\n"
+"    } \\\n"
+"} \\\n"
+"\\\n"
+"__attribute__((unused)) static void ezc_copy_##s(T *d, int sd, const T *src, int ss, int n, int m) { \\\n"
+"    if (d == src) return; \\\n"
+"    if (sd == m && ss == m) { \\\n"
+"        memcpy(d, src, (size_t) n * m * sizeof(T)); \\\n"
+"        return; \\\n"
+"    } \\\n"
+"    for (int i = 0; i < n; i++) memcpy(d + (long) i * sd, src + (long) i * ss, (size_t) m * sizeof(T)); \\\n"
+"}\n"
+"EZC_MATRIX_OPS(i, int)\n"
+"EZC_MATRIX_OPS(f, float)\n"
+"\n";
+
+/*
+ * Preenchimento de trecho de array com um valor ou com a sequência x, x+1,
+ * ... (laços reconhecidos como idiomas; zeros e cópias usam memset/memcpy).
+ */
+static const char *RUNTIME_FILL =
+"/* --- Runtime: preenchimento (lacos reconhecidos) --- */\n"
+"/* Oito elementos por volta, que o gcc grava com registradores SIMD */\n"
+"#define EZC_FILL(s, T) \\\n"
+"__attribute__((unused)) static void ezc_set_##s(T *restrict p, T x, int n) { \\\n"
+"    int i = 0; \\\n"
+"    for (; i + 8 <= n; i += 8) \\\n"
+"        for (int k = 0; k < 8; k++) p[i + k] = x; \\\n"
+"    for (; i < n; i++) p[i] = x; \\\n"
+"} \\\n"
+"__attribute__((unused)) static void ezc_iota_##s(T *restrict p, int x, int n) { \\\n"
+"    int i = 0; \\\n"
+"    for (; i + 8 <= n; i += 8) \\\n"
+"        for (int k = 0; k < 8; k++) p[i + k] = (T) (x + i + k); \\\n"
+"    for (; i < n; i++) p[i] = (T) (x + i); \\\n"
+"}\n"
+"EZC_FILL(i, int)\n"
+"EZC_FILL(f, float)\n"
+"\n";
+
+/*
+ * Parallel for: pool de threads criado na primeira chamada (EZC_THREADS ou o
+ * número de processadores). Cada laço é uma função que faz as voltas a..b;
+ * no modo estático cada thread faz um bloco contíguo (ou pedaços de 'chunk'
+ * voltas alternados entre as threads), no dinâmico as threads
+ * pegam pedaços de 'chunk' voltas num contador atômico. Quem chama trabalha
+ * como thread 0 e espera as outras. Um parallel for chamado de dentro de
+ * outro, ou com menos de 'min' voltas, roda sequencial na thread que o
+ * chamou.
+ */
+static const char *RUNTIME_PARALLEL =
+"/* --- Runtime: parallel for --- */\n"
+"#include <pthread.h>\n"
+"#include <unistd.h>\n"
+"#include <limits.h>\n"
+"typedef void (*ezc_par_fn)(void **c, int a, int b);\n"
+"static struct {\n"
+"    pthread_mutex_t lock;\n"
+"    pthread_cond_t go, done;\n"
+"    int nthreads, round, running;\n"
+"    ezc_par_fn fn;\n"
+"    void **ctx;\n"
+"    int a, b, chunk, dynamic;\n"
+"    long next;\n"
+"} ezc_pool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };\n"
+"static pthread_mutex_t ezc_par_mutex = PTHREAD_MUTEX_INITIALIZER;\n"
+"static __thread int ezc_par_inside = 0;\n"
+"\n"
+"static void ezc_par_work(int id) {\n"
+"    long a = ezc_pool.a, n = (long) ezc_pool.b - a + 1;\n"
+"    ezc_par_inside = 1;\n"
+"    if (!ezc_pool.dynamic && ezc_pool.chunk <= 0) {\n"
+"        long lo = a + n * id / ezc_pool.nthreads, hi = a + n * (id + 1) / ezc_pool.nthreads;\n"
+"        if (lo < hi) ezc_pool.fn(ezc_pool.ctx, (int) lo, (int) (hi - 1));\n"
+"    } else if (!ezc_pool.dynamic) {\n"
+"        for (long k = (long) id * ezc_pool.chunk; k < n; k += (long) ezc_pool.nthreads * ezc_pool.chunk) {\n"
+"            long hi = k + ezc_pool.chunk < n ? k + ezc_pool.chunk : n;\n"
+"            ezc_pool.fn(ezc_pool.ctx, (int) (a + k), (int) (a + hi - 1));\n"
+"        }\n"
+"    } else {\n"
+"        long k;\n"
+"        while ((k = __atomic_fetch_add(&ezc_pool.next, ezc_pool.chunk, __ATOMIC_RELAXED)) < n) {\n"
+"            long hi = k + ezc_pool.chunk < n ? k + ezc_pool.chunk : n;\n"
+"            ezc_pool.fn(ezc_pool.ctx, (int) (a + k), (int) (a + hi - 1));\n"
+"        }\n"
+"    }\n"
+"    ezc_par_inside = 0;\n"
+"}\n"
+"\n"
+"static void *ezc_par_thread(void *arg) {\n"
+"    int id = (int) (long) arg, seen = 0;\n"
+"    for (;;) {\n"
+"        pthread_mutex_lock(&ezc_pool.lock);\n"
+"        while (ezc_pool.round == seen) pthread_cond_wait(&ezc_pool.go, &ezc_pool.lock);\n"
+"        seen = ezc_pool.round;\n"
+"        pthread_mutex_unlock(&ezc_pool.lock);\n"
+"        ezc_par_work(id);\n"
+"        pthread_mutex_lock(&ezc_pool.lock);\n"
+"        if (--ezc_pool.running == 0) pthread_cond_signal(&ezc_pool.done);\n"
+"        pthread_mutex_unlock(&ezc_pool.lock);\n"
+"    }\n"
+"    return NULL;\n"
+"}\n"
+"\n"
+"static void ezc_par_start(void) {\n"
+"    const char *env = getenv(\"EZC_THREADS\");\n"
+"    long n = env ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);\n"
+"    if (n < 1) n = 1;\n"
+"    if (n > 256) n = 256;\n"
+"    ezc_pool.nthreads = (int) n;\n"
+"    for (long i = 1; i < n; i++) {\n"
+"        pthread_t t;\n"
+"        pthread_attr_t attr;\n"
+"        pthread_attr_init(&attr);\n"
+"        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);\n"
+"        if (pthread_create(&t, &attr, ezc_par_thread, (void *) i) != 0) ezc_pool.nthreads = (int) i;\n"
+"        pthread_attr_destroy(&attr);\n"
+"        if (ezc_pool.nthreads == i) break;\n"
+"    }\n"
+"}\n"
+"\n"
+"__attribute__((unused)) static void ezc_par_for(ezc_par_fn fn, void **ctx, int a, int b, int dynamic, int chunk, int min) {\n"
+"    if (a > b) return;\n"
+"    if (!ezc_pool.nthreads && (long) b - a + 1 >= min) ezc_par_start();\n"
+"    if (ezc_par_inside || ezc_pool.nthreads <= 1 || (long) b - a + 1 < min) {\n"
+"        fn(ctx, a, b);\n"
+"        return;\n"
+"    }\n"
+"    long n = (long) b - a + 1;\n"
+"    if (dynamic && chunk <= 0) chunk = n / ((long) ezc_pool.nthreads * 16) > 0 ? (int) (n / ((long) ezc_pool.nthreads * 16)) : 1;\n"
+"    pthread_mutex_lock(&ezc_pool.lock);\n"
+"    ezc_pool.fn = fn;\n"
+"    ezc_pool.ctx = ctx;\n"
+"    ezc_pool.a = a;\n"
+"    ezc_pool.b = b;\n"
+"    ezc_pool.dynamic = dynamic;\n"
+"    ezc_pool.chunk = chunk;\n"
+"    ezc_pool.next = 0;\n"
+"    ezc_pool.running = ezc_pool.nthreads - 1;\n"
+"    ezc_pool.round++;\n"
+"    pthread_cond_broadcast(&ezc_pool.go);\n"
+"    pthread_mutex_unlock(&ezc_pool.lock);\n"
+"    ezc_par_work(0);\n"
+"    pthread_mutex_lock(&ezc_pool.lock);\n"
+"    while (ezc_pool.running > 0) pthread_cond_wait(&ezc_pool.done, &ezc_pool.lock);\n"
+"    pthread_mutex_unlock(&ezc_pool.lock);\n"
+"}\n"
+"\n";
+
+void emit_runtime_memo(FILE *out) {
+    fputs(RUNTIME_MEMO, out);
+}
+
+void emit_runtime_input(FILE *out) {
+    fputs(RUNTIME_INPUT, out);
+}
+
+void emit_runtime_output(FILE *out) {
+    fputs(RUNTIME_OUTPUT, out);
+}
+
+void emit_runtime_files(FILE *out) {
+    fputs(RUNTIME_FILES, out);
+}
+
+void emit_runtime_string(FILE *out) {
+    fputs(RUNTIME_STRING, out);
+}
+
+void emit_runtime_array(FILE *out) {
+    fputs(RUNTIME_ARRAY, out);
+}
+
+void emit_runtime_fail(FILE *out) {
+    fputs(RUNTIME_FAIL, out);
+}
+
+void emit_runtime_bounds(FILE *out) {
+    fputs(RUNTIME_BOUNDS, out);
+}
+
+void emit_runtime_arith(FILE *out) {
+    fputs(RUNTIME_ARITH, out);
+}
+
+void emit_runtime_reduce(FILE *out) {
+    fputs(RUNTIME_REDUCE, out);
+}
+
+void emit_runtime_matrix(FILE *out) {
+    fputs(RUNTIME_MATRIX, out);
+}
+
+void emit_runtime_fill(FILE *out) {
+    fputs(RUNTIME_FILL, out);
+}
+
+void emit_runtime_parallel(FILE *out) {
+    fputs(RUNTIME_PARALLEL, out);
+}
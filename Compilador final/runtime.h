@@ -0,0 +1,25 @@
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include <stdio.h>
+
+/*
+ * RUNTIME DO PROGRAMA GERADO
+ * Cada função escreve no ficheiro de saída um trecho de C que é incluído
+ * no programa gerado apenas quando o código usa o recurso correspondente.
+ */
+void emit_runtime_memo(FILE *out);
+void emit_runtime_input(FILE *out);
+void emit_runtime_output(FILE *out);
+void emit_runtime_files(FILE *out);
+void emit_runtime_string(FILE *out);
+void emit_runtime_array(FILE *out);
+void emit_runtime_fail(FILE *out);
+void emit_runtime_bounds(FILE *out);
+void emit_runtime_arith(FILE *out);
+void emit_runtime_reduce(FILE *out);
+void emit_runtime_matrix(FILE *out);
+void emit_runtime_fill(FILE *out);
+void emit_runtime_parallel(FILE *out);
+
+#endif